@@ -0,0 +1,60 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdlib>
+#include <new>
+#include <stdint.h>
+
+// Counts the heap allocations each thread makes, so the game can show and
+// the benchmarks can enforce that a steady-state tick makes none. The
+// counting is done by replacing the global operator new, which a program
+// may do only once: the one .cpp file that wants it defines
+// ALLOC_COUNTER_HOOKS before including this. Elsewhere the count stays 0.
+// The cost is one thread-local increment on top of malloc, cheap enough
+// to leave on.
+
+inline uint64_t& threadAllocationCounter() {
+    static thread_local uint64_t count = 0;
+    return count;
+}
+
+// Allocations made so far by the calling thread
+inline uint64_t threadAllocations() { return threadAllocationCounter(); }
+
+#ifdef ALLOC_COUNTER_HOOKS
+
+void* operator new(std::size_t size) {
+    ++threadAllocationCounter();
+    if (size == 0) size = 1;
+    while (true) {
+        void* p = malloc(size);
+        if (p) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return NULL;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+// Out of line, or GCC follows new into malloc and warns at every delete
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { operator delete(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { operator delete(p); }
+
+#endif
+
+#endif
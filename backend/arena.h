@@ -0,0 +1,347 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <stdint.h>
+#include "snake_core.h"
+#include "multiplayer.h"
+#include "tick_profiler.h"
+
+// Local arena: you against up to 63 computer snakes on one larger board.
+// It runs the same MultiWorld and MpStepper as network games, without the
+// sockets: each tick every computer snake proposes a move (spread across
+// worker threads once there are enough of them), the stepper resolves all
+// collisions at once, and the result goes through MultiWorld::applyMoves.
+
+const int ARENA_MIN_SNAKES = 2;
+const int ARENA_MAX_SNAKES = MP_MAX_PLAYERS;
+// Below this many snakes the proposals are cheaper than waking threads
+const int ARENA_PARALLEL_MIN = 16;
+
+// Threads that stay alive for the whole game. run() splits [0, count) into
+// one slice per thread, runs slice 0 on the caller and returns once every
+// slice is done.
+class ArenaWorkers {
+public:
+    explicit ArenaWorkers(int threads) : generation(0), pending(0), stopping(false), count(0) {
+        for (int i = 1; i < threads; ++i) pool.push_back(std::thread(&ArenaWorkers::loop, this, i));
+    }
+
+    ~ArenaWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start.notify_all();
+        for (size_t i = 0; i < pool.size(); ++i) pool[i].join();
+    }
+
+    int size() const { return static_cast<int>(pool.size()) + 1; }
+
+    // job(worker, begin, end); worker indexes per-thread scratch
+    void run(int n, const std::function<void(int, int, int)>& f) {
+        if (pool.empty()) {
+            f(0, 0, n);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = f;
+            count = n;
+            pending = static_cast<int>(pool.size());
+            ++generation;
+        }
+        start.notify_all();
+        slice(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    std::vector<std::thread> pool;
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+    uint64_t generation;
+    int pending;
+    bool stopping;
+    int count;
+    std::function<void(int, int, int)> job;
+
+    void slice(int worker) {
+        int parts = size();
+        job(worker, count * worker / parts, count * (worker + 1) / parts);
+    }
+
+    void loop(int worker) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            start.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            lock.unlock();
+            slice(worker);
+            lock.lock();
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    ArenaWorkers(const ArenaWorkers&);
+    ArenaWorkers& operator=(const ArenaWorkers&);
+};
+
+// Steering for one computer snake at a time. Each worker thread owns one,
+// with its own flood-fill grid, so proposals never share scratch memory.
+class ArenaBot {
+public:
+    // Bounded look-ahead: a move is "open" if this many cells are reachable
+    static const int SPACE_LIMIT = 48;
+
+    ArenaBot() : stamp(0), rng(1) {}
+
+    void seed(uint64_t s) { rng.seed(s); }
+
+    // headLength[cell] is the length of the snake whose head is in cell,
+    // valid where headStamp[cell] equals tick
+    int choose(const MultiWorld& world, int id, const std::vector<uint32_t>& headStamp,
+               const std::vector<uint32_t>& headLength, uint32_t tick) {
+        const MpSnake& me = world.snakes[id];
+        int head = me.body.front();
+        uint32_t length = static_cast<uint32_t>(me.body.size());
+        int need = std::min(static_cast<int>(length) + 2, SPACE_LIMIT);
+        int best = me.dir;
+        int bestScore = -1000000000;
+        for (int d = 0; d < 4; ++d) {
+            if (length > 1 && ((d + 2) & 3) == me.dir) continue;
+            int nx = world.cellX(head) + mpDirDx(d);
+            int ny = world.cellY(head) + mpDirDy(d);
+            if (world.isWall(nx, ny)) continue;
+            int cell = world.cellAt(nx, ny);
+            if (world.occupied[cell] && cell != me.body.back()) continue;
+            int score = -4 * nearestFood(world, nx, ny) + rng.below(3);
+            for (int k = 0; k < 4; ++k) {
+                int ax = nx + mpDirDx(k);
+                int ay = ny + mpDirDy(k);
+                if (world.isWall(ax, ay)) continue;
+                int around = world.cellAt(ax, ay);
+                if (around != head && headStamp[around] == tick && headLength[around] >= length) score -= 5000;
+            }
+            if (space(world, cell, need) < need) score -= 2000;
+            if (score > bestScore) {
+                bestScore = score;
+                best = d;
+            }
+        }
+        return best;
+    }
+
+private:
+    std::vector<uint32_t> seen;
+    std::vector<int> queue;
+    uint32_t stamp;
+    GameRng rng;
+
+    static int nearestFood(const MultiWorld& world, int x, int y) {
+        int nearest = world.width + world.height;
+        for (size_t i = 0; i < world.foodCells.size(); ++i) {
+            int c = world.foodCells[i];
+            int dist = std::abs(world.cellX(c) - x) + std::abs(world.cellY(c) - y);
+            if (dist < nearest) nearest = dist;
+        }
+        return nearest;
+    }
+
+    // Free cells reachable from cell, counting up to limit
+    int space(const MultiWorld& world, int cell, int limit) {
+        if (seen.size() != world.occupied.size()) {
+            seen.assign(world.occupied.size(), 0);
+            stamp = 0;
+        }
+        ++stamp;
+        queue.clear();
+        queue.push_back(cell);
+        seen[cell] = stamp;
+        for (size_t i = 0; i < queue.size() && static_cast<int>(queue.size()) < limit; ++i) {
+            int c = queue[i];
+            for (int d = 0; d < 4; ++d) {
+                int nx = world.cellX(c) + mpDirDx(d);
+                int ny = world.cellY(c) + mpDirDy(d);
+                if (world.isWall(nx, ny)) continue;
+                int next = world.cellAt(nx, ny);
+                if (seen[next] == stamp || world.occupied[next]) continue;
+                seen[next] = stamp;
+                queue.push_back(next);
+            }
+        }
+        return static_cast<int>(queue.size());
+    }
+};
+
+class ArenaGame {
+public:
+    ArenaGame(int snakes, int tickMicros, int threads)
+        : players(std::max(ARENA_MIN_SNAKES, std::min(ARENA_MAX_SNAKES, snakes))),
+          period(tickMicros > 0 ? tickMicros : BASE_SPEED),
+          workers(std::max(1, threads)),
+          bots(workers.size()),
+          rng(static_cast<uint64_t>(time(0)) ^ (static_cast<uint64_t>(getpid()) << 32)),
+          humanWish(-1),
+          humanWantsSpawn(false) {
+        // The board grows with the number of snakes, within what the wire
+        // format allows (one byte per side)
+        world.resize(std::min(200, 40 + 2 * players), std::min(60, 20 + players / 2));
+        for (size_t i = 0; i < bots.size(); ++i) bots[i].seed(rng.next() | static_cast<uint64_t>(i) << 32);
+        headStamp.assign(world.width * world.height, 0);
+        headLength.assign(world.width * world.height, 0);
+    }
+
+    int run() {
+        TerminalInput terminal;
+        std::cout << "\033[?25l";
+        for (int id = 0; id < players; ++id) spawn(id);
+        refillFood();
+        uint64_t nextTick = monotonicNanos() / 1000 + period;
+        bool running = true;
+        while (running) {
+            uint64_t now = monotonicNanos() / 1000;
+            int timeout = now >= nextTick ? 0 : static_cast<int>((nextTick - now + 999) / 1000);
+            struct pollfd pfd;
+            pfd.fd = STDIN_FILENO;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, timeout) > 0) running = readKeys(terminal);
+            now = monotonicNanos() / 1000;
+            if (now < nextTick) continue;
+            step();
+            nextTick += period;
+            if (now > nextTick + period) nextTick = now + period;
+            std::ostringstream frame;
+            renderMultiWorld(world, 0, frame);
+            const std::string& out = frame.str();
+            std::cout.write(out.data(), out.size());
+            std::cout.flush();
+        }
+        std::cout << "\033[?25h";
+        return 0;
+    }
+
+    // One tick: proposals, resolution, then respawns and food
+    void step() {
+        uint32_t tick = world.tick + 1;
+        int wish[MP_MAX_PLAYERS];
+        for (int id = 0; id < MP_MAX_PLAYERS; ++id) {
+            wish[id] = -1;
+            const MpSnake& s = world.snakes[id];
+            if (!s.alive) continue;
+            headStamp[s.body.front()] = tick;
+            headLength[s.body.front()] = static_cast<uint32_t>(s.body.size());
+        }
+        wish[0] = humanWish;
+        humanWish = -1;
+        std::function<void(int, int, int)> propose = [&](int worker, int begin, int end) {
+            for (int id = begin + 1; id < end + 1; ++id) {
+                if (world.snakes[id].alive) wish[id] = bots[worker].choose(world, id, headStamp, headLength, tick);
+            }
+        };
+        if (players >= ARENA_PARALLEL_MIN) workers.run(players - 1, propose);
+        else propose(0, 0, players - 1);
+
+        std::vector<uint8_t> moves;
+        WireWriter w(moves);
+        stepper.resolve(world, wish, w);
+        WireReader r(moves.empty() ? NULL : &moves[0], moves.size());
+        world.applyMoves(r);
+
+        for (int id = 1; id < players; ++id) {
+            if (!world.snakes[id].alive) spawn(id);
+        }
+        if (humanWantsSpawn && !world.snakes[0].alive) spawn(0);
+        humanWantsSpawn = false;
+        refillFood();
+    }
+
+    const MultiWorld& getWorld() const { return world; }
+
+private:
+    int players;
+    int period;
+    MultiWorld world;
+    MpStepper stepper;
+    ArenaWorkers workers;
+    std::vector<ArenaBot> bots;
+    GameRng rng;
+    std::vector<uint32_t> headStamp;
+    std::vector<uint32_t> headLength;
+    int humanWish;
+    bool humanWantsSpawn;
+
+    int randomFreeCell() {
+        int area = world.width * world.height;
+        for (int tries = 0; tries < area * 4; ++tries) {
+            int cell = rng.below(area);
+            if (world.isFree(cell)) return cell;
+        }
+        return -1;
+    }
+
+    // Joins go through applyEvent, as they do for network players
+    void spawn(int id) {
+        int cell = randomFreeCell();
+        if (cell < 0) return;
+        std::vector<uint8_t> ev;
+        WireWriter e(ev);
+        e.u8(MP_EV_JOIN);
+        e.u8(static_cast<uint8_t>(id));
+        e.u16(static_cast<uint16_t>(cell));
+        e.u8(world.cellX(cell) < world.width / 2 ? 1 : 3);
+        WireReader r(&ev[0], ev.size());
+        bool ok = true;
+        world.applyEvent(r, ok);
+    }
+
+    void refillFood() {
+        int wantFood = std::max(world.aliveCount(), 1);
+        for (int n = world.foodCount(); n < wantFood; ++n) {
+            int cell = randomFreeCell();
+            if (cell < 0) break;
+            world.addFood(cell);
+        }
+    }
+
+    // Returns false on quit
+    bool readKeys(TerminalInput& terminal) {
+        while (terminal.kbhit()) {
+            char key = terminal.getch();
+            if (key == '\033') {
+                terminal.getch();
+                key = terminal.getch();
+                if (key == 'A') humanWish = 0;
+                else if (key == 'C') humanWish = 1;
+                else if (key == 'B') humanWish = 2;
+                else if (key == 'D') humanWish = 3;
+                continue;
+            }
+            if (key >= 'A' && key <= 'Z') key = key + 32;
+            if (key == 'w') humanWish = 0;
+            else if (key == 'd') humanWish = 1;
+            else if (key == 's') humanWish = 2;
+            else if (key == 'a') humanWish = 3;
+            else if (key == 'r') humanWantsSpawn = true;
+            else if (key == 'q') return false;
+        }
+        return true;
+    }
+
+    ArenaGame(const ArenaGame&);
+    ArenaGame& operator=(const ArenaGame&);
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef BOT_API_H
+#define BOT_API_H
+
+/*
+ * Controller plugin interface. A bot is a shared library built from C or
+ * C++ that exports the functions below with C linkage; the tournament
+ * loads it with dlopen(). Only this header is needed to build one:
+ *
+ *   cc -O2 -shared -fPIC -o mybot.so mybot.c
+ *
+ * Rules for bots:
+ *   - The view and everything it points to is read-only and only valid
+ *     during the call.
+ *   - Matches run on several threads at once, each with its own bot
+ *     instances. Keep all state in the instance, not in globals.
+ *   - snake_bot_move() is timed; a move over the budget is ignored (the
+ *     snake keeps going straight) and too many of them forfeit the match.
+ *
+ * Directions: 0 up, 1 right, 2 down, 3 left. Cells are y * width + x, and
+ * the outermost ring of cells is wall.
+ *
+ * The layout of these structs only ever grows at the end, and
+ * SNAKE_BOT_API_VERSION changes whenever it does.
+ */
+
+#include <stdint.h>
+
+#define SNAKE_BOT_API_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SnakeBotSnake {
+    int32_t alive;
+    int32_t dir;
+    int32_t score;
+    int32_t length;
+    const uint16_t* body; /* length cells, head first */
+} SnakeBotSnake;
+
+typedef struct SnakeBotView {
+    uint32_t api_version;
+    int32_t width;
+    int32_t height;
+    uint32_t tick;
+    int32_t self; /* index into snakes of the snake to move */
+    int32_t snake_count;
+    const SnakeBotSnake* snakes;
+    int32_t food_count;
+    const uint16_t* food;
+    const uint8_t* occupied; /* width * height, non-zero where a body is */
+} SnakeBotView;
+
+/* Required */
+uint32_t snake_bot_api_version(void); /* return SNAKE_BOT_API_VERSION */
+int snake_bot_move(void* bot, const SnakeBotView* view);
+
+/* Optional */
+const char* snake_bot_name(void);
+void* snake_bot_create(uint64_t seed);
+void snake_bot_destroy(void* bot);
+
+typedef uint32_t (*SnakeBotVersionFn)(void);
+typedef int (*SnakeBotMoveFn)(void*, const SnakeBotView*);
+typedef const char* (*SnakeBotNameFn)(void);
+typedef void* (*SnakeBotCreateFn)(uint64_t);
+typedef void (*SnakeBotDestroyFn)(void*);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
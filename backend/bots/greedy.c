@@ -0,0 +1,38 @@
+/* Heads for the nearest food, avoiding only the very next collision */
+
+#include <stdlib.h>
+#include "../bot_api.h"
+
+static const int DX[4] = {0, 1, 0, -1};
+static const int DY[4] = {-1, 0, 1, 0};
+
+uint32_t snake_bot_api_version(void) { return SNAKE_BOT_API_VERSION; }
+
+const char* snake_bot_name(void) { return "greedy"; }
+
+int snake_bot_move(void* bot, const SnakeBotView* v) {
+    const SnakeBotSnake* me = &v->snakes[v->self];
+    int hx = me->body[0] % v->width;
+    int hy = me->body[0] / v->width;
+    int best = me->dir;
+    int bestScore = -1000000;
+    int d, i;
+    (void)bot;
+    for (d = 0; d < 4; ++d) {
+        int nx = hx + DX[d];
+        int ny = hy + DY[d];
+        int nearest = v->width + v->height;
+        if (me->length > 1 && ((d + 2) & 3) == me->dir) continue;
+        if (nx <= 0 || ny <= 0 || nx >= v->width - 1 || ny >= v->height - 1) continue;
+        if (v->occupied[ny * v->width + nx]) continue;
+        for (i = 0; i < v->food_count; ++i) {
+            int dist = abs(v->food[i] % v->width - nx) + abs(v->food[i] / v->width - ny);
+            if (dist < nearest) nearest = dist;
+        }
+        if (-nearest > bestScore) {
+            bestScore = -nearest;
+            best = d;
+        }
+    }
+    return best;
+}
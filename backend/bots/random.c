@@ -0,0 +1,42 @@
+/* Any move that does not crash at once, chosen at random: a baseline */
+
+#include <stdlib.h>
+#include "../bot_api.h"
+
+static const int DX[4] = {0, 1, 0, -1};
+static const int DY[4] = {-1, 0, 1, 0};
+
+uint32_t snake_bot_api_version(void) { return SNAKE_BOT_API_VERSION; }
+
+const char* snake_bot_name(void) { return "random"; }
+
+void* snake_bot_create(uint64_t seed) {
+    uint64_t* state = (uint64_t*)malloc(sizeof(uint64_t));
+    if (state) *state = seed | 1;
+    return state;
+}
+
+void snake_bot_destroy(void* bot) { free(bot); }
+
+int snake_bot_move(void* bot, const SnakeBotView* v) {
+    uint64_t* state = (uint64_t*)bot;
+    const SnakeBotSnake* me = &v->snakes[v->self];
+    int hx = me->body[0] % v->width;
+    int hy = me->body[0] / v->width;
+    int options[4];
+    int n = 0;
+    int d;
+    for (d = 0; d < 4; ++d) {
+        int nx = hx + DX[d];
+        int ny = hy + DY[d];
+        if (me->length > 1 && ((d + 2) & 3) == me->dir) continue;
+        if (nx <= 0 || ny <= 0 || nx >= v->width - 1 || ny >= v->height - 1) continue;
+        if (v->occupied[ny * v->width + nx]) continue;
+        options[n++] = d;
+    }
+    if (n == 0) return me->dir;
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return options[*state % n];
+}
@@ -0,0 +1,102 @@
+/* Prefers moves that keep room to move: each candidate is scored by a
+ * flood fill of the cells it can still reach, then by distance to food.
+ * Also steps away from cells an equal or longer head could enter. */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../bot_api.h"
+
+static const int DX[4] = {0, 1, 0, -1};
+static const int DY[4] = {-1, 0, 1, 0};
+
+typedef struct Survivor {
+    int cells;
+    uint8_t* seen;
+    uint16_t* queue;
+} Survivor;
+
+uint32_t snake_bot_api_version(void) { return SNAKE_BOT_API_VERSION; }
+
+const char* snake_bot_name(void) { return "survivor"; }
+
+void* snake_bot_create(uint64_t seed) {
+    Survivor* s = (Survivor*)calloc(1, sizeof(Survivor));
+    (void)seed;
+    return s;
+}
+
+void snake_bot_destroy(void* bot) {
+    Survivor* s = (Survivor*)bot;
+    if (!s) return;
+    free(s->seen);
+    free(s->queue);
+    free(s);
+}
+
+static int isOpen(const SnakeBotView* v, int x, int y) {
+    return x > 0 && y > 0 && x < v->width - 1 && y < v->height - 1 && !v->occupied[y * v->width + x];
+}
+
+static int reachable(Survivor* s, const SnakeBotView* v, int start, int limit) {
+    int head = 0, tail = 0, d;
+    memset(s->seen, 0, s->cells);
+    s->seen[start] = 1;
+    s->queue[tail++] = (uint16_t)start;
+    while (head < tail && tail < limit) {
+        int c = s->queue[head++];
+        for (d = 0; d < 4; ++d) {
+            int nx = c % v->width + DX[d];
+            int ny = c / v->width + DY[d];
+            int n = ny * v->width + nx;
+            if (!isOpen(v, nx, ny) || s->seen[n]) continue;
+            s->seen[n] = 1;
+            s->queue[tail++] = (uint16_t)n;
+        }
+    }
+    return tail;
+}
+
+int snake_bot_move(void* bot, const SnakeBotView* v) {
+    Survivor* s = (Survivor*)bot;
+    const SnakeBotSnake* me = &v->snakes[v->self];
+    int cells = v->width * v->height;
+    int hx = me->body[0] % v->width;
+    int hy = me->body[0] / v->width;
+    int best = me->dir;
+    long bestScore = -1000000000L;
+    int d, i, k;
+    if (s->cells != cells) {
+        free(s->seen);
+        free(s->queue);
+        s->seen = (uint8_t*)malloc(cells);
+        s->queue = (uint16_t*)malloc(cells * sizeof(uint16_t));
+        s->cells = cells;
+    }
+    for (d = 0; d < 4; ++d) {
+        int nx = hx + DX[d];
+        int ny = hy + DY[d];
+        int nearest = v->width + v->height;
+        int room;
+        long score;
+        if (me->length > 1 && ((d + 2) & 3) == me->dir) continue;
+        if (!isOpen(v, nx, ny)) continue;
+        room = reachable(s, v, ny * v->width + nx, 4 * me->length + 16);
+        for (i = 0; i < v->food_count; ++i) {
+            int dist = abs(v->food[i] % v->width - nx) + abs(v->food[i] / v->width - ny);
+            if (dist < nearest) nearest = dist;
+        }
+        score = (room < 2 * me->length + 4 ? room * 1000L : 100000L) - nearest;
+        for (i = 0; i < v->snake_count; ++i) {
+            const SnakeBotSnake* o = &v->snakes[i];
+            if (i == v->self || !o->alive || o->length < me->length) continue;
+            for (k = 0; k < 4; ++k) {
+                if (o->body[0] == (ny + DY[k]) * v->width + nx + DX[k]) score -= 50000;
+            }
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            best = d;
+        }
+    }
+    return best;
+}
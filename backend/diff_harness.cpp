@@ -0,0 +1,427 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "game_engine.h"
+#include "reference_game.h"
+#include "sim_state.h"
+#include "tick_profiler.h"
+
+using namespace std;
+
+// Runs GameEngine and ReferenceGame side by side from the same seed and the
+// same random inputs, comparing their whole state after every tick: what is
+// on the board, the score, the RNG, pause, and the spawn and expiry timers
+// that have not shown on the board yet. When
+// the board fits, the flat SimState used by the AI runs along too, and is
+// reloaded from the engine now and then to check load() as well. On the
+// first difference it shrinks the inputs to the fewest that still reproduce
+// it and writes them out as a replay for --replay.
+
+static const int MAX_STEPS = 5000;
+
+enum InputKind {
+    INPUT_UP,
+    INPUT_RIGHT,
+    INPUT_DOWN,
+    INPUT_LEFT,
+    INPUT_PAUSE
+};
+
+struct Input {
+    int step;
+    int kind;
+};
+
+struct Scenario {
+    uint64_t seed;
+    bool easy;
+    bool wrap;
+    int foods;
+    int steps;
+    vector<Input> inputs;
+};
+
+struct Divergence {
+    int step;
+    string detail;
+};
+
+// The models under test, stepped together
+struct Models {
+    GameEngine engine;
+    ReferenceGame ref;
+    SimState sim;
+    vector<uint8_t> simImage;
+    bool simulated;
+    bool paused;
+
+    Models(const Scenario& s, const LevelMap* level)
+        : engine(s.seed), ref(s.seed, level, startEngine(s, level), s.easy, s.wrap), paused(false) {
+        simulated = SimState::fits(*level, engine.getFoodCount());
+        if (simulated) sim.reset(level, s.seed, engine.getFoodCount(), s.easy, s.wrap);
+    }
+
+    // Runs before ref is built; returns the food count, as the engine
+    // clamps it, for the other models
+    int startEngine(const Scenario& s, const LevelMap* level) {
+        engine.setModes(s.easy, s.wrap, 2);
+        engine.setFoodCount(s.foods);
+        engine.setLevel(level);
+        engine.seed(s.seed);
+        engine.reset();
+        return engine.getFoodCount();
+    }
+
+    void apply(const Input& in) {
+        if (in.kind == INPUT_PAUSE) {
+            paused = !paused;
+            engine.setPaused(paused);
+            ref.setPaused(paused);
+            if (simulated) sim.setPaused(paused);
+            return;
+        }
+        Position dir(LEVEL_DX[in.kind], LEVEL_DY[in.kind]);
+        engine.setDirection(dir);
+        ref.setDirection(dir);
+        if (simulated) sim.setDirection(in.kind);
+    }
+
+    void update(int step) {
+        engine.update();
+        ref.update();
+        if (!simulated) return;
+        sim.step();
+        if (step % 64 == 63 && !sim.load(engine, simImage)) simulated = false;
+    }
+};
+
+static string describe(const Position& p) {
+    ostringstream out;
+    out << "(" << p.x << "," << p.y << ")";
+    return out.str();
+}
+
+static void compareTimers(const RuleTimers& a, const RuleTimers& b, ostringstream& out) {
+    if (a.specialReady != b.specialReady) out << "special ready " << a.specialReady << " vs " << b.specialReady << "; ";
+    if (a.poisonReady != b.poisonReady) out << "poison ready " << a.poisonReady << " vs " << b.poisonReady << "; ";
+    if (a.specialSpawn != b.specialSpawn) out << "special spawn " << a.specialSpawn << " vs " << b.specialSpawn << "; ";
+    if (a.specialExpire != b.specialExpire) {
+        out << "special expiry " << a.specialExpire << " vs " << b.specialExpire << "; ";
+    }
+    if (a.poisonSpawn != b.poisonSpawn) out << "poison spawn " << a.poisonSpawn << " vs " << b.poisonSpawn << "; ";
+}
+
+// Empty when the two agree
+static string compareState(const GameEngine& engine, const ReferenceGame& ref) {
+    ostringstream out;
+    if (engine.getTick() != ref.getTick()) out << "tick " << engine.getTick() << " vs " << ref.getTick() << "; ";
+    if (engine.getScore() != ref.getScore()) out << "score " << engine.getScore() << " vs " << ref.getScore() << "; ";
+    if (engine.getFoodsEaten() != ref.getFoodsEaten()) {
+        out << "foods eaten " << engine.getFoodsEaten() << " vs " << ref.getFoodsEaten() << "; ";
+    }
+    if (engine.isGameOver() != ref.isGameOver()) out << "game over " << engine.isGameOver() << " vs " << ref.isGameOver() << "; ";
+    if (engine.getRngState() != ref.rngState()) out << "rng state differs; ";
+    if (engine.isPaused() != ref.isPaused()) out << "paused " << engine.isPaused() << " vs " << ref.isPaused() << "; ";
+    compareTimers(engine.getTimers(), ref.getTimers(), out);
+    if (!(engine.getSnake().getDirection() == ref.getDirection())) {
+        out << "direction " << describe(engine.getSnake().getDirection()) << " vs " << describe(ref.getDirection()) << "; ";
+    }
+    const vector<Position>& body = engine.getSnake().getBody();
+    const vector<Position>& refBody = ref.getBody();
+    if (body.size() != refBody.size()) {
+        out << "length " << body.size() << " vs " << refBody.size() << "; ";
+    } else {
+        for (size_t i = 0; i < body.size(); ++i) {
+            if (!(body[i] == refBody[i])) {
+                out << "segment " << i << " " << describe(body[i]) << " vs " << describe(refBody[i]) << "; ";
+                break;
+            }
+        }
+    }
+    const ItemLayer& items = engine.getItems();
+    const vector<ReferenceGame::Item>& refItems = ref.getItems();
+    if (items.size() != refItems.size()) {
+        out << "items " << items.size() << " vs " << refItems.size() << "; ";
+    } else {
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (items[i].type != refItems[i].type || !(items[i].pos == refItems[i].pos)) {
+                out << "item " << i << " " << itemGlyph(items[i].type) << describe(items[i].pos) << " vs "
+                    << itemGlyph(refItems[i].type) << describe(refItems[i].pos) << "; ";
+                break;
+            }
+        }
+    }
+    return out.str();
+}
+
+static string compareSim(const SimState& sim, const ReferenceGame& ref) {
+    ostringstream out;
+    if (sim.tick != ref.getTick()) out << "tick " << sim.tick << " vs " << ref.getTick() << "; ";
+    if (sim.score != ref.getScore()) out << "score " << sim.score << " vs " << ref.getScore() << "; ";
+    if (sim.foodsEaten != ref.getFoodsEaten()) out << "foods eaten " << sim.foodsEaten << " vs " << ref.getFoodsEaten() << "; ";
+    if (sim.isOver() != ref.isGameOver()) out << "game over " << sim.isOver() << " vs " << ref.isGameOver() << "; ";
+    if (sim.rng.getState() != ref.rngState()) out << "rng state differs; ";
+    if (sim.isPaused() != ref.isPaused()) out << "paused " << sim.isPaused() << " vs " << ref.isPaused() << "; ";
+    compareTimers(sim.getTimers(), ref.getTimers(), out);
+    const Position& dir = ref.getDirection();
+    if (LEVEL_DX[sim.direction()] != dir.x || LEVEL_DY[sim.direction()] != dir.y) out << "direction differs; ";
+    int width = sim.level->width();
+    vector<uint32_t> body;
+    sim.bodyCells(body);
+    const vector<Position>& refBody = ref.getBody();
+    if (body.size() != refBody.size()) {
+        out << "length " << body.size() << " vs " << refBody.size() << "; ";
+    } else {
+        for (size_t i = 0; i < body.size(); ++i) {
+            if (body[i] != static_cast<uint32_t>(refBody[i].y * width + refBody[i].x)) {
+                out << "segment " << i << " differs; ";
+                break;
+            }
+        }
+    }
+    const vector<ReferenceGame::Item>& refItems = ref.getItems();
+    if (sim.itemCount != refItems.size()) {
+        out << "items " << int(sim.itemCount) << " vs " << refItems.size() << "; ";
+    } else {
+        for (size_t i = 0; i < refItems.size(); ++i) {
+            if (sim.itemType[i] != refItems[i].type ||
+                sim.itemCell[i] != static_cast<uint32_t>(refItems[i].pos.y * width + refItems[i].pos.x)) {
+                out << "item " << i << " differs; ";
+                break;
+            }
+        }
+    }
+    string detail = out.str();
+    return detail.empty() ? detail : "sim: " + detail;
+}
+
+static string compareModels(const Models& m) {
+    string detail = compareState(m.engine, m.ref);
+    if (detail.empty() && m.simulated) detail = compareSim(m.sim, m.ref);
+    return detail;
+}
+
+// Plays a recorded scenario; returns true and fills div at the first step
+// where the two disagree
+static bool replay(const Scenario& s, const LevelMap* level, Divergence& div) {
+    Models m(s, level);
+    size_t next = 0;
+    for (int step = 0; step < s.steps; ++step) {
+        while (next < s.inputs.size() && s.inputs[next].step == step) m.apply(s.inputs[next++]);
+        m.update(step);
+        string detail = compareModels(m);
+        if (!detail.empty()) {
+            div.step = step;
+            div.detail = detail;
+            return true;
+        }
+        if (m.engine.isGameOver()) break;
+    }
+    return false;
+}
+
+// Biased toward moves that do not end the game at once, so games run long
+// enough to reach the timed mechanics and higher levels
+static int pickDirection(const GameEngine& engine, GameRng& rng) {
+    if (rng.below(4) == 0) return rng.below(4);
+    const LevelMap& level = engine.getLevelMap();
+    const Position& head = engine.getSnake().head();
+    int safe[4];
+    int count = 0;
+    for (int d = 0; d < 4; ++d) {
+        Position p(head.x + LEVEL_DX[d], head.y + LEVEL_DY[d]);
+        if (p.x <= 0 || p.y <= 0 || p.x >= level.width() - 1 || p.y >= level.height() - 1) continue;
+        if (level.isWall(static_cast<uint32_t>(p.y * level.width() + p.x))) continue;
+        if (engine.getSnake().hitsSelf(p)) continue;
+        safe[count++] = d;
+    }
+    return count ? safe[rng.below(count)] : rng.below(4);
+}
+
+// One random game played live; inputs are recorded into s as they are made
+static bool playRandom(Scenario& s, const LevelMap* level, GameRng& rng, Divergence& div, uint64_t& ticks) {
+    Models m(s, level);
+    s.inputs.clear();
+    for (int step = 0; step < s.steps; ++step) {
+        int roll = rng.below(1000);
+        if (roll < 150 || (m.paused && roll < 300)) {
+            Input in;
+            in.step = step;
+            in.kind = roll < 3 || m.paused ? INPUT_PAUSE : pickDirection(m.engine, rng);
+            s.inputs.push_back(in);
+            m.apply(in);
+        }
+        m.update(step);
+        ++ticks;
+        string detail = compareModels(m);
+        if (!detail.empty()) {
+            div.step = step;
+            div.detail = detail;
+            s.steps = step + 1;
+            return true;
+        }
+        if (m.engine.isGameOver()) break;
+    }
+    return false;
+}
+
+// Drops inputs one at a time, keeping each removal that still diverges,
+// until no single input can go
+static void minimize(Scenario& s, const LevelMap* level, Divergence& div) {
+    bool shrunk = true;
+    while (shrunk) {
+        shrunk = false;
+        for (size_t i = s.inputs.size(); i-- > 0;) {
+            Scenario trial = s;
+            trial.inputs.erase(trial.inputs.begin() + i);
+            Divergence d;
+            if (replay(trial, level, d)) {
+                s.steps = d.step + 1;
+                s.inputs.swap(trial.inputs);
+                div = d;
+                shrunk = true;
+            }
+        }
+    }
+}
+
+static bool writeReplay(const string& path, const Scenario& s, const string& levelPath, const Divergence& div) {
+    ofstream out(path.c_str());
+    if (!out) return false;
+    out << "# diff_harness replay: diverges at step " << div.step << ": " << div.detail << "\n";
+    out << "seed " << s.seed << "\n";
+    out << "easy " << s.easy << "\n";
+    out << "wrap " << s.wrap << "\n";
+    out << "foods " << s.foods << "\n";
+    out << "steps " << s.steps << "\n";
+    if (!levelPath.empty()) out << "level " << levelPath << "\n";
+    for (size_t i = 0; i < s.inputs.size(); ++i) {
+        out << "input " << s.inputs[i].step << " " << s.inputs[i].kind << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+static bool readReplay(const string& path, Scenario& s, string& levelPath) {
+    ifstream in(path.c_str());
+    if (!in) return false;
+    s = Scenario();
+    s.foods = 1;
+    s.steps = MAX_STEPS;
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream fields(line);
+        string key;
+        fields >> key;
+        if (key == "seed") fields >> s.seed;
+        else if (key == "easy") fields >> s.easy;
+        else if (key == "wrap") fields >> s.wrap;
+        else if (key == "foods") fields >> s.foods;
+        else if (key == "steps") fields >> s.steps;
+        else if (key == "level") fields >> levelPath;
+        else if (key == "input") {
+            Input input;
+            fields >> input.step >> input.kind;
+            if (input.kind < INPUT_UP || input.kind > INPUT_PAUSE) return false;
+            s.inputs.push_back(input);
+        }
+        if (!fields) return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t seed = static_cast<uint64_t>(time(NULL));
+    double seconds = 0;
+    string levelPath;
+    string replayPath;
+    string outPath = "divergence.replay";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+        else if (arg == "--seconds" && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (arg == "--level" && i + 1 < argc) levelPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc) replayPath = argv[++i];
+        else if (arg == "--out" && i + 1 < argc) outPath = argv[++i];
+        else {
+            cerr << "Usage: " << argv[0] << " [--seed N] [--seconds N] [--level file.lvl] [--out file]\n"
+                 << "       " << argv[0] << " --replay file\n"
+                 << "  Runs until the engines diverge, or for --seconds if given\n";
+            return 1;
+        }
+    }
+
+    Scenario recorded;
+    if (!replayPath.empty() && !readReplay(replayPath, recorded, levelPath)) {
+        cerr << "Cannot read replay " << replayPath << "\n";
+        return 1;
+    }
+    LevelMap loaded;
+    const LevelMap* level = &LevelMap::standard();
+    if (!levelPath.empty()) {
+        string error;
+        if (!loaded.load(levelPath, error)) {
+            cerr << error << "\n";
+            return 1;
+        }
+        level = &loaded;
+    }
+
+    if (!replayPath.empty()) {
+        Divergence div;
+        if (replay(recorded, level, div)) {
+            cout << "Diverges at step " << div.step << ": " << div.detail << "\n";
+            return 1;
+        }
+        cout << "No divergence in " << recorded.steps << " steps\n";
+        return 0;
+    }
+
+    cout << "Seed " << seed << "\n";
+    GameRng rng(seed);
+    uint64_t games = 0;
+    uint64_t ticks = 0;
+    uint64_t start = monotonicNanos();
+    uint64_t lastReport = start;
+    uint64_t lastTicks = 0;
+    while (true) {
+        Scenario s;
+        s.seed = (static_cast<uint64_t>(rng.next()) << 32) | rng.next();
+        s.easy = rng.below(4) == 0;
+        s.wrap = rng.below(3) == 0;
+        s.foods = rng.below(3) == 0 ? 1 + rng.below(40) : 1;
+        s.steps = MAX_STEPS;
+        Divergence div;
+        if (playRandom(s, level, rng, div, ticks)) {
+            cout << "Diverged in game " << games << " at step " << div.step << ": " << div.detail << "\n";
+            size_t before = s.inputs.size();
+            minimize(s, level, div);
+            if (!writeReplay(outPath, s, levelPath, div)) {
+                cerr << "Cannot write " << outPath << "\n";
+                return 1;
+            }
+            cout << "Minimized from " << before << " to " << s.inputs.size() << " inputs, step "
+                 << div.step << ": " << div.detail << "\nReplay written to " << outPath << "\n";
+            return 1;
+        }
+        ++games;
+
+        uint64_t now = monotonicNanos();
+        if (now - lastReport >= 5000000000ULL) {
+            printf("%llu games, %llu ticks, %.2fM ticks/s\n", (unsigned long long)games,
+                   (unsigned long long)ticks, (ticks - lastTicks) / ((now - lastReport) / 1e9) / 1e6);
+            fflush(stdout);
+            lastReport = now;
+            lastTicks = ticks;
+        }
+        if (seconds > 0 && now - start >= seconds * 1e9) break;
+    }
+    double elapsed = (monotonicNanos() - start) / 1e9;
+    printf("No divergence: %llu games, %llu ticks in %.1fs (%.2fM ticks/s)\n", (unsigned long long)games,
+           (unsigned long long)ticks, elapsed, ticks / elapsed / 1e6);
+    return 0;
+}
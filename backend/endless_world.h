@@ -0,0 +1,445 @@
+#ifndef ENDLESS_WORLD_H
+#define ENDLESS_WORLD_H
+
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <stdint.h>
+#include "snake_core.h"
+#include "tick_profiler.h"
+
+// Endless mode: a board with no edges. Terrain and food are generated from
+// the seed one CHUNK x CHUNK square at a time, the first time the snake
+// comes near. Only a window of chunks around the head and the chunks the
+// body lies in are kept; the rest are evicted and, if the snake returns,
+// generated again from the seed (food grows back). Memory therefore
+// follows the snake's length, not the distance it has travelled.
+
+const int ENDLESS_CHUNK = 32;
+const int ENDLESS_CHUNK_SHIFT = 5;
+// Chunks kept on each side of the head's chunk
+const int ENDLESS_WINDOW = 2;
+const int ENDLESS_FOOD_PER_CHUNK = 2;
+const int ENDLESS_VIEW_WIDTH = 60;
+const int ENDLESS_VIEW_HEIGHT = 20;
+
+// One square of the world. Each row is a 32-bit mask per layer.
+struct EndlessChunk {
+    int32_t cx;
+    int32_t cy;
+    uint32_t wall[ENDLESS_CHUNK];
+    uint32_t food[ENDLESS_CHUNK];
+    uint32_t body[ENDLESS_CHUNK];
+    uint32_t bodyCount;  // segments lying here; a chunk with any is kept
+    uint32_t foodCount;
+};
+
+// Open-addressing hash map from packed chunk coordinates to pool indices:
+// one flat array, linear probing, and backward-shift deletion so no
+// tombstones build up as chunks come and go.
+class ChunkMap {
+public:
+    static const int32_t NONE = -1;
+
+    ChunkMap() : count(0) { slots.resize(16); }
+
+    static uint64_t key(int32_t cx, int32_t cy) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+    }
+
+    int32_t find(uint64_t k) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(k) & mask;; i = (i + 1) & mask) {
+            if (slots[i].value == NONE) return NONE;
+            if (slots[i].key == k) return slots[i].value;
+        }
+    }
+
+    // k must not be present
+    void insert(uint64_t k, int32_t value) {
+        if ((count + 1) * 2 > slots.size()) grow();
+        place(k, value);
+        ++count;
+    }
+
+    void erase(uint64_t k) {
+        size_t mask = slots.size() - 1;
+        size_t i = hash(k) & mask;
+        while (slots[i].value != NONE && slots[i].key != k) i = (i + 1) & mask;
+        if (slots[i].value == NONE) return;
+        // Pull later entries of the probe run back over the hole
+        size_t hole = i;
+        for (size_t j = (i + 1) & mask; slots[j].value != NONE; j = (j + 1) & mask) {
+            size_t home = hash(slots[j].key) & mask;
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole] = Slot();
+        --count;
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+
+    void clear() {
+        slots.assign(slots.size(), Slot());
+        count = 0;
+    }
+
+private:
+    struct Slot {
+        uint64_t key;
+        int32_t value;
+        Slot() : key(0), value(NONE) {}
+    };
+
+    std::vector<Slot> slots;
+    size_t count;
+
+    static size_t hash(uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xFF51AFD7ED558CCDULL;
+        k ^= k >> 33;
+        return static_cast<size_t>(k);
+    }
+
+    void place(uint64_t k, int32_t value) {
+        size_t mask = slots.size() - 1;
+        size_t i = hash(k) & mask;
+        while (slots[i].value != NONE) i = (i + 1) & mask;
+        slots[i].key = k;
+        slots[i].value = value;
+    }
+
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        for (size_t i = 0; i < old.size(); ++i) {
+            if (old[i].value != NONE) place(old[i].key, old[i].value);
+        }
+    }
+};
+
+// Chunks live in one pool and are recycled through a free list, so the
+// pool only ever grows to the most chunks that were needed at once
+class EndlessWorld {
+public:
+    explicit EndlessWorld(uint64_t seed = 1) : worldSeed(seed), rng(seed), generated(0), evicted(0) {}
+
+    void reset(uint64_t seed) {
+        worldSeed = seed;
+        rng.seed(seed);
+        map.clear();
+        freeList.clear();
+        for (size_t i = pool.size(); i-- > 0;) freeList.push_back(static_cast<int32_t>(i));
+        generated = 0;
+        evicted = 0;
+    }
+
+    uint64_t seed() const { return worldSeed; }
+
+    bool isWall(int x, int y) { return bit(chunkAt(x, y).wall, x, y); }
+    bool hasFood(int x, int y) { return bit(chunkAt(x, y).food, x, y); }
+    bool isBody(int x, int y) { return bit(chunkAt(x, y).body, x, y); }
+
+    void setBody(int x, int y, bool on) {
+        EndlessChunk& c = chunkAt(x, y);
+        uint32_t mask = 1u << (x & (ENDLESS_CHUNK - 1));
+        uint32_t& row = c.body[y & (ENDLESS_CHUNK - 1)];
+        if (on && !(row & mask)) ++c.bodyCount;
+        if (!on && (row & mask)) --c.bodyCount;
+        row = on ? row | mask : row & ~mask;
+    }
+
+    // Removes the food at x, y and grows a new one in the same chunk
+    bool eatFood(int x, int y) {
+        EndlessChunk& c = chunkAt(x, y);
+        uint32_t mask = 1u << (x & (ENDLESS_CHUNK - 1));
+        uint32_t& row = c.food[y & (ENDLESS_CHUNK - 1)];
+        if (!(row & mask)) return false;
+        row &= ~mask;
+        --c.foodCount;
+        generateFood(c, rng);
+        return true;
+    }
+
+    // Loads the window around (x, y) and evicts chunks outside it that
+    // hold no part of the body
+    void keepAround(int x, int y) {
+        int hx = x >> ENDLESS_CHUNK_SHIFT;
+        int hy = y >> ENDLESS_CHUNK_SHIFT;
+        for (int cy = hy - ENDLESS_WINDOW; cy <= hy + ENDLESS_WINDOW; ++cy) {
+            for (int cx = hx - ENDLESS_WINDOW; cx <= hx + ENDLESS_WINDOW; ++cx) load(cx, cy);
+        }
+        for (size_t i = 0; i < pool.size(); ++i) {
+            EndlessChunk& c = pool[i];
+            if (!live[i] || c.bodyCount > 0) continue;
+            if (abs(c.cx - hx) <= ENDLESS_WINDOW && abs(c.cy - hy) <= ENDLESS_WINDOW) continue;
+            map.erase(ChunkMap::key(c.cx, c.cy));
+            live[i] = 0;
+            freeList.push_back(static_cast<int32_t>(i));
+            ++evicted;
+        }
+    }
+
+    // NULL for a chunk that is not loaded; for drawing
+    const EndlessChunk* peek(int x, int y) const {
+        int32_t index = map.find(ChunkMap::key(x >> ENDLESS_CHUNK_SHIFT, y >> ENDLESS_CHUNK_SHIFT));
+        return index == ChunkMap::NONE ? NULL : &pool[index];
+    }
+
+    static bool bit(const uint32_t* rows, int x, int y) {
+        return (rows[y & (ENDLESS_CHUNK - 1)] >> (x & (ENDLESS_CHUNK - 1))) & 1;
+    }
+
+    size_t liveChunks() const { return map.size(); }
+    size_t poolChunks() const { return pool.size(); }
+    size_t mapSlots() const { return map.capacity(); }
+    size_t bytes() const { return pool.capacity() * (sizeof(EndlessChunk) + 1) + map.capacity() * 16; }
+    uint64_t chunksGenerated() const { return generated; }
+    uint64_t chunksEvicted() const { return evicted; }
+
+private:
+    uint64_t worldSeed;
+    GameRng rng;
+    ChunkMap map;
+    std::vector<EndlessChunk> pool;
+    std::vector<uint8_t> live;
+    std::vector<int32_t> freeList;
+    uint64_t generated;
+    uint64_t evicted;
+
+    EndlessChunk& chunkAt(int x, int y) {
+        return pool[load(x >> ENDLESS_CHUNK_SHIFT, y >> ENDLESS_CHUNK_SHIFT)];
+    }
+
+    int32_t load(int cx, int cy) {
+        uint64_t k = ChunkMap::key(cx, cy);
+        int32_t index = map.find(k);
+        if (index != ChunkMap::NONE) return index;
+        if (freeList.empty()) {
+            pool.push_back(EndlessChunk());
+            live.push_back(0);
+            freeList.push_back(static_cast<int32_t>(pool.size() - 1));
+        }
+        index = freeList.back();
+        freeList.pop_back();
+        generate(pool[index], cx, cy);
+        live[index] = 1;
+        map.insert(k, index);
+        ++generated;
+        return index;
+    }
+
+    // Everything about a fresh chunk follows from the seed and its
+    // coordinates: a few wall segments, then its food
+    void generate(EndlessChunk& c, int cx, int cy) {
+        memset(&c, 0, sizeof(c));
+        c.cx = cx;
+        c.cy = cy;
+        GameRng local(worldSeed ^ (ChunkMap::key(cx, cy) * 0x9E3779B97F4A7C15ULL));
+        int segments = local.below(4);
+        for (int s = 0; s < segments; ++s) {
+            int x = local.below(ENDLESS_CHUNK);
+            int y = local.below(ENDLESS_CHUNK);
+            int length = 3 + local.below(10);
+            bool across = local.below(2) == 0;
+            for (int i = 0; i < length; ++i) {
+                int wx = across ? x + i : x;
+                int wy = across ? y : y + i;
+                if (wx >= ENDLESS_CHUNK || wy >= ENDLESS_CHUNK) break;
+                c.wall[wy] |= 1u << wx;
+            }
+        }
+        // Keep the start clear
+        if ((cx == 0 || cx == -1) && (cy == 0 || cy == -1)) {
+            for (int y = 0; y < ENDLESS_CHUNK; ++y) {
+                int wy = cy * ENDLESS_CHUNK + y;
+                for (int x = 0; x < ENDLESS_CHUNK; ++x) {
+                    int wx = cx * ENDLESS_CHUNK + x;
+                    if (wx > -8 && wx < 8 && wy > -8 && wy < 8) c.wall[y] &= ~(1u << x);
+                }
+            }
+        }
+        for (int i = 0; i < ENDLESS_FOOD_PER_CHUNK; ++i) generateFood(c, local);
+    }
+
+    // Chunk-local: picks among this chunk's cells only
+    static void generateFood(EndlessChunk& c, GameRng& r) {
+        for (int tries = 0; tries < 64; ++tries) {
+            int x = r.below(ENDLESS_CHUNK);
+            int y = r.below(ENDLESS_CHUNK);
+            uint32_t mask = 1u << x;
+            if ((c.wall[y] | c.food[y] | c.body[y]) & mask) continue;
+            c.food[y] |= mask;
+            ++c.foodCount;
+            return;
+        }
+    }
+};
+
+class EndlessGame {
+public:
+    EndlessGame(uint64_t seed, int tickMicros)
+        : world(seed), period(tickMicros > 0 ? tickMicros : BASE_SPEED), rng(seed) {
+        restart();
+    }
+
+    void restart() {
+        world.reset(rng.next() | static_cast<uint64_t>(rng.next()) << 32);
+        body.clear();
+        body.push_back(Position(0, 0));
+        world.setBody(0, 0, true);
+        world.keepAround(0, 0);
+        dir = Position(1, 0);
+        wish = dir;
+        score = 0;
+        over = false;
+        paused = false;
+    }
+
+    // Advances one tick. Returns true on the tick the game ends.
+    bool step() {
+        if (over || paused) return false;
+        if (body.size() < 2 || !(Position(body[0].x + wish.x, body[0].y + wish.y) == body[1])) dir = wish;
+        Position next(body[0].x + dir.x, body[0].y + dir.y);
+        if (world.isWall(next.x, next.y) || world.isBody(next.x, next.y)) {
+            over = true;
+            return true;
+        }
+        bool grow = world.eatFood(next.x, next.y);
+        if (grow) score += FOOD_SCORE;
+        body.push_front(next);
+        world.setBody(next.x, next.y, true);
+        if (!grow) {
+            world.setBody(body.back().x, body.back().y, false);
+            body.pop_back();
+        }
+        if ((next.x >> ENDLESS_CHUNK_SHIFT) != (body[1].x >> ENDLESS_CHUNK_SHIFT) ||
+            (next.y >> ENDLESS_CHUNK_SHIFT) != (body[1].y >> ENDLESS_CHUNK_SHIFT)) {
+            world.keepAround(next.x, next.y);
+        }
+        return false;
+    }
+
+    void setDirection(const Position& d) { wish = d; }
+    const EndlessWorld& getWorld() const { return world; }
+    const std::deque<Position>& getBody() const { return body; }
+    int getScore() const { return score; }
+
+    int run() {
+        TerminalInput terminal;
+        std::cout << "\033[?25l";
+        uint64_t nextTick = monotonicNanos() / 1000 + period;
+        bool running = true;
+        draw();
+        while (running) {
+            uint64_t now = monotonicNanos() / 1000;
+            int timeout = over || paused ? -1 : (now >= nextTick ? 0 : static_cast<int>((nextTick - now + 999) / 1000));
+            struct pollfd pfd;
+            pfd.fd = STDIN_FILENO;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, timeout) > 0) {
+                running = readKeys(terminal);
+                if (over || paused) {
+                    nextTick = monotonicNanos() / 1000 + period;
+                    draw();
+                    continue;
+                }
+            }
+            now = monotonicNanos() / 1000;
+            if (now < nextTick) continue;
+            step();
+            // Terminal rows are taller than columns are wide
+            nextTick += dir.y != 0 ? period * 18 / 10 : period;
+            if (now > nextTick + period) nextTick = now + period;
+            draw();
+        }
+        std::cout << "\033[?25h";
+        return 0;
+    }
+
+private:
+    EndlessWorld world;
+    int period;
+    GameRng rng;
+    std::deque<Position> body;
+    Position dir;
+    Position wish;
+    int score;
+    bool over;
+    bool paused;
+
+    // Returns false on quit
+    bool readKeys(TerminalInput& terminal) {
+        while (terminal.kbhit()) {
+            char key = terminal.getch();
+            if (key == '\033') {
+                terminal.getch();
+                key = terminal.getch();
+                if (key == 'A') wish = Position(0, -1);
+                else if (key == 'B') wish = Position(0, 1);
+                else if (key == 'C') wish = Position(1, 0);
+                else if (key == 'D') wish = Position(-1, 0);
+                continue;
+            }
+            if (key >= 'A' && key <= 'Z') key = key + 32;
+            if (key == 'w') wish = Position(0, -1);
+            else if (key == 's') wish = Position(0, 1);
+            else if (key == 'a') wish = Position(-1, 0);
+            else if (key == 'd') wish = Position(1, 0);
+            else if (key == 'p' && !over) paused = !paused;
+            else if (key == 'r' && over) restart();
+            else if (key == 'q') return false;
+        }
+        return true;
+    }
+
+    // A viewport centred on the head; only loaded chunks are drawn
+    void draw() {
+        std::ostringstream frame;
+        frame << "\033[2J\033[H";
+        int left = body[0].x - ENDLESS_VIEW_WIDTH / 2;
+        int top = body[0].y - ENDLESS_VIEW_HEIGHT / 2;
+        std::string row(ENDLESS_VIEW_WIDTH, EMPTY);
+        for (int y = 0; y < ENDLESS_VIEW_HEIGHT; ++y) {
+            for (int x = 0; x < ENDLESS_VIEW_WIDTH; ++x) {
+                int wx = left + x;
+                int wy = top + y;
+                const EndlessChunk* c = world.peek(wx, wy);
+                char ch = EMPTY;
+                if (c) {
+                    if (EndlessWorld::bit(c->wall, wx, wy)) ch = WALL;
+                    else if (EndlessWorld::bit(c->body, wx, wy)) ch = SNAKE_BODY;
+                    else if (EndlessWorld::bit(c->food, wx, wy)) ch = FOOD;
+                }
+                row[x] = ch;
+            }
+            if (y == body[0].y - top) row[body[0].x - left] = SNAKE_HEAD;
+            frame << row << "\n";
+        }
+        frame << "\n  Score: " << score << "  |  Length: " << body.size()
+              << "  |  Position: " << body[0].x << "," << body[0].y << "\n";
+        frame << "  Chunks: " << world.liveChunks() << " live, " << world.poolChunks() << " pooled, "
+              << world.chunksGenerated() << " generated, " << world.chunksEvicted() << " evicted  |  "
+              << world.bytes() / 1024 << " KB\n";
+        if (over) frame << "  GAME OVER! R=Restart | Q=Quit\n";
+        else if (paused) frame << "  PAUSED - P=Resume | Q=Quit\n";
+        else frame << "  Controls: Arrow Keys or WASD | P=Pause | Q=Quit\n";
+        const std::string& out = frame.str();
+        std::cout.write(out.data(), out.size());
+        std::cout.flush();
+    }
+
+    EndlessGame(const EndlessGame&);
+    EndlessGame& operator=(const EndlessGame&);
+};
+
+#endif
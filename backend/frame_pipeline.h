@@ -0,0 +1,177 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <stdint.h>
+
+// Single-producer single-consumer ring. N must be a power of two. The two
+// indices live on separate cache lines so the threads do not contend.
+template <typename T, size_t N>
+class SpscQueue {
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // Producer side; returns false when full
+    bool push(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) return false;
+        items[t & (N - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool empty() const {
+        return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+    }
+
+    // Consumer side; returns false when empty
+    bool pop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        value = items[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[N];
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+// Lock-free hand-off of the newest value from one writer to one reader.
+// The writer fills its private slot and swaps it into the middle; the
+// reader swaps the middle out only if something new arrived. Neither side
+// ever waits, and a reader that falls behind simply skips to the latest.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle(1), back(2), front(0) {}
+
+    T& writeSlot() { return slots[back]; }
+
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Returns true and switches readSlot() to the newest value if one was
+    // published since the last call
+    bool consume() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T& readSlot() const { return slots[front]; }
+
+    // Any of the three slots, for sizing them before the threads start
+    T& slot(int i) { return slots[i]; }
+
+private:
+    static const unsigned INDEX = 3;
+    static const unsigned FRESH = 4;
+
+    T slots[3];
+    alignas(64) std::atomic<unsigned> middle;
+    unsigned back;
+    alignas(64) unsigned front;
+};
+
+// One composed screen, produced by the simulation and never modified once
+// published: the screen as cells (see glyph_renderer.h) for spectators and
+// the recorder, and the terminal bytes drawn from them
+struct FrameSnapshot {
+    std::string cells;
+    std::string text;
+    uint64_t tick;
+
+    FrameSnapshot() : tick(0) {}
+};
+
+// Composes text straight into a string, which keeps its capacity from one
+// frame to the next: once it has grown to frame size, composing a frame
+// allocates nothing. Numbers go through snprintf into a stack buffer
+// rather than the iostream machinery.
+class FrameWriter {
+public:
+    struct Padded {
+        long long value;
+        int width;
+    };
+
+    FrameWriter() : out(NULL) {}
+
+    // Clears text and appends to it from now on
+    void begin(std::string& text) {
+        out = &text;
+        out->clear();
+    }
+
+    FrameWriter& write(const char* s, size_t n) {
+        out->append(s, n);
+        return *this;
+    }
+
+    FrameWriter& operator<<(const char* s) {
+        out->append(s);
+        return *this;
+    }
+    FrameWriter& operator<<(const std::string& s) {
+        out->append(s);
+        return *this;
+    }
+    FrameWriter& operator<<(char c) {
+        out->push_back(c);
+        return *this;
+    }
+    FrameWriter& operator<<(int v) { return number("%d", v); }
+    FrameWriter& operator<<(unsigned v) { return number("%u", v); }
+    FrameWriter& operator<<(long v) { return number("%ld", v); }
+    FrameWriter& operator<<(unsigned long v) { return number("%lu", v); }
+    FrameWriter& operator<<(long long v) { return number("%lld", v); }
+    FrameWriter& operator<<(unsigned long long v) { return number("%llu", v); }
+    // Right-aligned in width columns, as setw did
+    FrameWriter& operator<<(const Padded& p) {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "%*lld", p.width, p.value);
+        out->append(buf, n);
+        return *this;
+    }
+
+    std::string& text() { return *out; }
+
+private:
+    std::string* out;
+
+    template <typename T>
+    FrameWriter& number(const char* format, T v) {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), format, v);
+        out->append(buf, n);
+        return *this;
+    }
+};
+
+inline FrameWriter::Padded padded(long long value, int width) {
+    FrameWriter::Padded p = {value, width};
+    return p;
+}
+
+// Output counters kept by the render thread and read by the simulation for
+// the HUD. Each field has a single writer; relaxed loads are fine for display.
+struct FrameStats {
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint32_t> fpsTenths;
+    std::atomic<uint32_t> backlogBytes;
+    std::atomic<uint32_t> drainMicros;
+    std::atomic<uint64_t> allocations;  // by the render thread, since it started
+
+    FrameStats() : written(0), dropped(0), fpsTenths(0), backlogBytes(0), drainMicros(0), allocations(0) {}
+};
+
+#endif
@@ -0,0 +1,665 @@
+#ifndef GAME_ENGINE_H
+#define GAME_ENGINE_H
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+#include "snake_core.h"
+#include "tick_scheduler.h"
+#include "item_layer.h"
+#include "level_format.h"
+#include "wire_format.h"
+
+// Regular food can fill at most half the playable cells
+const int MAX_FOODS = (BOARD_WIDTH - 2) * (BOARD_HEIGHT - 2) / 2;
+
+// The rules of a single-player game with no terminal, clock or file access.
+// SnakeGame drives one of these from the keyboard; servers drive thousands.
+class GameEngine {
+public:
+    GameEngine(uint64_t seed = 1)
+        : level(&LevelMap::standard()),
+          snake(BOARD_WIDTH / 2, BOARD_HEIGHT / 2),
+          foodTarget(1),
+          score(0),
+          foodsEaten(0),
+          tickNumber(0),
+          specialReadyTick(0),
+          poisonReadyTick(0),
+          specialSpawnEvent(TickScheduler::NONE),
+          poisonSpawnEvent(TickScheduler::NONE),
+          gameOver(false),
+          gamePaused(false),
+          easyMode(false),
+          wrapMode(false),
+          speedMode(2),
+          rng(seed) {
+        reset();
+    }
+
+    void seed(uint64_t value) { rng.seed(value); }
+
+    void setModes(bool easy, bool wrap, int speed) {
+        easyMode = easy;
+        wrapMode = wrap;
+        speedMode = speed;
+    }
+
+    // Number of regular foods kept on the board; applies from the next reset
+    void setFoodCount(int count) {
+        foodTarget = count < 1 ? 1 : (count > MAX_FOODS ? MAX_FOODS : count);
+    }
+
+    // The map is shared, not copied, and must outlive the engine. Takes
+    // effect immediately and restarts the game.
+    void setLevel(const LevelMap* map) {
+        level = map;
+        items = ItemLayer(level->width(), level->height());
+        reset();
+    }
+
+    // Most bytes writeState can produce on this level: a cell-index varint
+    // per body cell (4 bytes on the largest levels) plus the items and
+    // events, each a few varints
+    size_t stateBytesBound() const {
+        size_t cellBytes = 1;
+        for (uint32_t cells = level->cellCount(); cells >= 0x80; cells >>= 7) ++cellBytes;
+        return 64 + cellBytes * static_cast<size_t>(level->freeCount()) +
+               32 * (static_cast<size_t>(foodTarget) + 2) + 24 * EVENT_RESERVE;
+    }
+
+    // Sizes the snake, the item layer and the event queue for the largest
+    // game this level and food count allow, so update() never allocates.
+    // An engine among thousands (the telnet server's) skips this and lets
+    // each game grow what it needs. setLevel drops the reservation.
+    void reserveCapacity() {
+        snake.reserve(level->freeCount() + 1);
+        size_t itemCount = static_cast<size_t>(foodTarget) + 2;
+        // An easy-mode restart journals every item removed and placed
+        items.reserve(itemCount, itemCount * 2 + 8);
+        events.reserve(EVENT_RESERVE);
+    }
+
+    void reset() {
+        respawnSnake();
+        score = 0;
+        foodsEaten = 0;
+        gameOver = false;
+        gamePaused = false;
+        tickNumber = 0;
+        events.clear();
+        restartItems();
+    }
+
+    void setDirection(const Position& dir) { snake.setDirection(dir); }
+    void setPaused(bool paused) { gamePaused = paused; }
+
+    const Snake& getSnake() const { return snake; }
+    const LevelMap& getLevelMap() const { return *level; }
+    int getWidth() const { return level->width(); }
+    int getHeight() const { return level->height(); }
+    const ItemLayer& getItems() const { return items; }
+    bool specialFoodActive() const { return items.count(ITEM_SPECIAL) > 0; }
+    bool poisonFoodActive() const { return items.count(ITEM_POISON) > 0; }
+    int getFoodCount() const { return foodTarget; }
+    int getScore() const { return score; }
+    int getFoodsEaten() const { return foodsEaten; }
+    bool isGameOver() const { return gameOver; }
+    // The game also ends once every free cell holds the snake or poison
+    bool isBoardFilled() const {
+        return snake.getBody().size() + items.count(ITEM_POISON) >= level->freeCount();
+    }
+    bool isPaused() const { return gamePaused; }
+    bool isEasyMode() const { return easyMode; }
+    bool isWrapMode() const { return wrapMode; }
+    int getSpeedMode() const { return speedMode; }
+    uint64_t getTick() const { return tickNumber; }
+    uint64_t getRngState() const { return rng.getState(); }
+
+    RuleTimers getTimers() const {
+        RuleTimers t;
+        t.specialReady = specialReadyTick;
+        t.poisonReady = poisonReadyTick;
+        t.specialSpawn = eventDue(specialSpawnEvent);
+        const Item* special = firstOf(ITEM_SPECIAL);
+        t.specialExpire = special ? special->expiresAt : 0;
+        t.poisonSpawn = eventDue(poisonSpawnEvent);
+        return t;
+    }
+
+    int getLevel() const {
+        return foodsEaten / FOODS_PER_LEVEL + 1;
+    }
+
+    int calculateSpeed() const {
+        int level = getLevel();
+        int speed = BASE_SPEED - (level - 1) * SPEED_STEP;
+        if (speed < MIN_SPEED) speed = MIN_SPEED;
+        return speed;
+    }
+
+    int getAdjustedSpeed() const {
+        int baseSpeed = calculateSpeed();
+        if (speedMode == 1) baseSpeed = static_cast<int>(baseSpeed * 1.5);
+        else if (speedMode == 3) baseSpeed = static_cast<int>(baseSpeed * 0.7);
+        if (snake.getDirection().y != 0) {
+            return static_cast<int>(baseSpeed * 1.8);
+        }
+        return baseSpeed;
+    }
+
+    // Advances one tick. Returns true on the tick the game ends.
+    bool update() {
+        if (gameOver || gamePaused) return false;
+
+        ++tickNumber;
+        items.clearChanges();
+        runDueEvents();
+        if (isBoardFilled()) {
+            gameOver = true;
+            return true;
+        }
+
+        Position dir = snake.getDirection();
+        Position newHead = snake.head();
+        newHead.x += dir.x;
+        newHead.y += dir.y;
+
+        int width = level->width();
+        int height = level->height();
+        if (wrapMode) {
+            if (newHead.x <= 0) newHead.x = width - 2;
+            else if (newHead.x >= width - 1) newHead.x = 1;
+            if (newHead.y <= 0) newHead.y = height - 2;
+            else if (newHead.y >= height - 1) newHead.y = 1;
+        }
+        uint32_t cell = static_cast<uint32_t>(newHead.y * width + newHead.x);
+        if (level->isPortal(cell)) {
+            cell = level->portalTarget(cell);
+            newHead = Position(cell % width, cell / width);
+        }
+
+        if (checkCollision(newHead, cell)) {
+            if (easyMode) {
+                handleCollisionInEasyMode();
+                return false;
+            }
+            gameOver = true;
+            return true;
+        }
+
+        bool grew = handleFoodCollision(newHead);
+        snake.moveTo(newHead, grew);
+        if (isBoardFilled()) {
+            gameOver = true;
+            return true;
+        }
+        return false;
+    }
+
+    // Timers are written as the countdowns the format has always used. The
+    // first food goes where the single food always went; any others follow
+    // the snake on one extra line that older builds simply never read.
+    void save(ostream& file) const {
+        const Item* special = firstOf(ITEM_SPECIAL);
+        const Item* poison = firstOf(ITEM_POISON);
+        const Item* food = firstOf(ITEM_FOOD);
+        Position none;
+        int specialFoodTimer = special ? ticksUntil(special->expiresAt) : 0;
+        int specialCooldown = special ? SPECIAL_COOLDOWN_INIT : ticksUntil(specialReadyTick);
+        int poisonCooldown = poison ? POISON_COOLDOWN_INIT : ticksUntil(poisonReadyTick);
+        const Position& specialPos = special ? special->pos : none;
+        const Position& poisonPos = poison ? poison->pos : none;
+        const Position& foodPos = food ? food->pos : none;
+        file << score << " " << foodsEaten << " "
+             << easyMode << " " << wrapMode << " " << speedMode << " "
+             << (special != NULL) << " " << specialPos.x << " " << specialPos.y << " "
+             << specialFoodTimer << " " << specialCooldown << " "
+             << (poison != NULL) << " " << poisonPos.x << " " << poisonPos.y << " "
+             << poisonCooldown << "\n";
+
+        file << foodPos.x << " " << foodPos.y << "\n";
+
+        const vector<Position>& body = snake.getBody();
+        file << body.size() << "\n";
+        for (const auto& seg : body) {
+            file << seg.x << " " << seg.y << "\n";
+        }
+        Position dir = snake.getDirection();
+        file << dir.x << " " << dir.y << "\n";
+
+        if (items.count(ITEM_FOOD) > 1) {
+            file << items.count(ITEM_FOOD) - 1;
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (items[i].type == ITEM_FOOD && &items[i] != food) {
+                    file << " " << items[i].pos.x << " " << items[i].pos.y;
+                }
+            }
+            file << "\n";
+        }
+    }
+
+    bool load(istream& file) {
+        int loadedScore, loadedFoods, easyFlag, wrapFlag, loadedSpeed;
+        int hasSpec, hasPois;
+        Position spec, pois, loadedFood;
+        int specTimer, specCooldown, poisCooldown;
+        file >> loadedScore >> loadedFoods
+             >> easyFlag >> wrapFlag >> loadedSpeed
+             >> hasSpec >> spec.x >> spec.y
+             >> specTimer >> specCooldown
+             >> hasPois >> pois.x >> pois.y
+             >> poisCooldown;
+        file >> loadedFood.x >> loadedFood.y;
+
+        size_t len;
+        file >> len;
+        if (!file || len == 0 || len > level->cellCount()) return false;
+        vector<Position> body;
+        body.reserve(len);
+        for (size_t i = 0; i < len; ++i) {
+            Position p;
+            file >> p.x >> p.y;
+            body.push_back(p);
+        }
+        Position dir;
+        file >> dir.x >> dir.y;
+
+        if (!file || abs(dir.x) + abs(dir.y) != 1) return false;
+        for (size_t i = 0; i < body.size(); ++i) {
+            if (!onBoard(body[i])) return false;
+        }
+
+        vector<Position> foods(1, loadedFood);
+        int extra;
+        if (file >> extra) {
+            if (extra < 0 || extra >= MAX_FOODS) return false;
+            for (int i = 0; i < extra; ++i) {
+                Position p;
+                if (!(file >> p.x >> p.y)) return false;
+                foods.push_back(p);
+            }
+        }
+        for (size_t i = 0; i < foods.size(); ++i) {
+            if (!onBoard(foods[i])) return false;
+        }
+        if ((hasSpec && !onBoard(spec)) || (hasPois && !onBoard(pois))) return false;
+
+        score = loadedScore;
+        foodsEaten = loadedFoods;
+        easyMode = (easyFlag != 0);
+        wrapMode = (wrapFlag != 0);
+        speedMode = loadedSpeed;
+        snake.setBodyAndDirection(body, dir);
+        gameOver = false;
+        gamePaused = false;
+        foodTarget = static_cast<int>(foods.size());
+
+        tickNumber = 0;
+        events.clear();
+        items.clear();
+        specialSpawnEvent = poisonSpawnEvent = TickScheduler::NONE;
+        for (size_t i = 0; i < foods.size(); ++i) {
+            if (items.find(foods[i]) == ItemLayer::NO_ITEM) items.add(ITEM_FOOD, foods[i]);
+        }
+        if (hasSpec && items.find(spec) == ItemLayer::NO_ITEM) {
+            placeSpecialFood(spec, specTimer > 0 ? specTimer : 1);
+        } else {
+            scheduleSpecialSpawn(specCooldown > 0 ? specCooldown : 0);
+        }
+        if (hasPois && items.find(pois) == ItemLayer::NO_ITEM) {
+            items.add(ITEM_POISON, pois);
+        } else {
+            schedulePoisonSpawn(poisCooldown > 0 ? poisCooldown : 0);
+        }
+        return true;
+    }
+
+    // Compact binary copy of everything update() depends on, for history
+    // keyframes. The level is not included; it must be the same on restore.
+    void writeState(WireWriter& w) const {
+        w.varint(tickNumber);
+        w.varint(static_cast<uint32_t>(score));
+        w.varint(static_cast<uint32_t>(foodsEaten));
+        w.u8((gameOver ? 1 : 0) | (gamePaused ? 2 : 0) | (easyMode ? 4 : 0) | (wrapMode ? 8 : 0));
+        w.u8(static_cast<uint8_t>(speedMode));
+        w.varint(static_cast<uint32_t>(foodTarget));
+        w.u64(rng.getState());
+        w.varint(specialReadyTick);
+        w.varint(poisonReadyTick);
+        w.varint(specialSpawnEvent);
+        w.varint(poisonSpawnEvent);
+
+        int width = level->width();
+        const vector<Position>& body = snake.getBody();
+        Position dir = snake.getDirection();
+        w.u8(static_cast<uint8_t>((dir.x + 1) | ((dir.y + 1) << 2)));
+        w.varint(static_cast<uint32_t>(body.size()));
+        for (size_t i = 0; i < body.size(); ++i) {
+            w.varint(static_cast<uint32_t>(body[i].y * width + body[i].x));
+        }
+
+        w.varint(static_cast<uint32_t>(items.size()));
+        for (size_t i = 0; i < items.size(); ++i) {
+            const Item& item = items[i];
+            w.u8(item.type);
+            w.varint(static_cast<uint32_t>(item.pos.y * width + item.pos.x));
+            w.varint(item.expiryEvent);
+            w.varint(item.expiresAt);
+        }
+
+        const vector<ScheduledEvent>& pending = events.pending();
+        w.varint(events.sequence());
+        w.varint(static_cast<uint32_t>(pending.size()));
+        for (size_t i = 0; i < pending.size(); ++i) {
+            w.varint(pending[i].due);
+            w.varint(pending[i].seq);
+            w.u8(static_cast<uint8_t>(pending[i].kind));
+            w.varint(pending[i].target);
+        }
+    }
+
+    bool readState(WireReader& r) {
+        uint64_t tick = r.varint64();
+        int newScore = static_cast<int>(r.varint());
+        int newFoods = static_cast<int>(r.varint());
+        uint8_t flags = r.u8();
+        int newSpeed = r.u8();
+        int newTarget = static_cast<int>(r.varint());
+        uint64_t rngState = r.u64();
+        uint64_t specialReady = r.varint64();
+        uint64_t poisonReady = r.varint64();
+        uint32_t specialSpawn = r.varint();
+        uint32_t poisonSpawn = r.varint();
+
+        uint32_t cells = level->cellCount();
+        int width = level->width();
+        uint8_t dirByte = r.u8();
+        Position dir((dirByte & 3) - 1, ((dirByte >> 2) & 3) - 1);
+        uint32_t len = r.varint();
+        if (!r.ok() || len == 0 || len > cells) return false;
+        vector<Position> body(len);
+        for (uint32_t i = 0; i < len; ++i) {
+            uint32_t cell = r.varint();
+            if (cell >= cells) return false;
+            body[i] = Position(cell % width, cell / width);
+        }
+
+        uint32_t itemCount = r.varint();
+        if (!r.ok() || itemCount > cells) return false;
+        vector<Item> restored(itemCount);
+        for (uint32_t i = 0; i < itemCount; ++i) {
+            restored[i].type = r.u8();
+            uint32_t cell = r.varint();
+            restored[i].expiryEvent = r.varint();
+            restored[i].expiresAt = r.varint64();
+            if (cell >= cells || restored[i].type == ITEM_NONE || restored[i].type >= ITEM_TYPES) return false;
+            restored[i].pos = Position(cell % width, cell / width);
+        }
+
+        uint32_t seq = r.varint();
+        uint32_t eventCount = r.varint();
+        if (!r.ok() || eventCount > cells * 4) return false;
+        vector<ScheduledEvent> pending(eventCount);
+        for (uint32_t i = 0; i < eventCount; ++i) {
+            pending[i].due = r.varint64();
+            pending[i].seq = r.varint();
+            pending[i].kind = r.u8();
+            pending[i].target = r.varint();
+        }
+        if (!r.ok()) return false;
+
+        tickNumber = tick;
+        score = newScore;
+        foodsEaten = newFoods;
+        gameOver = (flags & 1) != 0;
+        gamePaused = (flags & 2) != 0;
+        easyMode = (flags & 4) != 0;
+        wrapMode = (flags & 8) != 0;
+        speedMode = newSpeed;
+        foodTarget = newTarget;
+        rng.seed(rngState);
+        specialReadyTick = specialReady;
+        poisonReadyTick = poisonReady;
+        specialSpawnEvent = specialSpawn;
+        poisonSpawnEvent = poisonSpawn;
+        snake.setBodyAndDirection(body, dir);
+        items.clear();
+        for (uint32_t i = 0; i < itemCount; ++i) {
+            Item& item = items.add(restored[i].type, restored[i].pos);
+            item.expiryEvent = restored[i].expiryEvent;
+            item.expiresAt = restored[i].expiresAt;
+        }
+        items.clearChanges();
+        events.restore(pending, seq);
+        return true;
+    }
+
+private:
+    const LevelMap* level;
+    Snake snake;
+    ItemLayer items;
+    int foodTarget;
+    int score;
+    int foodsEaten;
+    uint64_t tickNumber;
+    uint64_t specialReadyTick;
+    uint64_t poisonReadyTick;
+    uint32_t specialSpawnEvent;
+    uint32_t poisonSpawnEvent;
+    TickScheduler events;
+    bool gameOver;
+    bool gamePaused;
+    bool easyMode;
+    bool wrapMode;
+    int speedMode;
+    GameRng rng;
+
+    // Superseded events wait in the queue until due; a handful at most
+    static const size_t EVENT_RESERVE = 64;
+
+    enum EventKind {
+        EVENT_SPECIAL_SPAWN = 1,
+        EVENT_SPECIAL_EXPIRE,
+        EVENT_POISON_SPAWN
+    };
+
+    // Samples the level's reachable floor, so walls and sealed-off pockets
+    // never receive food
+    Position generateFood() {
+        Position newFood;
+        bool valid = false;
+        const vector<Position>& body = snake.getBody();
+        int width = level->width();
+        int freeCount = static_cast<int>(level->freeCount());
+        while (!valid) {
+            uint32_t cell = level->freeCell(rng.below(freeCount));
+            newFood = Position(cell % width, cell / width);
+            valid = items.find(newFood) == ItemLayer::NO_ITEM;
+            for (size_t i = 0; valid && i < body.size(); ++i) {
+                if (body[i] == newFood) valid = false;
+            }
+        }
+        return newFood;
+    }
+
+    // True while some cell is held by neither the snake, an item nor the
+    // pending cells (the head about to move in). Spawns that find no room
+    // are dropped, so generateFood is never asked to search a full board.
+    bool hasRoom(size_t pending) const {
+        return snake.getBody().size() + items.size() + pending < level->freeCount();
+    }
+
+    bool onBoard(const Position& p) const {
+        return p.x > 0 && p.y > 0 && p.x < level->width() - 1 && p.y < level->height() - 1 &&
+               !level->isWall(static_cast<uint32_t>(p.y * level->width() + p.x));
+    }
+
+    void respawnSnake() {
+        uint32_t spawns = level->spawnCount();
+        uint32_t cell = level->spawnCell(spawns > 1 ? rng.below(spawns) : 0);
+        snake.respawn(cell % level->width(), cell / level->width());
+    }
+
+    const Item* firstOf(int type) const {
+        if (items.count(type) == 0) return NULL;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (items[i].type == type) return &items[i];
+        }
+        return NULL;
+    }
+
+    // When the live event seq fires; 0 for NONE
+    uint64_t eventDue(uint32_t seq) const {
+        if (seq == TickScheduler::NONE) return 0;
+        const vector<ScheduledEvent>& pending = events.pending();
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (pending[i].seq == seq) return pending[i].due;
+        }
+        return 0;
+    }
+
+    int ticksUntil(uint64_t tick) const {
+        return tick > tickNumber ? static_cast<int>(tick - tickNumber) : 0;
+    }
+
+    // A cooldown of n ticks followed by a chance roll every tick is drawn
+    // up front as one spawn tick; eating food adds an extra roll on top
+    void scheduleSpecialSpawn(int cooldown) {
+        specialReadyTick = tickNumber + cooldown;
+        specialSpawnEvent = events.schedule(specialReadyTick + rng.trialsUntil(SPECIAL_FOOD_CHANCE),
+                                            EVENT_SPECIAL_SPAWN);
+    }
+
+    void schedulePoisonSpawn(int cooldown) {
+        poisonReadyTick = tickNumber + cooldown;
+        poisonSpawnEvent = events.schedule(poisonReadyTick + rng.trialsUntil(POISON_FOOD_CHANCE),
+                                           EVENT_POISON_SPAWN);
+    }
+
+    // Expiry events name their cell; the item there must still carry the
+    // event's seq for it to count
+    void placeSpecialFood(const Position& p, int lifetime) {
+        Item& item = items.add(ITEM_SPECIAL, p);
+        item.expiresAt = tickNumber + lifetime;
+        item.expiryEvent = events.schedule(item.expiresAt, EVENT_SPECIAL_EXPIRE,
+                                           static_cast<uint32_t>(p.y * level->width() + p.x));
+        specialSpawnEvent = TickScheduler::NONE;
+    }
+
+    void placePoisonFood() {
+        items.add(ITEM_POISON, generateFood());
+        poisonSpawnEvent = TickScheduler::NONE;
+    }
+
+    void rollSpecialFood() {
+        if (items.count(ITEM_SPECIAL) == 0 && tickNumber >= specialReadyTick &&
+            rng.below(100) < SPECIAL_FOOD_CHANCE && hasRoom(1)) {
+            placeSpecialFood(generateFood(), SPECIAL_FOOD_LIFETIME);
+        }
+    }
+
+    void rollPoisonFood() {
+        if (items.count(ITEM_POISON) == 0 && tickNumber >= poisonReadyTick &&
+            rng.below(100) < POISON_FOOD_CHANCE && hasRoom(1)) {
+            placePoisonFood();
+        }
+    }
+
+    void expireSpecialFood(const ScheduledEvent& ev) {
+        Position p(ev.target % level->width(), ev.target / level->width());
+        int index = items.find(p);
+        if (index == ItemLayer::NO_ITEM || items[index].expiryEvent != ev.seq) return;
+        items.remove(index);
+        scheduleSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+    }
+
+    // Superseded events are skipped: each mechanic keeps only its live seq
+    void runDueEvents() {
+        ScheduledEvent ev;
+        while (events.popDue(tickNumber, ev)) {
+            switch (ev.kind) {
+            case EVENT_SPECIAL_SPAWN:
+                if (ev.seq != specialSpawnEvent) break;
+                if (hasRoom(0)) placeSpecialFood(generateFood(), SPECIAL_FOOD_LIFETIME);
+                else scheduleSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+                break;
+            case EVENT_SPECIAL_EXPIRE:
+                expireSpecialFood(ev);
+                break;
+            case EVENT_POISON_SPAWN:
+                if (ev.seq != poisonSpawnEvent) break;
+                if (hasRoom(0)) placePoisonFood();
+                else schedulePoisonSpawn(POISON_COOLDOWN_INIT);
+                break;
+            }
+        }
+    }
+
+    void restartItems() {
+        items.clear();
+        int foods = foodTarget;
+        if (foods > static_cast<int>(level->freeCount() / 2)) foods = level->freeCount() / 2;
+        for (int i = 0; i < foods; ++i) items.add(ITEM_FOOD, generateFood());
+        scheduleSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+        schedulePoisonSpawn(POISON_COOLDOWN_INIT);
+    }
+
+    // The border is part of the wall bitmap, so terrain of any shape costs
+    // one bit test
+    bool checkCollision(const Position& head, uint32_t cell) {
+        if (level->isWall(cell)) {
+            return true;
+        }
+        if (snake.hitsSelf(head)) {
+            return true;
+        }
+        return false;
+    }
+
+    // One lookup in the item grid replaces comparing the head against each item
+    bool handleFoodCollision(const Position& head) {
+        int index = items.find(head);
+        if (index == ItemLayer::NO_ITEM) return false;
+        int type = items[index].type;
+        items.remove(index);
+        if (type == ITEM_SPECIAL) {
+            score += SPECIAL_SCORE;
+            foodsEaten++;
+            scheduleSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+            relocateFood();
+            return true;
+        } else if (type == ITEM_POISON) {
+            score -= POISON_PENALTY;
+            if (score < 0) score = 0;
+            snake.shrink(3);
+            schedulePoisonSpawn(POISON_COOLDOWN_INIT);
+            return false;
+        }
+        score += FOOD_SCORE;
+        foodsEaten++;
+        if (hasRoom(1)) items.add(ITEM_FOOD, generateFood());
+        rollSpecialFood();
+        rollPoisonFood();
+        return true;
+    }
+
+    // Eating a bonus has always moved the regular food somewhere new
+    void relocateFood() {
+        const Item* food = firstOf(ITEM_FOOD);
+        if (!food) return;
+        items.remove(items.find(food->pos));
+        items.add(ITEM_FOOD, generateFood());
+    }
+
+    void handleCollisionInEasyMode() {
+        score -= 50;
+        if (score < 0) score = 0;
+        respawnSnake();
+        foodsEaten = 0;
+        restartItems();
+    }
+};
+
+#endif
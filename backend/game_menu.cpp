@@ -9,6 +9,9 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/select.h>
+#include <poll.h>
+#include "score_service.h"
+#include "live_metrics.h"
 
 using namespace std;
 
@@ -47,20 +50,34 @@ public:
         loadScores();
     }
     
+    // Asks the score daemon first and reads the file only if none is running
     void loadScores() {
-        scores.clear();
+        string board;
+        if (fetchScoresFromService(board)) {
+            istringstream in(board);
+            readScores(in);
+            return;
+        }
         ifstream file(scoreFile);
         if (file.is_open()) {
-            int score;
-            string timestamp;
-            while (file >> score) {
-                file.ignore();
-                getline(file, timestamp);
-                scores.push_back(ScoreEntry(score, timestamp));
-            }
+            readScores(file);
             file.close();
-            sort(scores.begin(), scores.end(), greater<ScoreEntry>());
+        } else {
+            scores.clear();
+        }
+    }
+    
+    // Reads "score timestamp" lines, as stored in the file and sent by the daemon
+    void readScores(istream& in) {
+        scores.clear();
+        int score;
+        string timestamp;
+        while (in >> score) {
+            in.ignore();
+            getline(in, timestamp);
+            scores.push_back(ScoreEntry(score, timestamp));
         }
+        sort(scores.begin(), scores.end(), greater<ScoreEntry>());
     }
     
     void saveScore(int score) {
@@ -70,6 +87,11 @@ public:
         if (scores.size() > 10) {
             scores.resize(10);
         }
+        if (submitScoreToService(score, timestamp)) {
+            return;
+        }
+        
+        // No daemon: write the file ourselves
         ofstream file(scoreFile);
         if (file.is_open()) {
             for (const auto& entry : scores) {
@@ -169,8 +191,18 @@ class GameMenu {
 private:
     ScoreTracker scoreTracker;
     MenuInput input;
+    ScoreWatch scoreWatch;
     int selectedOption;
     
+    // Takes the latest board pushed by the score daemon, if one arrived
+    bool refreshScores() {
+        string board;
+        if (!scoreWatch.readUpdate(board)) return false;
+        istringstream in(board);
+        scoreTracker.readScores(in);
+        return true;
+    }
+    
     void clearScreen() {
         system("clear");
     }
@@ -186,6 +218,7 @@ private:
         cout << "  " << (selectedOption == 0 ? ">> " : "   ") << "1. Start New Game\n";
         cout << "  " << (selectedOption == 1 ? ">> " : "   ") << "2. View Leaderboard\n";
         cout << "  " << (selectedOption == 2 ? ">> " : "   ") << "3. Quit\n";
+        cout << "  " << (selectedOption == 3 ? ">> " : "   ") << "4. Live Games\n";
         
         cout << "\n";
         cout << "  High Score: " << setw(6) << scoreTracker.getHighScore() << "\n";
@@ -193,12 +226,50 @@ private:
         cout << "  Use Arrow Keys or W/S to navigate, Enter to select\n";
     }
     
-    void displayLeaderboard() {
+    void showLeaderboard() {
         clearScreen();
-        scoreTracker.loadScores(); // Reload to get latest scores
         scoreTracker.displayLeaderboard();
         cout << "\n  Press any key to return to menu...\n";
-        input.waitForKey();
+        cout.flush();
+    }
+    
+    // Redrawn whenever the daemon pushes a new board
+    void displayLeaderboard() {
+        if (scoreWatch.fd() < 0) {
+            scoreTracker.loadScores(); // No daemon: reload to get latest scores
+        }
+        showLeaderboard();
+        while (true) {
+            struct pollfd fds[2];
+            fds[0].fd = STDIN_FILENO;
+            fds[0].events = POLLIN;
+            fds[1].fd = scoreWatch.fd();
+            fds[1].events = POLLIN;
+            poll(fds, fds[1].fd >= 0 ? 2 : 1, -1);
+            if (fds[0].revents) {
+                input.getKey();
+                return;
+            }
+            if (refreshScores()) showLeaderboard();
+        }
+    }
+    
+    // Games publish their counters to shared memory every tick (see
+    // live_metrics.h); there is nothing to wait on, so redraw once a second
+    void displayLiveGames() {
+        while (true) {
+            clearScreen();
+            cout << "\n  Live games on this machine\n\n" << formatLiveGames(listLiveGames())
+                 << "\n  Press any key to return to menu...\n";
+            cout.flush();
+            struct pollfd pfd;
+            pfd.fd = STDIN_FILENO;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, 1000) > 0) {
+                input.getKey();
+                return;
+            }
+        }
     }
     
     int runGame() {
@@ -230,20 +301,27 @@ private:
 public:
     GameMenu() : selectedOption(0) {
         scoreTracker.loadScores();
+        scoreWatch.open();
     }
     
     void run() {
         while (true) {
             displayMenu();
             
-            // Wait for input - use blocking mode for better responsiveness
+            // Sleep until a key or a score update arrives; no polling timer
             char key = 0;
             while (key == 0) {
-                if (input.kbhit()) {
+                struct pollfd fds[2];
+                fds[0].fd = STDIN_FILENO;
+                fds[0].events = POLLIN;
+                fds[1].fd = scoreWatch.fd();
+                fds[1].events = POLLIN;
+                poll(fds, fds[1].fd >= 0 ? 2 : 1, -1);
+                if (fds[0].revents) {
                     key = input.getKey();
-                    break;
+                    if (key != 0) break;
                 }
-                usleep(50000); // 50ms delay
+                if (refreshScores()) displayMenu();
             }
             
             if (key == '\033') {
@@ -254,18 +332,18 @@ public:
                         char arrow = input.getKey();
                         switch (arrow) {
                             case 'A': // Up
-                                selectedOption = (selectedOption - 1 + 3) % 3;
+                                selectedOption = (selectedOption - 1 + 4) % 4;
                                 break;
                             case 'B': // Down
-                                selectedOption = (selectedOption + 1) % 3;
+                                selectedOption = (selectedOption + 1) % 4;
                                 break;
                         }
                     }
                 }
             } else if (key == 'w' || key == 'W') {
-                selectedOption = (selectedOption - 1 + 3) % 3;
+                selectedOption = (selectedOption - 1 + 4) % 4;
             } else if (key == 's' || key == 'S') {
-                selectedOption = (selectedOption + 1) % 3;
+                selectedOption = (selectedOption + 1) % 4;
             } else if (key == '\n' || key == '\r' || key == ' ') {
                 // Enter or Space
                 switch (selectedOption) {
@@ -284,6 +362,9 @@ public:
                         clearScreen();
                         cout << "\n  Thanks for playing!\n\n";
                         return;
+                    case 3: // Live games, after Quit so '3' still quits
+                        displayLiveGames();
+                        break;
                 }
             } else if (key == '1') {
                 int finalScore = runGame();
@@ -296,6 +377,8 @@ public:
                 clearScreen();
                 cout << "\n  Thanks for playing!\n\n";
                 return;
+            } else if (key == '4') {
+                displayLiveGames();
             }
         }
     }
@@ -0,0 +1,187 @@
+#ifndef GLYPH_RENDERER_H
+#define GLYPH_RENDERER_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "level_format.h"
+#include "snake_core.h"
+
+// Turns the board's cell characters into terminal bytes: plain ASCII as
+// before, or with 256-color or truecolor foregrounds and Unicode block
+// glyphs. Every cell type's glyph and color sequence is encoded once up
+// front; drawing a row is then table lookups and appends.
+//
+// A screen is first composed as cells, one byte per terminal column: text
+// as it is, board and legend symbols with the high bit set (markBoard,
+// markCell). appendCells turns any run of cells into terminal bytes, so
+// the local frame and the spectator and recording diffs, which compare
+// cells and position by cell column, draw the same way.
+//
+// Only foreground colors are used, so a blank cell looks the same whatever
+// color is set. Blanks therefore never change the color, and a color is
+// emitted only where a visible cell differs from the last visible cell: a
+// bordered row of walls and blanks costs no escape at all, and a snake is
+// one escape however long it is.
+
+const char SGR_RESET[] = "\033[0m";
+const size_t SGR_RESET_LEN = sizeof(SGR_RESET) - 1;
+
+enum ColorMode {
+    COLOR_NONE,
+    COLOR_256,
+    COLOR_TRUE
+};
+
+class GlyphRenderer {
+public:
+    GlyphRenderer() : colors(COLOR_NONE), unicode(false) { configure(COLOR_NONE, false); }
+
+    // "256" or "truecolor"; false for anything else
+    static bool parseColorMode(const std::string& name, ColorMode& mode) {
+        if (name == "256") mode = COLOR_256;
+        else if (name == "truecolor") mode = COLOR_TRUE;
+        else return false;
+        return true;
+    }
+
+    void configure(ColorMode colorMode, bool unicodeGlyphs) {
+        colors = colorMode;
+        unicode = unicodeGlyphs;
+        for (int c = 0; c < 128; ++c) {
+            glyphs[c].len = 1;
+            glyphs[c].bytes[0] = static_cast<char>(c);
+            glyphs[c].attr = ATTR_NONE;
+        }
+        attrs[ATTR_NONE].len = 0;
+        maxSgr = 0;
+        size_t count;
+        const Style* styles = styleTable(count);
+        for (size_t i = 0; i < count; ++i) {
+            const Style& s = styles[i];
+            Glyph& g = glyphs[static_cast<unsigned char>(s.cell)];
+            if (unicode) {
+                g.len = static_cast<uint8_t>(strlen(s.utf8));
+                memcpy(g.bytes, s.utf8, g.len);
+            }
+            if (colors == COLOR_NONE) continue;
+            g.attr = s.attr;
+            Sgr& a = attrs[s.attr];
+            int n = colors == COLOR_256 ? snprintf(a.bytes, sizeof(a.bytes), "\033[38;5;%dm", s.index)
+                                        : snprintf(a.bytes, sizeof(a.bytes), "\033[38;2;%d;%d;%dm", s.r, s.g, s.b);
+            a.len = static_cast<uint8_t>(n);
+            if (a.len > maxSgr) maxSgr = a.len;
+        }
+    }
+
+    bool plain() const { return colors == COLOR_NONE && !unicode; }
+
+    // Most bytes a width x height board can take, for sizing frame buffers
+    size_t maxBoardBytes(int width, int height) const {
+        size_t perCell = maxSgr + (unicode ? 3 : 1);
+        return (perCell * width + 1) * height + SGR_RESET_LEN;
+    }
+
+    // Appends height rows of width marked cells, each ending in a newline
+    static void markBoard(std::string& out, const char* cells, int width, int height) {
+        for (int y = 0; y < height; ++y) {
+            const char* row = cells + y * width;
+            for (int x = 0; x < width; ++x) out += static_cast<char>(row[x] | CELL_MARK);
+            out += '\n';
+        }
+    }
+
+    // One marked cell, for legends next to the board
+    static void markCell(std::string& out, char cell) { out += static_cast<char>(cell | CELL_MARK); }
+
+    // Appends len cells as terminal bytes and leaves the terminal's color as
+    // it was. Blanks and newlines keep the color set; other text resets it.
+    void appendCells(std::string& out, const char* cells, size_t len) const {
+        if (plain()) {
+            for (size_t i = 0; i < len; ++i) out += static_cast<char>(cells[i] & ~CELL_MARK);
+            return;
+        }
+        uint8_t current = ATTR_NONE;
+        for (size_t i = 0; i < len; ++i) {
+            char c = cells[i];
+            if (!(c & CELL_MARK)) {
+                if (current != ATTR_NONE && c != ' ' && c != '\n') {
+                    current = ATTR_NONE;
+                    out.append(SGR_RESET, SGR_RESET_LEN);
+                }
+                out += c;
+                continue;
+            }
+            const Glyph& g = glyph(c);
+            if (g.attr != current && (c & ~CELL_MARK) != EMPTY) {
+                current = g.attr;
+                if (current == ATTR_NONE) out.append(SGR_RESET, SGR_RESET_LEN);
+                else out.append(attrs[current].bytes, attrs[current].len);
+            }
+            out.append(g.bytes, g.len);
+        }
+        if (current != ATTR_NONE) out.append(SGR_RESET, SGR_RESET_LEN);
+    }
+
+private:
+    static const char CELL_MARK = '\x80';
+
+    enum Attr {
+        ATTR_NONE,
+        ATTR_WALL,
+        ATTR_PORTAL,
+        ATTR_HEAD,
+        ATTR_BODY,
+        ATTR_FOOD,
+        ATTR_SPECIAL,
+        ATTR_POISON,
+        ATTR_COUNT
+    };
+
+    struct Style {
+        char cell;
+        const char* utf8;
+        uint8_t attr;
+        int index;  // xterm 256-color palette
+        int r, g, b;
+    };
+
+    struct Glyph {
+        char bytes[4];
+        uint8_t len;
+        uint8_t attr;
+    };
+
+    struct Sgr {
+        char bytes[24];
+        uint8_t len;
+    };
+
+    ColorMode colors;
+    bool unicode;
+    Glyph glyphs[128];
+    Sgr attrs[ATTR_COUNT];
+    size_t maxSgr;
+
+    const Glyph& glyph(char cell) const { return glyphs[static_cast<unsigned char>(cell) & 127]; }
+
+    // Each cell type has its own glyph, so --unicode without --color still
+    // tells the head from a wall. The body alternates between 'O' and 'o'
+    // each tick; both share a color.
+    static const Style* styleTable(size_t& count) {
+        static const Style styles[] = {
+            {WALL, "\xe2\x96\x88", ATTR_WALL, 244, 128, 128, 128},           // full block
+            {PORTAL, "\xe2\x97\x8e", ATTR_PORTAL, 45, 0, 215, 255},          // bullseye
+            {SNAKE_HEAD, "\xe2\x96\xa0", ATTR_HEAD, 118, 135, 255, 0},       // black square
+            {SNAKE_BODY, "\xe2\x96\x93", ATTR_BODY, 34, 0, 175, 0},          // dark shade
+            {'o', "\xe2\x96\x92", ATTR_BODY, 34, 0, 175, 0},                 // medium shade
+            {FOOD, "\xe2\x97\x8f", ATTR_FOOD, 196, 255, 0, 0},               // black circle
+            {SPECIAL_FOOD, "\xe2\x97\x86", ATTR_SPECIAL, 220, 255, 215, 0},  // black diamond
+            {POISON_FOOD, "\xe2\x96\xb2", ATTR_POISON, 129, 175, 0, 255},    // triangle
+        };
+        count = sizeof(styles) / sizeof(styles[0]);
+        return styles;
+    }
+};
+
+#endif
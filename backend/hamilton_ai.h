@@ -0,0 +1,246 @@
+#ifndef HAMILTON_AI_H
+#define HAMILTON_AI_H
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include <stdint.h>
+#include "alloc_counter.h"
+#include "game_engine.h"
+#include "tick_profiler.h"
+
+// Plays a plain board until the snake covers all of it. The playable area
+// is covered once by a Hamiltonian cycle: the first column of the area is
+// the way back, the rest is walked row by row, turning at each end (column
+// by column when the row count is odd; one side has to be even for such a
+// cycle to exist).
+//
+// The body always lies on the stretch of cycle from the tail forward to the
+// head, so every cell between the head and the tail going forward is
+// empty, and following the cycle can never run into the snake. A jump to a
+// neighbour further along the cycle keeps that true as long as it lands
+// short of the tail. The cells it skips stay behind inside the body's
+// stretch until the tail passes them, and every bite taken meanwhile costs
+// a cell of the room ahead; if the room runs out first, with food sitting
+// in a skipped cell, the tail is all that is left to move into. So jumps
+// need room to spare:
+//
+//  - shortcuts toward the nearest food are taken only while the snake
+//    covers less than half the board and the jump leaves more than half
+//    of it empty ahead;
+//  - poison ahead is jumped over by the smallest jump that clears it,
+//    taken up to a lane early when that skips no more than a lane, while
+//    the room left squared exceeds
+//    DODGE_ROOM times the snake's length (the room lasts about its square
+//    over four ticks of eating; the tail needs the length in ticks to pass
+//    the skipped cells). Otherwise the snake eats it: that only shortens
+//    the snake, which is always safe.
+//
+// Poison matters because it never expires and another only appears once it
+// is eaten; a snake that eats every poison it meets shrinks faster than it
+// grows once a few dozen cells are left, while one that steps around it
+// keeps a single poison on the board for good. The board counts as filled
+// with the poison on it (GameEngine::isBoardFilled).
+class HamiltonSolver {
+public:
+    // Plain rectangles only: every cell inside the border free, no portals,
+    // and an even side. Wrap mode is fine; the cycle never touches the border.
+    static bool fits(const LevelMap& level) {
+        int w = level.width() - 2;
+        int h = level.height() - 2;
+        return w >= 2 && h >= 2 && (w % 2 == 0 || h % 2 == 0) && level.portalCount() == 0 &&
+               level.freeCount() == static_cast<uint32_t>(w) * h;
+    }
+
+    explicit HamiltonSolver(const LevelMap& level) : width(level.width()), shortcuts(0), decisions(0) {
+        int w = level.width() - 2;
+        int h = level.height() - 2;
+        cells = static_cast<uint32_t>(w) * h;
+        order.assign(level.cellCount(), 0);
+        path.assign(cells, 0);
+        // Lay the cycle out with an even number of lanes across, swapping the
+        // axes when only the columns are even
+        bool swapped = h % 2 != 0;
+        int lanes = swapped ? w : h;
+        int along = swapped ? h : w;
+        laneLength = static_cast<uint32_t>(along);
+        uint32_t k = 0;
+        for (int lane = 0; lane < lanes; ++lane) {
+            if (lane % 2 == 0) {
+                for (int a = lane == 0 ? 0 : 1; a < along; ++a) place(swapped, a, lane, k++);
+            } else {
+                for (int a = along - 1; a >= 1; --a) place(swapped, a, lane, k++);
+            }
+        }
+        for (int lane = lanes - 1; lane >= 1; --lane) place(swapped, 0, lane, k++);
+    }
+
+    // Direction (0 up, 1 right, 2 down, 3 left) for the engine's next tick
+    int choose(const GameEngine& game) {
+        ++decisions;
+        const vector<Position>& body = game.getSnake().getBody();
+        uint32_t head = cellOf(body[0]);
+        uint32_t at = order[head];
+        uint32_t next = path[(at + 1) % cells];
+        uint32_t tailDistance = body.size() > 1 ? distance(at, order[cellOf(body.back())]) : cells;
+
+        const ItemLayer& items = game.getItems();
+        const LevelMap& level = game.getLevelMap();
+        uint32_t foodDistance = nearest(items, at, false);
+        uint32_t poisonDistance = nearest(items, at, true);
+        uint32_t best = 1;
+        bool dodging = false;
+        for (int d = 0; d < 4; ++d) {
+            uint32_t n = head + LEVEL_DY[d] * width + LEVEL_DX[d];
+            if (level.isWall(n) || isPoison(items, n)) continue;
+            uint32_t jump = distance(at, order[n]);
+            if (jump <= 1 || jump >= tailDistance) continue;
+            uint32_t room = tailDistance - jump - 1;
+            if (poisonDistance > 0 && jump > poisonDistance && (poisonDistance == 1 || jump <= laneLength + 1)) {
+                if (static_cast<uint64_t>(room) * room <= DODGE_ROOM * body.size()) continue;
+                if (!dodging || jump < best) {
+                    best = jump;
+                    next = n;
+                    dodging = true;
+                }
+            } else if (!dodging && body.size() * 2 < cells && jump > best && jump <= foodDistance &&
+                       room * 2 > cells) {
+                best = jump;
+                next = n;
+            }
+        }
+        if (best > 1) ++shortcuts;
+        return directionTo(head, next);
+    }
+
+    uint32_t cycleLength() const { return cells; }
+    uint64_t shortcutsTaken() const { return shortcuts; }
+    uint64_t decisionsMade() const { return decisions; }
+
+private:
+    static const uint64_t DODGE_ROOM = 6;
+
+    int width;
+    uint32_t cells;
+    uint32_t laneLength;
+    std::vector<uint32_t> order;  // position on the cycle, by board cell
+    std::vector<uint32_t> path;   // board cell, by position on the cycle
+    uint64_t shortcuts;
+    uint64_t decisions;
+
+    void place(bool swapped, int a, int lane, uint32_t k) {
+        int x = (swapped ? lane : a) + 1;
+        int y = (swapped ? a : lane) + 1;
+        uint32_t cell = static_cast<uint32_t>(y * width + x);
+        order[cell] = k;
+        path[k] = cell;
+    }
+
+    uint32_t cellOf(const Position& p) const { return static_cast<uint32_t>(p.y * width + p.x); }
+
+    // Steps forward along the cycle from position a to position b
+    uint32_t distance(uint32_t a, uint32_t b) const { return b >= a ? b - a : b + cells - a; }
+
+    bool isPoison(const ItemLayer& items, uint32_t cell) const {
+        int index = items.find(Position(cell % width, cell / width));
+        return index != ItemLayer::NO_ITEM && items[index].type == ITEM_POISON;
+    }
+
+    // Cycle distance to the nearest poison, or food or bonus, ahead; 0 when
+    // there is none
+    uint32_t nearest(const ItemLayer& items, uint32_t at, bool poison) const {
+        uint32_t best = 0;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if ((items[i].type == ITEM_POISON) != poison) continue;
+            uint32_t d = distance(at, order[cellOf(items[i].pos)]);
+            if (d > 0 && (best == 0 || d < best)) best = d;
+        }
+        return best;
+    }
+
+    int directionTo(uint32_t from, uint32_t to) const {
+        int dx = static_cast<int>(to % width) - static_cast<int>(from % width);
+        int dy = static_cast<int>(to / width) - static_cast<int>(from / width);
+        for (int d = 0; d < 4; ++d) {
+            if (LEVEL_DX[d] == dx && LEVEL_DY[d] == dy) return d;
+        }
+        return 1;
+    }
+
+    HamiltonSolver(const HamiltonSolver&);
+    HamiltonSolver& operator=(const HamiltonSolver&);
+};
+
+// Headless worst case for the engine: the solver plays each game to a full
+// board as fast as the engine allows, so the snake ends as long as the
+// board is big and every per-tick cost that grows with the body shows.
+// Tick times (solver plus engine) are reported by how full the board was.
+inline int runSolverBench(const LevelMap& level, int games, uint64_t seed) {
+    if (!HamiltonSolver::fits(level)) {
+        fprintf(stderr, "The solver needs a plain board with an even side\n");
+        return 1;
+    }
+    HamiltonSolver solver(level);
+    // A game this long has stalled; none has come close
+    uint64_t limit = 16ULL * solver.cycleLength() * solver.cycleLength();
+    GameEngine game(seed);
+    game.setLevel(&level);
+    game.reserveCapacity();
+    const int QUARTERS = 4;
+    LatencyHistogram byFill[QUARTERS];
+    int filled = 0;
+    uint64_t totalTicks = 0;
+    // Only ticks are counted: a reset between games may allocate, a tick
+    // must not
+    uint64_t allocations = 0;
+    uint64_t maxTickAllocations = 0;
+    uint64_t started = monotonicNanos();
+    printf("board %dx%d, %u cells on the cycle\n", level.width(), level.height(), solver.cycleLength());
+    for (int g = 0; g < games; ++g) {
+        game.reset();
+        uint64_t gameStart = monotonicNanos();
+        while (!game.isGameOver() && game.getTick() < limit) {
+            uint64_t t0 = monotonicNanos();
+            uint64_t before = threadAllocations();
+            int d = solver.choose(game);
+            game.setDirection(Position(LEVEL_DX[d], LEVEL_DY[d]));
+            game.update();
+            uint64_t made = threadAllocations() - before;
+            uint64_t t1 = monotonicNanos();
+            allocations += made;
+            maxTickAllocations = std::max(maxTickAllocations, made);
+            size_t length = game.getSnake().getBody().size();
+            int quarter = static_cast<int>(length * QUARTERS / (level.freeCount() + 1));
+            byFill[quarter].record(t1 - t0);
+        }
+        uint64_t ticks = game.getTick();
+        totalTicks += ticks;
+        if (game.isBoardFilled()) ++filled;
+        double seconds = (monotonicNanos() - gameStart) / 1e9;
+        const char* outcome = game.isBoardFilled() ? "board filled" : game.isGameOver() ? "died" : "stalled";
+        printf("game %d: %s after %llu ticks, score %d, %.2fs (%.0f ticks/s)\n", g + 1, outcome,
+               static_cast<unsigned long long>(ticks), game.getScore(), seconds, seconds > 0 ? ticks / seconds : 0.0);
+    }
+    double seconds = (monotonicNanos() - started) / 1e9;
+    printf("%d/%d games filled the board; %llu ticks in %.2fs, %.0f ticks/s, %llu shortcuts\n", filled, games,
+           static_cast<unsigned long long>(totalTicks), seconds, seconds > 0 ? totalTicks / seconds : 0.0,
+           static_cast<unsigned long long>(solver.shortcutsTaken()));
+    printf("tick time by board fill (ns):\n");
+    for (int q = 0; q < QUARTERS; ++q) {
+        printf("  %3d-%3d%%  %10llu ticks  p50 %8llu  p99 %8llu  max %8llu\n", q * 100 / QUARTERS,
+               (q + 1) * 100 / QUARTERS, static_cast<unsigned long long>(byFill[q].count()),
+               static_cast<unsigned long long>(byFill[q].percentile(0.5)),
+               static_cast<unsigned long long>(byFill[q].percentile(0.99)),
+               static_cast<unsigned long long>(byFill[q].max()));
+    }
+    printf("heap allocations: %llu in %llu ticks, at most %llu in one tick\n",
+           static_cast<unsigned long long>(allocations), static_cast<unsigned long long>(totalTicks),
+           static_cast<unsigned long long>(maxTickAllocations));
+    if (allocations > 0) {
+        fprintf(stderr, "A steady-state tick allocated\n");
+        return 3;
+    }
+    return filled == games ? 0 : 2;
+}
+
+#endif
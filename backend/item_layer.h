@@ -0,0 +1,115 @@
+#ifndef ITEM_LAYER_H
+#define ITEM_LAYER_H
+
+#include <vector>
+#include <stdint.h>
+#include "snake_core.h"
+
+enum ItemType {
+    ITEM_NONE = 0,
+    ITEM_FOOD,
+    ITEM_SPECIAL,
+    ITEM_POISON,
+    ITEM_TYPES
+};
+
+struct Item {
+    Position pos;
+    uint8_t type;
+    uint32_t expiryEvent;
+    uint64_t expiresAt;
+};
+
+inline char itemGlyph(int type) {
+    switch (type) {
+        case ITEM_FOOD: return FOOD;
+        case ITEM_SPECIAL: return SPECIAL_FOOD;
+        case ITEM_POISON: return POISON_FOOD;
+    }
+    return EMPTY;
+}
+
+// Everything lying on the board. Items are kept densely for iteration and
+// every cell holds the index of the item on it, so lookups by position are
+// O(1) whether there is one item or hundreds. Cells whose contents change
+// are journalled for renderers that only redraw what moved.
+class ItemLayer {
+public:
+    static const int32_t NO_ITEM = -1;
+
+    ItemLayer(int w = BOARD_WIDTH, int h = BOARD_HEIGHT)
+        : width(w), height(h), cells(w * h, NO_ITEM) {
+        for (int t = 0; t < ITEM_TYPES; ++t) counts[t] = 0;
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    size_t size() const { return items.size(); }
+    const Item& operator[](size_t i) const { return items[i]; }
+    int count(int type) const { return counts[type]; }
+
+    int find(const Position& p) const {
+        if (p.x < 0 || p.y < 0 || p.x >= width || p.y >= height) return NO_ITEM;
+        return cells[p.y * width + p.x];
+    }
+
+    const Item* at(const Position& p) const {
+        int i = find(p);
+        return i == NO_ITEM ? NULL : &items[i];
+    }
+
+    char glyphAt(int x, int y) const {
+        int i = cells[y * width + x];
+        return i == NO_ITEM ? EMPTY : itemGlyph(items[i].type);
+    }
+
+    // The cell must be free
+    Item& add(int type, const Position& p) {
+        Item item;
+        item.pos = p;
+        item.type = static_cast<uint8_t>(type);
+        item.expiryEvent = 0;
+        item.expiresAt = 0;
+        cells[p.y * width + p.x] = static_cast<int32_t>(items.size());
+        items.push_back(item);
+        ++counts[type];
+        changed.push_back(p);
+        return items.back();
+    }
+
+    // Swaps the last item into the hole so removal stays O(1)
+    void remove(int index) {
+        Item& victim = items[index];
+        cells[victim.pos.y * width + victim.pos.x] = NO_ITEM;
+        --counts[victim.type];
+        changed.push_back(victim.pos);
+        int last = static_cast<int>(items.size()) - 1;
+        if (index != last) {
+            items[index] = items[last];
+            cells[items[index].pos.y * width + items[index].pos.x] = index;
+        }
+        items.pop_back();
+    }
+
+    void clear() {
+        while (!items.empty()) remove(static_cast<int>(items.size()) - 1);
+    }
+
+    void reserve(size_t itemCount, size_t changeCount) {
+        items.reserve(itemCount);
+        changed.reserve(changeCount);
+    }
+
+    const std::vector<Position>& changes() const { return changed; }
+    void clearChanges() { changed.clear(); }
+
+private:
+    int width;
+    int height;
+    std::vector<int32_t> cells;
+    std::vector<Item> items;
+    std::vector<Position> changed;
+    int counts[ITEM_TYPES];
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "level_format.h"
+
+using namespace std;
+
+// Compiles a text level into the binary form snake_game --level mmaps.
+// With --check it loads a compiled level back and prints what it holds.
+int main(int argc, char* argv[]) {
+    if (argc == 3 && string(argv[1]) == "--check") {
+        LevelMap level;
+        string error;
+        if (!level.load(argv[2], error)) {
+            cerr << error << "\n";
+            return 1;
+        }
+        cout << argv[2] << ": " << level.width() << "x" << level.height()
+             << ", " << level.freeCount() << " free cells, "
+             << level.spawnCount() << " spawn points, "
+             << level.portalCount() / 2 << " portals\n";
+        return 0;
+    }
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " level.txt level.lvl\n"
+             << "       " << argv[0] << " --check level.lvl\n";
+        return 1;
+    }
+
+    ifstream in(argv[1]);
+    if (!in) {
+        cerr << "Cannot open " << argv[1] << "\n";
+        return 1;
+    }
+    vector<string> rows;
+    string line;
+    while (getline(in, line)) rows.push_back(line);
+
+    vector<char> image;
+    string error;
+    if (!compileLevel(rows, image, error)) {
+        cerr << argv[1] << ": " << error << "\n";
+        return 1;
+    }
+
+    ofstream out(argv[2], ios::binary | ios::trunc);
+    out.write(&image[0], image.size());
+    out.close();
+    if (!out) {
+        cerr << "Cannot write " << argv[2] << "\n";
+        return 1;
+    }
+
+    const LevelHeader* header = reinterpret_cast<const LevelHeader*>(&image[0]);
+    cout << argv[2] << ": " << header->width << "x" << header->height
+         << ", " << header->freeCount << " free cells, "
+         << header->spawnCount << " spawn points, "
+         << header->portalCount / 2 << " portals, "
+         << image.size() << " bytes\n";
+    return 0;
+}
@@ -0,0 +1,399 @@
+#ifndef LEVEL_FORMAT_H
+#define LEVEL_FORMAT_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snake_core.h"
+
+// Compiled levels are a single image, used in place after mmap:
+//
+//   LevelHeader
+//   wall bitmap     uint64_t[(cells + 63) / 64]   bit set = wall
+//   portal bitmap   uint64_t[(cells + 63) / 64]   bit set = portal mouth
+//   free cells      uint32_t[freeCount]   reachable floor, row-major
+//   spawn cells     uint32_t[spawnCount]
+//   portals         LevelPortal[portalCount], sorted by 'from'
+//   adjacency       uint32_t[cells][4]    up, right, down, left, with
+//                                         portals followed, no wrap
+//
+// Every section starts on an 8-byte boundary and cells are y * width + x.
+// The outer ring is always wall, so a move off the board is a bit test too.
+
+const char LEVEL_MAGIC[8] = {'S', 'N', 'K', 'L', 'V', 'L', '\0', '\0'};
+const uint32_t LEVEL_VERSION = 1;
+const uint32_t LEVEL_NO_CELL = 0xFFFFFFFFu;
+const uint32_t LEVEL_MAX_CELLS = 1u << 26;
+const char PORTAL = '%';
+
+const int LEVEL_DX[4] = {0, 1, 0, -1};
+const int LEVEL_DY[4] = {-1, 0, 1, 0};
+
+struct LevelHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t freeCount;
+    uint32_t spawnCount;
+    uint32_t portalCount;
+    uint64_t wallOffset;
+    uint64_t portalBitsOffset;
+    uint64_t freeOffset;
+    uint64_t spawnOffset;
+    uint64_t portalOffset;
+    uint64_t adjacencyOffset;
+    uint64_t fileSize;
+};
+
+struct LevelPortal {
+    uint32_t from;
+    uint32_t to;
+};
+
+// Fills in the section offsets and total size for the given counts
+inline void layoutLevel(LevelHeader& h) {
+    uint64_t cells = static_cast<uint64_t>(h.width) * h.height;
+    uint64_t bitmapBytes = (cells + 63) / 64 * 8;
+    uint64_t at = (sizeof(LevelHeader) + 7) & ~7ULL;
+    h.wallOffset = at;
+    at += bitmapBytes;
+    h.portalBitsOffset = at;
+    at += bitmapBytes;
+    h.freeOffset = at;
+    at += (h.freeCount * 4ULL + 7) & ~7ULL;
+    h.spawnOffset = at;
+    at += (h.spawnCount * 4ULL + 7) & ~7ULL;
+    h.portalOffset = at;
+    at += h.portalCount * static_cast<uint64_t>(sizeof(LevelPortal));
+    h.adjacencyOffset = at;
+    at += cells * 16;
+    h.fileSize = at;
+}
+
+// Turns a text level into a compiled image. '#' is wall, ' ' or '.' floor,
+// 'S' a spawn point and each lowercase letter marks the two mouths of one
+// portal. Lines starting with ';' are comments; short rows are padded
+// with wall. Floor the spawn points cannot reach never receives food.
+inline bool compileLevel(const std::vector<std::string>& source, std::vector<char>& image,
+                         std::string& error) {
+    std::vector<std::string> rows;
+    size_t width = 0;
+    for (size_t i = 0; i < source.size(); ++i) {
+        std::string row = source[i];
+        if (!row.empty() && row[row.size() - 1] == '\r') row.erase(row.size() - 1);
+        if (!row.empty() && row[0] == ';') continue;
+        rows.push_back(row);
+        if (row.size() > width) width = row.size();
+    }
+    while (!rows.empty() && rows.back().empty()) rows.pop_back();
+    size_t height = rows.size();
+    if (width < 3 || height < 3) {
+        error = "level must be at least 3x3";
+        return false;
+    }
+    if (width * height > LEVEL_MAX_CELLS) {
+        error = "level is too large";
+        return false;
+    }
+    for (size_t y = 0; y < height; ++y) rows[y].resize(width, WALL);
+
+    uint32_t cells = static_cast<uint32_t>(width * height);
+    std::vector<uint64_t> walls((cells + 63) / 64, 0);
+    std::vector<uint64_t> portalBits((cells + 63) / 64, 0);
+    std::vector<uint32_t> spawns;
+    std::vector<uint32_t> mouths[26];
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            char c = rows[y][x];
+            uint32_t cell = static_cast<uint32_t>(y * width + x);
+            bool edge = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+            if (c == WALL) {
+                walls[cell >> 6] |= 1ULL << (cell & 63);
+                continue;
+            }
+            if (edge) {
+                error = "row " + std::to_string(y + 1) + ": the outer ring must be wall";
+                return false;
+            }
+            if (c == 'S') {
+                spawns.push_back(cell);
+            } else if (c >= 'a' && c <= 'z') {
+                mouths[c - 'a'].push_back(cell);
+                portalBits[cell >> 6] |= 1ULL << (cell & 63);
+            } else if (c != ' ' && c != '.') {
+                error = "row " + std::to_string(y + 1) + ": unknown tile '" + std::string(1, c) + "'";
+                return false;
+            }
+        }
+    }
+
+    std::vector<LevelPortal> portals;
+    for (int p = 0; p < 26; ++p) {
+        if (mouths[p].empty()) continue;
+        if (mouths[p].size() != 2) {
+            error = "portal '" + std::string(1, static_cast<char>('a' + p)) + "' needs exactly two mouths";
+            return false;
+        }
+        LevelPortal a = {mouths[p][0], mouths[p][1]};
+        LevelPortal b = {mouths[p][1], mouths[p][0]};
+        portals.push_back(a);
+        portals.push_back(b);
+    }
+    for (size_t i = 1; i < portals.size(); ++i) {
+        for (size_t j = i; j > 0 && portals[j - 1].from > portals[j].from; --j) {
+            LevelPortal t = portals[j];
+            portals[j] = portals[j - 1];
+            portals[j - 1] = t;
+        }
+    }
+
+    std::vector<uint32_t> target(cells, LEVEL_NO_CELL);
+    for (size_t i = 0; i < portals.size(); ++i) target[portals[i].from] = portals[i].to;
+    std::vector<uint32_t> adjacency(static_cast<size_t>(cells) * 4, LEVEL_NO_CELL);
+    for (uint32_t cell = 0; cell < cells; ++cell) {
+        if (walls[cell >> 6] >> (cell & 63) & 1) continue;
+        int x = cell % width;
+        int y = cell / width;
+        for (int d = 0; d < 4; ++d) {
+            uint32_t n = static_cast<uint32_t>((y + LEVEL_DY[d]) * width + (x + LEVEL_DX[d]));
+            if (walls[n >> 6] >> (n & 63) & 1) continue;
+            adjacency[cell * 4 + d] = target[n] != LEVEL_NO_CELL ? target[n] : n;
+        }
+    }
+
+    if (spawns.empty()) {
+        uint32_t center = static_cast<uint32_t>((height / 2) * width + width / 2);
+        if (!(walls[center >> 6] >> (center & 63) & 1) && target[center] == LEVEL_NO_CELL) {
+            spawns.push_back(center);
+        } else {
+            for (uint32_t cell = 0; cell < cells && spawns.empty(); ++cell) {
+                if (!(walls[cell >> 6] >> (cell & 63) & 1) && target[cell] == LEVEL_NO_CELL) {
+                    spawns.push_back(cell);
+                }
+            }
+        }
+        if (spawns.empty()) {
+            error = "level has no floor to start on";
+            return false;
+        }
+    }
+
+    std::vector<char> reached(cells, 0);
+    std::vector<uint32_t> queue(spawns);
+    for (size_t i = 0; i < spawns.size(); ++i) reached[spawns[i]] = 1;
+    for (size_t head = 0; head < queue.size(); ++head) {
+        for (int d = 0; d < 4; ++d) {
+            uint32_t n = adjacency[queue[head] * 4 + d];
+            if (n != LEVEL_NO_CELL && !reached[n]) {
+                reached[n] = 1;
+                queue.push_back(n);
+            }
+        }
+    }
+    std::vector<uint32_t> freeCells;
+    for (uint32_t cell = 0; cell < cells; ++cell) {
+        if (reached[cell] && target[cell] == LEVEL_NO_CELL) freeCells.push_back(cell);
+    }
+    if (freeCells.size() < 2) {
+        error = "level needs at least two reachable floor cells";
+        return false;
+    }
+
+    LevelHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LEVEL_MAGIC, sizeof(header.magic));
+    header.version = LEVEL_VERSION;
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.freeCount = static_cast<uint32_t>(freeCells.size());
+    header.spawnCount = static_cast<uint32_t>(spawns.size());
+    header.portalCount = static_cast<uint32_t>(portals.size());
+    layoutLevel(header);
+
+    image.assign(header.fileSize, 0);
+    memcpy(&image[0], &header, sizeof(header));
+    memcpy(&image[header.wallOffset], &walls[0], walls.size() * 8);
+    memcpy(&image[header.portalBitsOffset], &portalBits[0], portalBits.size() * 8);
+    memcpy(&image[header.freeOffset], &freeCells[0], freeCells.size() * 4);
+    memcpy(&image[header.spawnOffset], &spawns[0], spawns.size() * 4);
+    if (!portals.empty()) {
+        memcpy(&image[header.portalOffset], &portals[0], portals.size() * sizeof(LevelPortal));
+    }
+    memcpy(&image[header.adjacencyOffset], &adjacency[0], adjacency.size() * 4);
+    return true;
+}
+
+// Read-only view of a compiled level, either mmapped from a file or built
+// in memory. Engines share one instance by pointer and never copy it.
+class LevelMap {
+public:
+    LevelMap() : mapped(NULL), mappedSize(0), header(NULL) {}
+
+    ~LevelMap() {
+        if (mapped) munmap(mapped, mappedSize);
+    }
+
+    // The plain bordered board every game used before levels existed
+    static const LevelMap& standard() {
+        static LevelMap map(BOARD_WIDTH, BOARD_HEIGHT);
+        return map;
+    }
+
+    // A plain bordered board of another size, built in memory; for a fresh
+    // LevelMap only
+    bool plain(int w, int h, std::string& error) {
+        if (header) {
+            error = "a board is already loaded";
+            return false;
+        }
+        if (w < 4 || h < 4 || static_cast<uint64_t>(w) * h > LEVEL_MAX_CELLS) {
+            error = "board size out of range";
+            return false;
+        }
+        return buildPlain(w, h, error);
+    }
+
+    // Maps the file in place. Only the header and cell lists are checked;
+    // the adjacency table is bounds-checked as it is read, so even a huge
+    // maze loads without touching most of its pages
+    bool load(const std::string& path, std::string& error) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "cannot open " + path;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(LevelHeader))) {
+            close(fd);
+            error = path + " is not a compiled level";
+            return false;
+        }
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            error = "cannot map " + path;
+            return false;
+        }
+        if (!attach(static_cast<const char*>(data), st.st_size, error)) {
+            munmap(data, st.st_size);
+            error = path + ": " + error;
+            return false;
+        }
+        mapped = data;
+        mappedSize = st.st_size;
+        return true;
+    }
+
+    int width() const { return static_cast<int>(header->width); }
+    int height() const { return static_cast<int>(header->height); }
+    uint32_t cellCount() const { return header->width * header->height; }
+
+    bool isWall(uint32_t cell) const { return walls[cell >> 6] >> (cell & 63) & 1; }
+    bool isPortal(uint32_t cell) const { return portalBits[cell >> 6] >> (cell & 63) & 1; }
+
+    uint32_t portalTarget(uint32_t cell) const {
+        uint32_t lo = 0, hi = header->portalCount;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (portals[mid].from < cell) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo < header->portalCount && portals[lo].from == cell ? portals[lo].to : cell;
+    }
+
+    uint32_t freeCount() const { return header->freeCount; }
+    uint32_t freeCell(uint32_t i) const { return freeCells[i]; }
+    uint32_t spawnCount() const { return header->spawnCount; }
+    uint32_t spawnCell(uint32_t i) const { return spawns[i]; }
+    uint32_t portalCount() const { return header->portalCount; }
+
+    // Cell reached by stepping from cell in direction d (0 up, 1 right,
+    // 2 down, 3 left), or LEVEL_NO_CELL when a wall is in the way
+    uint32_t neighbour(uint32_t cell, int d) const {
+        uint32_t n = adjacency[cell * 4 + d];
+        return n < cellCount() ? n : LEVEL_NO_CELL;
+    }
+
+private:
+    void* mapped;
+    size_t mappedSize;
+    std::vector<char> owned;
+    const LevelHeader* header;
+    const uint64_t* walls;
+    const uint64_t* portalBits;
+    const uint32_t* freeCells;
+    const uint32_t* spawns;
+    const LevelPortal* portals;
+    const uint32_t* adjacency;
+
+    LevelMap(const LevelMap&);
+    LevelMap& operator=(const LevelMap&);
+
+    LevelMap(int w, int h) : mapped(NULL), mappedSize(0), header(NULL) {
+        std::string error;
+        buildPlain(w, h, error);
+    }
+
+    bool buildPlain(int w, int h, std::string& error) {
+        std::vector<std::string> rows(h, std::string(w, WALL));
+        for (int y = 1; y < h - 1; ++y) rows[y].replace(1, w - 2, w - 2, EMPTY);
+        rows[h / 2][w / 2] = 'S';
+        return compileLevel(rows, owned, error) && attach(&owned[0], owned.size(), error);
+    }
+
+    bool attach(const char* data, size_t size, std::string& error) {
+        const LevelHeader* h = reinterpret_cast<const LevelHeader*>(data);
+        if (memcmp(h->magic, LEVEL_MAGIC, sizeof(h->magic)) != 0) {
+            error = "not a compiled level";
+            return false;
+        }
+        if (h->version != LEVEL_VERSION) {
+            error = "compiled for level format " + std::to_string(h->version);
+            return false;
+        }
+        LevelHeader expected = *h;
+        layoutLevel(expected);
+        uint64_t cells = static_cast<uint64_t>(h->width) * h->height;
+        if (h->width < 3 || h->height < 3 || cells > LEVEL_MAX_CELLS || h->freeCount < 2 ||
+            h->freeCount > cells || h->spawnCount == 0 || h->spawnCount > cells ||
+            h->portalCount > cells || memcmp(&expected, h, sizeof(expected)) != 0 ||
+            h->fileSize != size) {
+            error = "corrupt or truncated level";
+            return false;
+        }
+        header = h;
+        walls = reinterpret_cast<const uint64_t*>(data + h->wallOffset);
+        portalBits = reinterpret_cast<const uint64_t*>(data + h->portalBitsOffset);
+        freeCells = reinterpret_cast<const uint32_t*>(data + h->freeOffset);
+        spawns = reinterpret_cast<const uint32_t*>(data + h->spawnOffset);
+        portals = reinterpret_cast<const LevelPortal*>(data + h->portalOffset);
+        adjacency = reinterpret_cast<const uint32_t*>(data + h->adjacencyOffset);
+        for (uint32_t i = 0; i < h->freeCount; ++i) {
+            if (freeCells[i] >= cells || isWall(freeCells[i])) return corrupt(error);
+        }
+        for (uint32_t i = 0; i < h->spawnCount; ++i) {
+            if (spawns[i] >= cells || isWall(spawns[i])) return corrupt(error);
+        }
+        for (uint32_t i = 0; i < h->portalCount; ++i) {
+            if (portals[i].from >= cells || portals[i].to >= cells || isWall(portals[i].to)) {
+                return corrupt(error);
+            }
+        }
+        return true;
+    }
+
+    bool corrupt(std::string& error) {
+        header = NULL;
+        error = "corrupt or truncated level";
+        return false;
+    }
+};
+
+#endif
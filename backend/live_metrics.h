@@ -0,0 +1,243 @@
+#ifndef LIVE_METRICS_H
+#define LIVE_METRICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdint.h>
+
+// Live counters of a running game in POSIX shared memory, one object per
+// game named /snake-live-<pid>, so a monitor on the same box can see every
+// game without attaching to it. The game publishes once per tick with
+// plain stores under a sequence lock: no syscall, no lock and nothing a
+// reader can make it wait for. A reader copies the sample and retries if
+// the sequence was odd (a publish in progress) or moved while it copied.
+//
+// The sample is all 64-bit words, stored and loaded as relaxed atomics, so
+// a torn read is merely retried, never undefined.
+
+const char LIVE_NAME_PREFIX[] = "snake-live-";
+const uint32_t LIVE_MAGIC = 0x56494c53;  // "SLIV"
+const uint32_t LIVE_VERSION = 1;
+
+enum LiveState {
+    LIVE_PLAYING,
+    LIVE_PAUSED,
+    LIVE_OVER
+};
+
+enum LiveModeFlags {
+    LIVE_EASY = 1,
+    LIVE_WRAP = 2
+};
+
+inline const char* liveStateName(uint64_t state) {
+    static const char* const names[] = {"playing", "paused", "over"};
+    return state <= LIVE_OVER ? names[state] : "?";
+}
+
+struct LiveSample {
+    uint64_t tick;
+    uint64_t score;
+    uint64_t length;
+    uint64_t level;
+    uint64_t state;
+    uint64_t modeFlags;         // LIVE_EASY | LIVE_WRAP | speed << 4
+    uint64_t periodMicros;      // the tick period asked for
+    uint64_t overruns;          // ticks whose work ran past the next deadline
+    uint64_t lastOverrunMicros;
+    uint64_t maxOverrunMicros;
+    uint64_t frameBytes;        // size of the last composed frame
+    uint64_t frameBytesTotal;
+    uint64_t frames;
+    uint64_t updatedNanos;      // CLOCK_MONOTONIC of the last publish
+};
+
+const int LIVE_WORDS = sizeof(LiveSample) / sizeof(uint64_t);
+
+// Written once when the game starts; magic goes in last
+struct LiveBlock {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    int32_t pid;
+    uint32_t boardWidth;
+    uint32_t boardHeight;
+    uint32_t reserved;
+    int64_t startedAt;  // wall clock, seconds
+    char mode[48];
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> words[LIVE_WORDS];
+};
+
+class LivePublisher {
+public:
+    LivePublisher() : block(NULL), seq(0) {}
+
+    ~LivePublisher() { close(); }
+
+    bool open(uint32_t width, uint32_t height, const std::string& mode) {
+        name = "/" + std::string(LIVE_NAME_PREFIX) + std::to_string(getpid());
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        void* p = MAP_FAILED;
+        if (ftruncate(fd, sizeof(LiveBlock)) == 0) {
+            p = mmap(NULL, sizeof(LiveBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            return false;
+        }
+        block = static_cast<LiveBlock*>(p);
+        block->version = LIVE_VERSION;
+        block->pid = getpid();
+        block->boardWidth = width;
+        block->boardHeight = height;
+        block->startedAt = time(0);
+        strncpy(block->mode, mode.c_str(), sizeof(block->mode) - 1);
+        block->magic.store(LIVE_MAGIC, std::memory_order_release);
+        return true;
+    }
+
+    void close() {
+        if (!block) return;
+        munmap(block, sizeof(LiveBlock));
+        shm_unlink(name.c_str());
+        block = NULL;
+    }
+
+    bool isOpen() const { return block != NULL; }
+
+    void publish(const LiveSample& sample) {
+        if (!block) return;
+        uint64_t words[LIVE_WORDS];
+        memcpy(words, &sample, sizeof(words));
+        block->seq.store(++seq, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int i = 0; i < LIVE_WORDS; ++i) block->words[i].store(words[i], std::memory_order_relaxed);
+        block->seq.store(++seq, std::memory_order_release);
+    }
+
+private:
+    LiveBlock* block;
+    uint64_t seq;
+    std::string name;
+
+    LivePublisher(const LivePublisher&);
+    LivePublisher& operator=(const LivePublisher&);
+};
+
+// False if the writer kept publishing through every attempt
+inline bool readLiveSample(const LiveBlock* block, LiveSample& out) {
+    uint64_t words[LIVE_WORDS];
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        uint64_t before = block->seq.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        for (int i = 0; i < LIVE_WORDS; ++i) words[i] = block->words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block->seq.load(std::memory_order_relaxed) == before) {
+            memcpy(&out, words, sizeof(words));
+            return true;
+        }
+    }
+    return false;
+}
+
+struct LiveGame {
+    std::string name;  // without the leading slash
+    int pid;
+    bool alive;        // false: the game died without removing its object
+    uint32_t boardWidth;
+    uint32_t boardHeight;
+    int64_t startedAt;
+    std::string mode;
+    LiveSample sample;
+};
+
+inline bool liveGameOlder(const LiveGame& a, const LiveGame& b) {
+    return a.startedAt != b.startedAt ? a.startedAt < b.startedAt : a.pid < b.pid;
+}
+
+// Every game object in /dev/shm, oldest first. Objects whose process is
+// gone are listed as not alive; removeStale deletes them instead.
+inline std::vector<LiveGame> listLiveGames(bool removeStale = false) {
+    std::vector<LiveGame> games;
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return games;
+    size_t prefix = strlen(LIVE_NAME_PREFIX);
+    while (struct dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, LIVE_NAME_PREFIX, prefix) != 0) continue;
+        std::string name = std::string("/") + entry->d_name;
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) continue;
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(LiveBlock))) {
+            p = mmap(NULL, sizeof(LiveBlock), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED) continue;
+        const LiveBlock* block = static_cast<const LiveBlock*>(p);
+        LiveGame game;
+        bool valid = block->magic.load(std::memory_order_acquire) == LIVE_MAGIC && block->version == LIVE_VERSION &&
+                     readLiveSample(block, game.sample);
+        if (valid) {
+            game.name = entry->d_name;
+            game.pid = block->pid;
+            game.alive = kill(block->pid, 0) == 0 || errno == EPERM;
+            game.boardWidth = block->boardWidth;
+            game.boardHeight = block->boardHeight;
+            game.startedAt = block->startedAt;
+            game.mode.assign(block->mode, strnlen(block->mode, sizeof(block->mode)));
+        }
+        munmap(p, sizeof(LiveBlock));
+        if (!valid) continue;
+        if (!game.alive && removeStale) {
+            shm_unlink(name.c_str());
+            continue;
+        }
+        games.push_back(game);
+    }
+    closedir(dir);
+    std::sort(games.begin(), games.end(), liveGameOlder);
+    return games;
+}
+
+// One line per game under a header, for snake_top and the menu's panel.
+// Frame sizes are averaged over the game so far.
+inline std::string formatLiveGames(const std::vector<LiveGame>& games) {
+    std::string out;
+    char line[200];
+    snprintf(line, sizeof(line), "%7s  %-8s %7s %9s %6s %5s %6s %8s %8s %7s  %s\n", "PID", "STATE", "SCORE",
+             "TICK", "LENGTH", "LEVEL", "PERIOD", "OVERRUNS", "MAX LATE", "B/FRAME", "MODE");
+    out += line;
+    for (size_t i = 0; i < games.size(); ++i) {
+        const LiveGame& g = games[i];
+        const LiveSample& s = g.sample;
+        snprintf(line, sizeof(line), "%7d  %-8s %7llu %9llu %6llu %5llu %4llums %8llu %6llums %7llu  %s %ux%u%s%s\n",
+                 g.pid, g.alive ? liveStateName(s.state) : "gone", static_cast<unsigned long long>(s.score),
+                 static_cast<unsigned long long>(s.tick), static_cast<unsigned long long>(s.length),
+                 static_cast<unsigned long long>(s.level), static_cast<unsigned long long>(s.periodMicros / 1000),
+                 static_cast<unsigned long long>(s.overruns),
+                 static_cast<unsigned long long>(s.maxOverrunMicros / 1000),
+                 static_cast<unsigned long long>(s.frames ? s.frameBytesTotal / s.frames : 0), g.mode.c_str(),
+                 g.boardWidth, g.boardHeight, s.modeFlags & LIVE_EASY ? " easy" : "",
+                 s.modeFlags & LIVE_WRAP ? " wrap" : "");
+        out += line;
+    }
+    if (games.empty()) out += "  (no games running)\n";
+    return out;
+}
+
+#endif
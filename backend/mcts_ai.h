@@ -0,0 +1,300 @@
+#ifndef MCTS_AI_H
+#define MCTS_AI_H
+
+#include <cmath>
+#include <cstddef>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include "sim_state.h"
+#include "tick_profiler.h"
+
+// Bump allocator over one fixed block. Nothing is freed on its own: search
+// code takes a mark() before an iteration and release()s back to it after,
+// or reset()s the whole arena between decisions.
+class SimArena {
+public:
+    explicit SimArena(size_t bytes) : words((bytes + 7) / 8), used(0) {}
+
+    // NULL once the arena is full; callers treat that as "stop growing"
+    void* allocate(size_t bytes) {
+        size_t n = (bytes + 7) / 8;
+        if (used + n > words.size()) return NULL;
+        void* p = &words[used];
+        used += n;
+        return p;
+    }
+
+    // Zero-filled T; T must be trivially copyable
+    template <class T>
+    T* make() {
+        void* p = allocate(sizeof(T));
+        if (p) memset(p, 0, sizeof(T));
+        return static_cast<T*>(p);
+    }
+
+    template <class T>
+    T* clone(const T& source) {
+        void* p = allocate(sizeof(T));
+        if (p) memcpy(p, &source, sizeof(T));
+        return static_cast<T*>(p);
+    }
+
+    size_t mark() const { return used; }
+    void release(size_t m) { used = m; }
+    void reset() { used = 0; }
+    size_t bytesUsed() const { return used * 8; }
+
+private:
+    std::vector<uint64_t> words;
+    size_t used;
+};
+
+// Monte-Carlo tree search over SimState. The tree is open-loop: a node is a
+// sequence of moves from the root, not a board, because food appears at
+// random. Each iteration clones the root into a scratch arena, reseeds its
+// random generator (the AI sees the board, not the engine's dice), walks
+// the tree by UCT, adds one node, plays a short biased-random rollout and
+// backs the result up. The clone is released before the next iteration.
+//
+// With several threads each worker grows its own tree from its own arenas
+// for the same time budget, and the root visit counts are summed (root
+// parallelism), so workers never share memory while searching. The helper
+// threads live as long as the controller and wait between decisions, so a
+// decision starts no thread and allocates nothing.
+class MctsController {
+public:
+    static const int MAX_DEPTH = 24;
+    static const int ROLLOUT_STEPS = 20;
+    static const size_t TREE_BYTES = 4 << 20;
+    static const size_t SCRATCH_BYTES = 64 << 10;
+
+    explicit MctsController(int threads = 1)
+        : lastPlayouts(0), decisions(0), generation(0), pending(0), stopping(false), searchRoot(NULL),
+          searchDeadline(0) {
+        if (threads < 1) threads = 1;
+        workers.resize(threads);
+        for (int i = 0; i < threads; ++i) {
+            workers[i].seed = 0x9E3779B97F4A7C15ULL * (i + 1);
+            workers[i].tree = new SimArena(TREE_BYTES);
+            workers[i].scratch = new SimArena(SCRATCH_BYTES);
+        }
+        for (int i = 1; i < threads; ++i) helpers.push_back(std::thread(&MctsController::helperLoop, this, i));
+    }
+
+    ~MctsController() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start.notify_all();
+        for (size_t i = 0; i < helpers.size(); ++i) helpers[i].join();
+        for (size_t i = 0; i < workers.size(); ++i) {
+            delete workers[i].tree;
+            delete workers[i].scratch;
+        }
+    }
+
+    int threadCount() const { return static_cast<int>(workers.size()); }
+    unsigned long playouts() const { return lastPlayouts; }
+
+    // Searches for budgetMicros and returns a LEVEL_DX direction index
+    int choose(const SimState& root, int budgetMicros) {
+        uint64_t deadline = monotonicNanos() + static_cast<uint64_t>(budgetMicros) * 1000;
+        ++decisions;
+        if (!helpers.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                searchRoot = &root;
+                searchDeadline = deadline;
+                pending = static_cast<int>(helpers.size());
+                ++generation;
+            }
+            start.notify_all();
+        }
+        search(workers[0], root, deadline);
+        if (!helpers.empty()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return pending == 0; });
+        }
+
+        unsigned long visits[4] = {0, 0, 0, 0};
+        double value[4] = {0, 0, 0, 0};
+        lastPlayouts = 0;
+        for (size_t i = 0; i < workers.size(); ++i) {
+            lastPlayouts += workers[i].playouts;
+            for (int d = 0; d < 4; ++d) {
+                visits[d] += workers[i].rootVisits[d];
+                value[d] += workers[i].rootValue[d];
+            }
+        }
+        int best = root.direction();
+        for (int d = 0; d < 4; ++d) {
+            if (visits[d] == 0) continue;
+            if (visits[best] == 0 || visits[d] > visits[best] ||
+                (visits[d] == visits[best] && value[d] > value[best])) {
+                best = d;
+            }
+        }
+        return best;
+    }
+
+private:
+    struct Node {
+        Node* children[4];
+        uint32_t visits;
+        float value;
+    };
+
+    struct Worker {
+        SimArena* tree;
+        SimArena* scratch;
+        uint64_t seed;
+        unsigned long playouts;
+        unsigned long rootVisits[4];
+        double rootValue[4];
+        Worker() : tree(NULL), scratch(NULL), seed(0), playouts(0) {}
+    };
+
+    std::vector<Worker> workers;
+    unsigned long lastPlayouts;
+    uint64_t decisions;
+    std::vector<std::thread> helpers;  // run workers 1..n-1; the caller runs 0
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+    uint64_t generation;
+    int pending;
+    bool stopping;
+    const SimState* searchRoot;
+    uint64_t searchDeadline;
+
+    void helperLoop(int worker) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            start.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            const SimState* root = searchRoot;
+            uint64_t deadline = searchDeadline;
+            lock.unlock();
+            search(workers[worker], *root, deadline);
+            lock.lock();
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    // Runs on the worker's own thread; touches nothing but w
+    void search(Worker& w, const SimState& root, uint64_t deadline) {
+        w.tree->reset();
+        w.playouts = 0;
+        Node* top = w.tree->make<Node>();
+        GameRng rng(w.seed ^ decisions * 0xBF58476D1CE4E5B9ULL);
+        do {
+            for (int i = 0; i < 64; ++i) iterate(w, top, root, rng);
+        } while (monotonicNanos() < deadline);
+        for (int d = 0; d < 4; ++d) {
+            Node* child = top->children[d];
+            w.rootVisits[d] = child ? child->visits : 0;
+            w.rootValue[d] = child && child->visits ? child->value / child->visits : 0;
+        }
+    }
+
+    void iterate(Worker& w, Node* top, const SimState& root, GameRng& rng) {
+        size_t mark = w.scratch->mark();
+        SimState* s = w.scratch->clone(root);
+        s->rng.seed(rng.next() | static_cast<uint64_t>(rng.next()) << 32);
+        s->setPaused(false);
+
+        Node* path[MAX_DEPTH + 1];
+        int depth = 0;
+        path[depth++] = top;
+        Node* node = top;
+        while (depth <= MAX_DEPTH && !s->isOver()) {
+            int d = select(*s, node, rng);
+            if (d < 0) break;
+            s->setDirection(d);
+            s->step();
+            Node* child = node->children[d];
+            if (!child) {
+                child = w.tree->make<Node>();
+                if (!child) break;
+                node->children[d] = child;
+                path[depth++] = child;
+                break;
+            }
+            path[depth++] = child;
+            node = child;
+        }
+        float value = rollout(*s, root, rng);
+        for (int i = 0; i < depth; ++i) {
+            path[i]->visits++;
+            path[i]->value += value;
+        }
+        ++w.playouts;
+        w.scratch->release(mark);
+    }
+
+    // UCT over the moves that are not a turn back onto the neck; an
+    // unvisited move is always tried first
+    static int select(const SimState& s, const Node* node, GameRng& rng) {
+        int best = -1;
+        double bestScore = -1;
+        double logVisits = std::log(static_cast<double>(node->visits + 1));
+        int start = rng.below(4);
+        for (int k = 0; k < 4; ++k) {
+            int d = (start + k) & 3;
+            if (s.turnsBack(d)) continue;
+            const Node* child = node->children[d];
+            if (!child || child->visits == 0) return d;
+            double score = child->value / child->visits + std::sqrt(logVisits / child->visits);
+            if (score > bestScore) {
+                bestScore = score;
+                best = d;
+            }
+        }
+        return best;
+    }
+
+    // Mostly heads for the nearest food, never into a wall or the body if
+    // another move is open
+    static float rollout(SimState& s, const SimState& root, GameRng& rng) {
+        for (int i = 0; i < ROLLOUT_STEPS && !s.isOver(); ++i) {
+            int options[4];
+            int n = 0;
+            for (int d = 0; d < 4; ++d) {
+                if (!s.turnsBack(d) && !s.blocked(d)) options[n++] = d;
+            }
+            if (n == 0) {
+                s.step();
+                break;
+            }
+            int pick = options[rng.below(n)];
+            if (rng.below(100) < 70) {
+                int bestDistance = 1 << 30;
+                for (int k = 0; k < n; ++k) {
+                    int distance = s.foodDistance(s.target(options[k]));
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        pick = options[k];
+                    }
+                }
+            }
+            s.setDirection(pick);
+            s.step();
+        }
+        if (s.isOver()) return 0.0f;
+        float gained = static_cast<float>(s.score - root.score) / (4.0f * FOOD_SCORE);
+        float value = 0.5f + gained - 0.002f * s.foodDistance(s.head);
+        return value < 0.05f ? 0.05f : (value > 1.0f ? 1.0f : value);
+    }
+
+    MctsController(const MctsController&);
+    MctsController& operator=(const MctsController&);
+};
+
+#endif
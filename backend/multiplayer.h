@@ -0,0 +1,940 @@
+#ifndef MULTIPLAYER_H
+#define MULTIPLAYER_H
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <poll.h>
+#include <stdint.h>
+#include "snake_core.h"
+#include "net_util.h"
+#include "wire_format.h"
+
+// Authoritative local multiplayer. The server owns the only real copy of the
+// world; every tick it sends one small delta (a byte per living snake plus
+// any spawns) and each client replays it into a mirror it renders locally.
+// The server applies its own deltas through the same code the clients use,
+// so a mirror can only diverge if bytes are lost, which periodic checksums
+// detect and a keyframe request repairs.
+
+const int MP_MAX_PLAYERS = 64;
+const int MP_CHECKSUM_INTERVAL = 32;
+const size_t MP_MAX_PENDING = 256 * 1024;
+
+enum MpMessage {
+    MP_WELCOME = 1,
+    MP_SNAPSHOT = 2,
+    MP_TICK = 3
+};
+
+enum MpEvent {
+    MP_EV_FOOD = 1,
+    MP_EV_JOIN = 2,
+    MP_EV_LEAVE = 3,
+    MP_EV_CHECKSUM = 4
+};
+
+// Move byte: low two bits are the direction, then flags
+const uint8_t MP_MOVE_GROW = 0x04;
+const uint8_t MP_MOVE_DIED = 0x08;
+
+// Client -> server commands are single bytes
+const char MP_CMD_UP = 'U';
+const char MP_CMD_RIGHT = 'R';
+const char MP_CMD_DOWN = 'D';
+const char MP_CMD_LEFT = 'L';
+const char MP_CMD_SPAWN = 'S';
+const char MP_CMD_KEYFRAME = 'K';
+
+inline int mpDirDx(int d) { static const int dx[4] = {0, 1, 0, -1}; return dx[d & 3]; }
+inline int mpDirDy(int d) { static const int dy[4] = {-1, 0, 1, 0}; return dy[d & 3]; }
+
+inline int mpDirFromCommand(char c) {
+    switch (c) {
+        case MP_CMD_UP: return 0;
+        case MP_CMD_RIGHT: return 1;
+        case MP_CMD_DOWN: return 2;
+        case MP_CMD_LEFT: return 3;
+    }
+    return -1;
+}
+
+inline char mpCommandFromDir(int d) {
+    static const char cmds[4] = {MP_CMD_UP, MP_CMD_RIGHT, MP_CMD_DOWN, MP_CMD_LEFT};
+    return cmds[d & 3];
+}
+
+// Prefixes a payload with its varint length
+inline void mpFrame(const std::vector<uint8_t>& payload, std::vector<uint8_t>& out) {
+    WireWriter w(out);
+    w.varint(static_cast<uint32_t>(payload.size()));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+// Pulls one complete frame off the front of buf; returns false if incomplete
+inline bool mpTakeFrame(std::vector<uint8_t>& buf, size_t& consumed, size_t& start, size_t& len) {
+    uint32_t v = 0;
+    size_t i = consumed;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (i >= buf.size()) return false;
+        uint8_t b = buf[i++];
+        v |= static_cast<uint32_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+    }
+    if (buf.size() - i < v) return false;
+    start = i;
+    len = v;
+    consumed = i + v;
+    return true;
+}
+
+struct MpSnake {
+    bool present;
+    bool alive;
+    uint8_t dir;
+    int score;
+    std::deque<uint16_t> body;
+
+    MpSnake() : present(false), alive(false), dir(1), score(0) {}
+};
+
+class MultiWorld {
+public:
+    int width;
+    int height;
+    uint32_t tick;
+    std::vector<MpSnake> snakes;
+    std::vector<uint8_t> food;
+    std::vector<uint16_t> foodCells;
+    std::vector<uint8_t> occupied;
+
+    MultiWorld(int w = BOARD_WIDTH, int h = BOARD_HEIGHT) { resize(w, h); }
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        tick = 0;
+        snakes.assign(MP_MAX_PLAYERS, MpSnake());
+        food.assign(w * h, 0);
+        foodCells.clear();
+        foodSlot.assign(w * h, 0);
+        occupied.assign(w * h, 0);
+    }
+
+    int cellX(int cell) const { return cell % width; }
+    int cellY(int cell) const { return cell / width; }
+    int cellAt(int x, int y) const { return y * width + x; }
+
+    bool isWall(int x, int y) const {
+        return x <= 0 || y <= 0 || x >= width - 1 || y >= height - 1;
+    }
+
+    bool isFree(int cell) const {
+        return !isWall(cellX(cell), cellY(cell)) && !occupied[cell] && !food[cell];
+    }
+
+    int aliveCount() const {
+        int n = 0;
+        for (size_t i = 0; i < snakes.size(); ++i) {
+            if (snakes[i].alive) ++n;
+        }
+        return n;
+    }
+
+    int foodCount() const { return static_cast<int>(foodCells.size()); }
+
+    void addFood(int cell) {
+        if (food[cell]) return;
+        food[cell] = 1;
+        foodSlot[cell] = static_cast<uint16_t>(foodCells.size());
+        foodCells.push_back(static_cast<uint16_t>(cell));
+    }
+
+    void removeFood(int cell) {
+        if (!food[cell]) return;
+        food[cell] = 0;
+        uint16_t last = foodCells.back();
+        foodCells[foodSlot[cell]] = last;
+        foodSlot[last] = foodSlot[cell];
+        foodCells.pop_back();
+    }
+
+    // Food cells in board order, as checksums and snapshots list them
+    std::vector<uint16_t> sortedFood() const {
+        std::vector<uint16_t> cells(foodCells);
+        std::sort(cells.begin(), cells.end());
+        return cells;
+    }
+
+    uint32_t checksum() const {
+        uint32_t h = 2166136261u;
+        mix(h, tick);
+        for (size_t i = 0; i < snakes.size(); ++i) {
+            const MpSnake& s = snakes[i];
+            if (!s.present) continue;
+            mix(h, static_cast<uint32_t>(i) | (s.alive ? 0x100 : 0) | (s.dir << 9));
+            mix(h, static_cast<uint32_t>(s.score));
+            for (size_t j = 0; j < s.body.size(); ++j) mix(h, s.body[j]);
+        }
+        std::vector<uint16_t> cells = sortedFood();
+        for (size_t i = 0; i < cells.size(); ++i) mix(h, cells[i]);
+        return h;
+    }
+
+    void encodeSnapshot(std::vector<uint8_t>& out) const {
+        WireWriter w(out);
+        w.u8(MP_SNAPSHOT);
+        w.u8(static_cast<uint8_t>(width));
+        w.u8(static_cast<uint8_t>(height));
+        w.u32(tick);
+        int present = 0;
+        for (size_t i = 0; i < snakes.size(); ++i) {
+            if (snakes[i].present) ++present;
+        }
+        w.u8(static_cast<uint8_t>(present));
+        for (size_t i = 0; i < snakes.size(); ++i) {
+            const MpSnake& s = snakes[i];
+            if (!s.present) continue;
+            w.u8(static_cast<uint8_t>(i));
+            w.u8(static_cast<uint8_t>((s.alive ? 4 : 0) | s.dir));
+            w.varint(static_cast<uint32_t>(s.score));
+            w.varint(static_cast<uint32_t>(s.body.size()));
+            for (size_t j = 0; j < s.body.size(); ++j) w.u16(s.body[j]);
+        }
+        std::vector<uint16_t> cells = sortedFood();
+        w.varint(static_cast<uint32_t>(cells.size()));
+        for (size_t i = 0; i < cells.size(); ++i) w.u16(cells[i]);
+    }
+
+    // Reader positioned after the MP_SNAPSHOT opcode
+    bool decodeSnapshot(WireReader& r) {
+        int w = r.u8();
+        int h = r.u8();
+        if (!r.ok() || w < 3 || h < 3) return false;
+        resize(w, h);
+        tick = r.u32();
+        int present = r.u8();
+        for (int k = 0; k < present && r.ok(); ++k) {
+            int id = r.u8();
+            uint8_t flags = r.u8();
+            if (id >= MP_MAX_PLAYERS) return false;
+            MpSnake& s = snakes[id];
+            s.present = true;
+            s.alive = (flags & 4) != 0;
+            s.dir = flags & 3;
+            s.score = static_cast<int>(r.varint());
+            uint32_t len = r.varint();
+            for (uint32_t j = 0; j < len && r.ok(); ++j) {
+                uint16_t cell = r.u16();
+                if (cell >= occupied.size()) return false;
+                s.body.push_back(cell);
+                ++occupied[cell];
+            }
+        }
+        uint32_t foods = r.varint();
+        for (uint32_t k = 0; k < foods && r.ok(); ++k) {
+            uint16_t cell = r.u16();
+            if (cell >= food.size()) return false;
+            addFood(cell);
+        }
+        return r.ok();
+    }
+
+    // Applies the move byte of every living snake, in id order
+    bool applyMoves(WireReader& r) {
+        ++tick;
+        for (size_t i = 0; i < snakes.size(); ++i) {
+            MpSnake& s = snakes[i];
+            if (!s.alive) continue;
+            uint8_t move = r.u8();
+            if (!r.ok()) return false;
+            if (move & MP_MOVE_DIED) {
+                clearBody(s);
+                s.alive = false;
+                continue;
+            }
+            s.dir = move & 3;
+            int head = s.body.front();
+            int nx = cellX(head) + mpDirDx(s.dir);
+            int ny = cellY(head) + mpDirDy(s.dir);
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height) return false;
+            uint16_t cell = static_cast<uint16_t>(cellAt(nx, ny));
+            s.body.push_front(cell);
+            ++occupied[cell];
+            if (move & MP_MOVE_GROW) {
+                removeFood(cell);
+                s.score += FOOD_SCORE;
+            } else {
+                --occupied[s.body.back()];
+                s.body.pop_back();
+            }
+        }
+        return true;
+    }
+
+    // Returns the event type, or 0 if malformed. checksumOk is cleared if a
+    // checksum event does not match this mirror.
+    int applyEvent(WireReader& r, bool& checksumOk) {
+        uint8_t type = r.u8();
+        switch (type) {
+            case MP_EV_FOOD: {
+                uint16_t cell = r.u16();
+                if (!r.ok() || cell >= food.size()) return 0;
+                addFood(cell);
+                return type;
+            }
+            case MP_EV_JOIN: {
+                uint8_t id = r.u8();
+                uint16_t cell = r.u16();
+                uint8_t dir = r.u8();
+                if (!r.ok() || id >= MP_MAX_PLAYERS || cell >= occupied.size()) return 0;
+                MpSnake& s = snakes[id];
+                clearBody(s);
+                s.present = true;
+                s.alive = true;
+                s.dir = dir & 3;
+                s.score = 0;
+                s.body.push_back(cell);
+                ++occupied[cell];
+                return type;
+            }
+            case MP_EV_LEAVE: {
+                uint8_t id = r.u8();
+                if (!r.ok() || id >= MP_MAX_PLAYERS) return 0;
+                clearBody(snakes[id]);
+                snakes[id] = MpSnake();
+                return type;
+            }
+            case MP_EV_CHECKSUM: {
+                uint32_t expected = r.u32();
+                if (!r.ok()) return 0;
+                if (expected != checksum()) checksumOk = false;
+                return type;
+            }
+        }
+        return 0;
+    }
+
+private:
+    std::vector<uint16_t> foodSlot;
+
+    static void mix(uint32_t& h, uint32_t v) {
+        for (int i = 0; i < 4; ++i) {
+            h ^= (v >> (i * 8)) & 0xFF;
+            h *= 16777619u;
+        }
+    }
+
+    void clearBody(MpSnake& s) {
+        for (size_t j = 0; j < s.body.size(); ++j) --occupied[s.body[j]];
+        s.body.clear();
+    }
+};
+
+// Works out one tick for every living snake in two phases. The wishes are
+// gathered first (callers may compute them in parallel); resolve() then
+// decides every outcome from the wishes and the world as it stood, so the
+// result does not depend on the order snakes are visited in:
+//
+//   - a head entering a wall, or a body cell not vacated this tick, dies
+//   - heads meeting in one cell: the longest survives, equal lengths all die
+//   - food in a contested cell goes to the survivor, if there is one
+//
+// The scratch grids are stamped instead of cleared, so a tick costs time
+// in the number of snakes, not in the board area.
+class MpStepper {
+public:
+    MpStepper() : stamp(0) {}
+
+    // wish[id] is a direction, or -1 to keep going. Appends the move byte
+    // of each living snake, in id order, for MultiWorld::applyMoves.
+    void resolve(const MultiWorld& world, const int* wish, WireWriter& w) {
+        size_t area = static_cast<size_t>(world.width * world.height);
+        if (claimStamp.size() != area) {
+            claimStamp.assign(area, 0);
+            tailStamp.assign(area, 0);
+            claimLength.assign(area, 0);
+            claimOwner.assign(area, 0);
+            stamp = 0;
+        }
+        ++stamp;
+
+        for (int id = 0; id < MP_MAX_PLAYERS; ++id) {
+            const MpSnake& s = world.snakes[id];
+            target[id] = -1;
+            if (!s.alive) continue;
+            int dir = s.dir;
+            if (wish[id] >= 0 && !(s.body.size() > 1 && ((wish[id] + 2) & 3) == s.dir)) dir = wish[id];
+            dirs[id] = static_cast<uint8_t>(dir);
+            int head = s.body.front();
+            int nx = world.cellX(head) + mpDirDx(dir);
+            int ny = world.cellY(head) + mpDirDy(dir);
+            if (world.isWall(nx, ny)) continue;
+            int cell = world.cellAt(nx, ny);
+            target[id] = cell;
+            if (!world.food[cell]) tailStamp[s.body.back()] = stamp;
+            uint32_t length = static_cast<uint32_t>(s.body.size());
+            if (claimStamp[cell] != stamp || length > claimLength[cell]) {
+                claimStamp[cell] = stamp;
+                claimLength[cell] = length;
+                claimOwner[cell] = static_cast<int8_t>(id);
+            } else if (length == claimLength[cell]) {
+                claimOwner[cell] = -1;
+            }
+        }
+
+        for (int id = 0; id < MP_MAX_PLAYERS; ++id) {
+            if (!world.snakes[id].alive) continue;
+            int cell = target[id];
+            bool dies = cell < 0 || claimOwner[cell] != id ||
+                        world.occupied[cell] > (tailStamp[cell] == stamp ? 1 : 0);
+            w.u8(static_cast<uint8_t>(dies ? MP_MOVE_DIED : (dirs[id] | (world.food[cell] ? MP_MOVE_GROW : 0))));
+        }
+    }
+
+private:
+    uint32_t stamp;
+    std::vector<uint32_t> claimStamp;
+    std::vector<uint32_t> tailStamp;
+    std::vector<uint32_t> claimLength;
+    std::vector<int8_t> claimOwner;
+    int target[MP_MAX_PLAYERS];
+    uint8_t dirs[MP_MAX_PLAYERS];
+};
+
+// Draws a mirror with the same characters as the single-player board
+inline void renderMultiWorld(const MultiWorld& world, int selfId, std::ostream& out) {
+    std::vector<char> cells(world.width * world.height, EMPTY);
+    for (int c = 0; c < world.width * world.height; ++c) {
+        if (world.isWall(world.cellX(c), world.cellY(c))) cells[c] = WALL;
+        else if (world.food[c]) cells[c] = FOOD;
+    }
+    for (size_t i = 0; i < world.snakes.size(); ++i) {
+        const MpSnake& s = world.snakes[i];
+        bool self = static_cast<int>(i) == selfId;
+        for (size_t j = s.body.size(); j-- > 0;) {
+            char ch;
+            if (j == 0) ch = self ? SNAKE_HEAD : static_cast<char>('A' + i % 26);
+            else ch = self ? SNAKE_BODY : static_cast<char>('a' + i % 26);
+            cells[s.body[j]] = ch;
+        }
+    }
+    out << "\033[H\033[2J";
+    for (int y = 0; y < world.height; ++y) {
+        out.write(&cells[y * world.width], world.width);
+        out << "\n";
+    }
+    out << "\n  Tick: " << world.tick << "  |  Players:";
+    for (size_t i = 0; i < world.snakes.size(); ++i) {
+        const MpSnake& s = world.snakes[i];
+        if (!s.present) continue;
+        out << "  " << (static_cast<int>(i) == selfId ? '@' : static_cast<char>('A' + i % 26))
+            << "=" << s.score << (s.alive ? "" : "(dead)");
+    }
+    out << "\n";
+    const MpSnake& me = world.snakes[selfId];
+    if (!me.alive) out << "  You died. R=Respawn | Q=Quit\n";
+    else out << "  Controls: Arrow Keys or WASD | Q=Quit\n";
+}
+
+class MultiplayerServer {
+public:
+    MultiplayerServer(const std::string& address, int tickMicros, long maxTicks)
+        : addr(address), period(tickMicros), tickLimit(maxTicks), listenFd(-1),
+          bytesSent(0), lastReport(0) {
+        srand(time(0));
+    }
+
+    ~MultiplayerServer() {
+        for (size_t i = 0; i < clients.size(); ++i) close(clients[i].fd);
+        if (listenFd >= 0) {
+            close(listenFd);
+            if (isUnixAddress(addr)) unlink(addr.c_str());
+        }
+    }
+
+    int run() {
+        listenFd = listenOn(addr);
+        if (listenFd < 0) {
+            std::cerr << "Cannot listen on " << addr << "\n";
+            return 1;
+        }
+        std::cout << "Snake server on " << addr << ", tick " << period / 1000 << "ms\n";
+        uint64_t nextTick = nowMicros() + period;
+        while (tickLimit <= 0 || static_cast<long>(world.tick) < tickLimit) {
+            uint64_t now = nowMicros();
+            int timeout = now >= nextTick ? 0 : static_cast<int>((nextTick - now + 999) / 1000);
+            pollOnce(timeout);
+            now = nowMicros();
+            if (now >= nextTick) {
+                step();
+                nextTick += period;
+                if (now > nextTick + period) nextTick = now + period;
+                report();
+            }
+        }
+        std::cout << "\nServer stopped after " << world.tick << " ticks\n";
+        return 0;
+    }
+
+private:
+    struct Client {
+        int fd;
+        int id;
+        int requestedDir;
+        bool wantsSpawn;
+        bool closed;
+        std::vector<uint8_t> out;
+        size_t outPos;
+    };
+
+    std::string addr;
+    int period;
+    long tickLimit;
+    int listenFd;
+    MultiWorld world;
+    std::vector<Client> clients;
+    std::vector<int> pendingLeaves;
+    MpStepper stepper;
+    uint64_t bytesSent;
+    uint64_t lastReport;
+
+    static uint64_t nowMicros() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+    }
+
+    void pollOnce(int timeout) {
+        std::vector<struct pollfd> fds(clients.size() + 1);
+        fds[0].fd = listenFd;
+        fds[0].events = POLLIN;
+        for (size_t i = 0; i < clients.size(); ++i) {
+            fds[i + 1].fd = clients[i].fd;
+            fds[i + 1].events = POLLIN | (clients[i].outPos < clients[i].out.size() ? POLLOUT : 0);
+        }
+        if (poll(&fds[0], fds.size(), timeout) <= 0) return;
+        for (size_t i = 0; i < clients.size(); ++i) {
+            if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) readClient(clients[i]);
+            if (fds[i + 1].revents & POLLOUT) flushClient(clients[i]);
+        }
+        if (fds[0].revents & POLLIN) acceptClients();
+        dropClosed();
+    }
+
+    int freeSlot() const {
+        for (int id = 0; id < MP_MAX_PLAYERS; ++id) {
+            if (world.snakes[id].present) continue;
+            bool taken = false;
+            for (size_t i = 0; i < clients.size(); ++i) {
+                if (clients[i].id == id) taken = true;
+            }
+            for (size_t i = 0; i < pendingLeaves.size(); ++i) {
+                if (pendingLeaves[i] == id) taken = true;
+            }
+            if (!taken) return id;
+        }
+        return -1;
+    }
+
+    void acceptClients() {
+        while (true) {
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd < 0) return;
+            int id = freeSlot();
+            if (id < 0) {
+                close(fd);
+                continue;
+            }
+            setNonBlocking(fd);
+            setNoDelay(fd);
+            Client c;
+            c.fd = fd;
+            c.id = id;
+            c.requestedDir = -1;
+            c.wantsSpawn = true;
+            c.closed = false;
+            c.outPos = 0;
+            std::vector<uint8_t> payload;
+            WireWriter w(payload);
+            w.u8(MP_WELCOME);
+            w.u8(static_cast<uint8_t>(id));
+            mpFrame(payload, c.out);
+            sendSnapshot(c);
+            clients.push_back(c);
+            flushClient(clients.back());
+        }
+    }
+
+    void sendSnapshot(Client& c) {
+        std::vector<uint8_t> payload;
+        world.encodeSnapshot(payload);
+        mpFrame(payload, c.out);
+    }
+
+    void readClient(Client& c) {
+        char buf[256];
+        ssize_t n = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            c.closed = true;
+            return;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            int dir = mpDirFromCommand(buf[i]);
+            if (dir >= 0) c.requestedDir = dir;
+            else if (buf[i] == MP_CMD_SPAWN) c.wantsSpawn = true;
+            else if (buf[i] == MP_CMD_KEYFRAME) sendSnapshot(c);
+        }
+    }
+
+    void flushClient(Client& c) {
+        while (c.outPos < c.out.size()) {
+            ssize_t n = sendSome(c.fd, reinterpret_cast<const char*>(&c.out[c.outPos]),
+                                 c.out.size() - c.outPos);
+            if (n < 0) {
+                c.closed = true;
+                return;
+            }
+            if (n == 0) break;
+            c.outPos += n;
+            bytesSent += n;
+        }
+        if (c.outPos == c.out.size()) {
+            c.out.clear();
+            c.outPos = 0;
+        } else if (c.out.size() - c.outPos > MP_MAX_PENDING) {
+            // Too slow to keep up; dropping it keeps the tick loop honest
+            c.closed = true;
+        }
+    }
+
+    void dropClosed() {
+        for (size_t i = 0; i < clients.size();) {
+            if (clients[i].closed) {
+                close(clients[i].fd);
+                pendingLeaves.push_back(clients[i].id);
+                clients.erase(clients.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    Client* clientFor(int id) {
+        for (size_t i = 0; i < clients.size(); ++i) {
+            if (clients[i].id == id) return &clients[i];
+        }
+        return NULL;
+    }
+
+    int randomFreeCell() const {
+        int area = world.width * world.height;
+        for (int tries = 0; tries < area * 4; ++tries) {
+            int cell = rand() % area;
+            if (world.isFree(cell)) return cell;
+        }
+        return -1;
+    }
+
+    // Decides this tick's moves and events, applying them to the local world
+    // through the same decoder the clients run
+    void step() {
+        std::vector<uint8_t> payload;
+        WireWriter w(payload);
+        w.u8(MP_TICK);
+
+        int wish[MP_MAX_PLAYERS];
+        for (int id = 0; id < MP_MAX_PLAYERS; ++id) {
+            wish[id] = -1;
+            Client* c = world.snakes[id].alive ? clientFor(id) : NULL;
+            if (c) {
+                wish[id] = c->requestedDir;
+                c->requestedDir = -1;
+            }
+        }
+        stepper.resolve(world, wish, w);
+        {
+            WireReader r(&payload[1], payload.size() - 1);
+            world.applyMoves(r);
+        }
+
+        std::vector<uint8_t> events;
+        int eventCount = 0;
+        bool unusedOk = true;
+        for (size_t i = 0; i < pendingLeaves.size(); ++i) {
+            std::vector<uint8_t> ev;
+            WireWriter e(ev);
+            e.u8(MP_EV_LEAVE);
+            e.u8(static_cast<uint8_t>(pendingLeaves[i]));
+            applyLocal(ev, events, eventCount, unusedOk);
+        }
+        pendingLeaves.clear();
+        for (size_t i = 0; i < clients.size(); ++i) {
+            Client& c = clients[i];
+            if (!c.wantsSpawn || world.snakes[c.id].alive) continue;
+            int cell = randomFreeCell();
+            if (cell < 0) continue;
+            int x = world.cellX(cell);
+            std::vector<uint8_t> ev;
+            WireWriter e(ev);
+            e.u8(MP_EV_JOIN);
+            e.u8(static_cast<uint8_t>(c.id));
+            e.u16(static_cast<uint16_t>(cell));
+            e.u8(x < world.width / 2 ? 1 : 3);
+            applyLocal(ev, events, eventCount, unusedOk);
+            c.wantsSpawn = false;
+            c.requestedDir = -1;
+        }
+        int wantFood = world.aliveCount() > 1 ? world.aliveCount() : 1;
+        for (int n = world.foodCount(); n < wantFood; ++n) {
+            int cell = randomFreeCell();
+            if (cell < 0) break;
+            std::vector<uint8_t> ev;
+            WireWriter e(ev);
+            e.u8(MP_EV_FOOD);
+            e.u16(static_cast<uint16_t>(cell));
+            applyLocal(ev, events, eventCount, unusedOk);
+        }
+        if (world.tick % MP_CHECKSUM_INTERVAL == 0) {
+            WireWriter e(events);
+            e.u8(MP_EV_CHECKSUM);
+            e.u32(world.checksum());
+            ++eventCount;
+        }
+
+        w.varint(static_cast<uint32_t>(eventCount));
+        payload.insert(payload.end(), events.begin(), events.end());
+        std::vector<uint8_t> frame;
+        mpFrame(payload, frame);
+        for (size_t i = 0; i < clients.size(); ++i) {
+            Client& c = clients[i];
+            c.out.insert(c.out.end(), frame.begin(), frame.end());
+            flushClient(c);
+        }
+        dropClosed();
+    }
+
+    void applyLocal(const std::vector<uint8_t>& ev, std::vector<uint8_t>& events,
+                    int& eventCount, bool& ok) {
+        WireReader r(&ev[0], ev.size());
+        world.applyEvent(r, ok);
+        events.insert(events.end(), ev.begin(), ev.end());
+        ++eventCount;
+    }
+
+    void report() {
+        if (world.tick - lastReport < 1000000 / static_cast<uint64_t>(period) && world.tick > 1) return;
+        double perClientTick = 0;
+        if (!clients.empty() && world.tick > lastReport) {
+            perClientTick = static_cast<double>(bytesSent) / clients.size() / (world.tick - lastReport);
+        }
+        std::cout << "\r  tick " << world.tick << "  players " << clients.size()
+                  << "  alive " << world.aliveCount() << "  bytes/tick/client "
+                  << static_cast<int>(perClientTick * 10) / 10.0 << "      " << std::flush;
+        bytesSent = 0;
+        lastReport = world.tick;
+    }
+};
+
+class MultiplayerClient {
+public:
+    MultiplayerClient(const std::string& address, bool botMode, long maxTicks)
+        : addr(address), bot(botMode), tickLimit(maxTicks), fd(-1), selfId(-1),
+          synced(false), ticks(0), bytesIn(0), checksumsOk(0), checksumsBad(0) {
+        srand(time(0) ^ getpid());
+    }
+
+    ~MultiplayerClient() {
+        if (fd >= 0) close(fd);
+    }
+
+    int run() {
+        fd = connectTo(addr);
+        if (fd < 0) {
+            std::cerr << "Cannot connect to " << addr << "\n";
+            return 1;
+        }
+        setNoDelay(fd);
+        setNonBlocking(fd);
+        return bot ? runBot() : runInteractive();
+    }
+
+private:
+    std::string addr;
+    bool bot;
+    long tickLimit;
+    int fd;
+    int selfId;
+    bool synced;
+    long ticks;
+    uint64_t bytesIn;
+    long checksumsOk;
+    long checksumsBad;
+    MultiWorld world;
+    std::vector<uint8_t> inbuf;
+
+    void sendCommand(char c) {
+        sendSome(fd, &c, 1);
+    }
+
+    // Returns false when the server has gone away
+    bool receive(bool& gotTick) {
+        char buf[65536];
+        while (true) {
+            ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (n == 0) return false;
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) break;
+                return false;
+            }
+            bytesIn += n;
+            inbuf.insert(inbuf.end(), buf, buf + n);
+        }
+        size_t consumed = 0;
+        size_t start;
+        size_t len;
+        while (mpTakeFrame(inbuf, consumed, start, len)) {
+            if (len == 0) continue;
+            WireReader r(&inbuf[start], len);
+            uint8_t type = r.u8();
+            if (type == MP_WELCOME) {
+                selfId = r.u8();
+            } else if (type == MP_SNAPSHOT) {
+                synced = world.decodeSnapshot(r);
+            } else if (type == MP_TICK && synced) {
+                bool ok = true;
+                if (!world.applyMoves(r)) ok = false;
+                uint32_t count = r.varint();
+                bool sumOk = true;
+                bool hadSum = false;
+                for (uint32_t i = 0; i < count && ok; ++i) {
+                    int type = world.applyEvent(r, sumOk);
+                    if (type == MP_EV_CHECKSUM) hadSum = true;
+                    ok = type != 0;
+                }
+                if (hadSum) {
+                    if (sumOk) ++checksumsOk;
+                    else ++checksumsBad;
+                }
+                if (!ok || !sumOk) {
+                    synced = false;
+                    sendCommand(MP_CMD_KEYFRAME);
+                }
+                ++ticks;
+                gotTick = true;
+            }
+        }
+        inbuf.erase(inbuf.begin(), inbuf.begin() + consumed);
+        return true;
+    }
+
+    int runInteractive() {
+        TerminalInput terminal;
+        std::cout << "\033[?25l";
+        bool running = true;
+        while (running) {
+            struct pollfd fds[2];
+            fds[0].fd = STDIN_FILENO;
+            fds[0].events = POLLIN;
+            fds[1].fd = fd;
+            fds[1].events = POLLIN;
+            if (poll(fds, 2, -1) < 0 && errno != EINTR) break;
+            if (fds[0].revents & POLLIN) {
+                while (terminal.kbhit()) {
+                    char key = terminal.getch();
+                    if (key == '\033') {
+                        terminal.getch();
+                        key = terminal.getch();
+                        if (key == 'A') sendCommand(MP_CMD_UP);
+                        else if (key == 'B') sendCommand(MP_CMD_DOWN);
+                        else if (key == 'C') sendCommand(MP_CMD_RIGHT);
+                        else if (key == 'D') sendCommand(MP_CMD_LEFT);
+                        continue;
+                    }
+                    if (key >= 'A' && key <= 'Z') key = key + 32;
+                    if (key == 'w') sendCommand(MP_CMD_UP);
+                    else if (key == 's') sendCommand(MP_CMD_DOWN);
+                    else if (key == 'a') sendCommand(MP_CMD_LEFT);
+                    else if (key == 'd') sendCommand(MP_CMD_RIGHT);
+                    else if (key == 'r') sendCommand(MP_CMD_SPAWN);
+                    else if (key == 'q') running = false;
+                }
+            }
+            if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                bool gotTick = false;
+                if (!receive(gotTick)) {
+                    std::cout << "\033[?25h\nServer closed the connection.\n";
+                    return 1;
+                }
+                if (gotTick && synced && selfId >= 0) {
+                    std::ostringstream frame;
+                    renderMultiWorld(world, selfId, frame);
+                    const std::string& out = frame.str();
+                    std::cout.write(out.data(), out.size());
+                    std::cout.flush();
+                }
+            }
+        }
+        std::cout << "\033[?25h";
+        return 0;
+    }
+
+    // Headless player for loopback testing: steers toward food, avoids
+    // obvious collisions and reports bandwidth and checksum results
+    int runBot() {
+        while (tickLimit <= 0 || ticks < tickLimit) {
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, 5000) <= 0) break;
+            bool gotTick = false;
+            if (!receive(gotTick)) break;
+            if (!gotTick || !synced || selfId < 0) continue;
+            const MpSnake& me = world.snakes[selfId];
+            if (!me.alive) {
+                sendCommand(MP_CMD_SPAWN);
+                continue;
+            }
+            int dir = chooseDirection(me);
+            if (dir != me.dir) sendCommand(mpCommandFromDir(dir));
+        }
+        std::printf("bot %d: %ld ticks, %.1f bytes/tick, checksums %ld ok %ld bad\n",
+                    selfId, ticks, ticks ? static_cast<double>(bytesIn) / ticks : 0.0,
+                    checksumsOk, checksumsBad);
+        return checksumsBad == 0 ? 0 : 2;
+    }
+
+    int chooseDirection(const MpSnake& me) const {
+        int head = me.body.front();
+        int hx = world.cellX(head);
+        int hy = world.cellY(head);
+        int best = me.dir;
+        int bestScore = -1000000;
+        for (int d = 0; d < 4; ++d) {
+            if (me.body.size() > 1 && ((d + 2) & 3) == me.dir) continue;
+            int nx = hx + mpDirDx(d);
+            int ny = hy + mpDirDy(d);
+            if (world.isWall(nx, ny) || world.occupied[world.cellAt(nx, ny)]) continue;
+            int nearest = world.width + world.height;
+            for (size_t i = 0; i < world.foodCells.size(); ++i) {
+                int c = world.foodCells[i];
+                int dist = std::abs(world.cellX(c) - nx) + std::abs(world.cellY(c) - ny);
+                if (dist < nearest) nearest = dist;
+            }
+            int score = -nearest * 4 + rand() % 3;
+            if (score > bestScore) {
+                bestScore = score;
+                best = d;
+            }
+        }
+        return best;
+    }
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef NET_UTIL_H
+#define NET_UTIL_H
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// Addresses are either a Unix socket path (anything containing '/') or a
+// TCP port on localhost, optionally written as host:port. The host must be
+// a loopback address; nothing here listens on or connects to the network.
+
+inline bool isUnixAddress(const std::string& addr) {
+    return addr.find('/') != std::string::npos;
+}
+
+inline bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+inline bool parseTcpAddress(const std::string& addr, struct sockaddr_in& sa) {
+    std::string host = "127.0.0.1";
+    std::string port = addr;
+    size_t colon = addr.rfind(':');
+    if (colon != std::string::npos) {
+        host = addr.substr(0, colon);
+        port = addr.substr(colon + 1);
+        if (host.empty() || host == "localhost") host = "127.0.0.1";
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(static_cast<uint16_t>(atoi(port.c_str())));
+    return atoi(port.c_str()) > 0 && inet_pton(AF_INET, host.c_str(), &sa.sin_addr) == 1 &&
+           (ntohl(sa.sin_addr.s_addr) >> 24) == 127;
+}
+
+// Returns a non-blocking listening socket, or -1. A stale socket left at a
+// Unix path is replaced; any other file there is left alone and fails.
+inline int listenOn(const std::string& addr, int backlog = 128) {
+    int fd;
+    if (isUnixAddress(addr)) {
+        struct sockaddr_un sa;
+        if (addr.size() >= sizeof(sa.sun_path)) return -1;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        strcpy(sa.sun_path, addr.c_str());
+        struct stat st;
+        if (lstat(addr.c_str(), &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) return -1;
+            unlink(addr.c_str());
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (bind(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa)) != 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        struct sockaddr_in sa;
+        if (!parseTcpAddress(addr, sa)) return -1;
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, backlog) != 0 || !setNonBlocking(fd)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Blocking connect; returns the connected socket or -1
+inline int connectTo(const std::string& addr) {
+    int fd;
+    int rc;
+    if (isUnixAddress(addr)) {
+        struct sockaddr_un sa;
+        if (addr.size() >= sizeof(sa.sun_path)) return -1;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        strcpy(sa.sun_path, addr.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        rc = connect(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa));
+    } else {
+        struct sockaddr_in sa;
+        if (!parseTcpAddress(addr, sa)) return -1;
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        rc = connect(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa));
+    }
+    if (rc != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Small per-tick messages should not wait for Nagle
+inline void setNoDelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// Writes as much of buf as the socket accepts without blocking.
+// Returns bytes written, or -1 if the peer is gone.
+inline ssize_t sendSome(int fd, const char* buf, size_t len) {
+    ssize_t n = send(fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+        return -1;
+    }
+    return n;
+}
+
+// Writes all of buf, waiting up to timeoutMs each time the socket is full.
+// For short-lived request sockets; false if the peer is gone or stalls.
+inline bool sendAll(int fd, const char* buf, size_t len, int timeoutMs) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = sendSome(fd, buf + sent, len - sent);
+        if (n < 0) return false;
+        sent += n;
+        if (sent == len) break;
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        if (poll(&pfd, 1, timeoutMs) <= 0) return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef REFERENCE_GAME_H
+#define REFERENCE_GAME_H
+
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+#include "snake_core.h"
+#include "level_format.h"
+
+// The rules of GameEngine written the plain way: the body is a vector with
+// the head in front, items are one list searched linearly, and every timer
+// is a tick number compared against the clock each tick. Nothing here is
+// meant to be fast. diff_harness runs it in lockstep with GameEngine, so
+// whatever the engine does for speed has to leave these rules unchanged.
+//
+// Random draws happen at exactly the points GameEngine makes them, which
+// is what lets the two be compared tick by tick from the same seed.
+class ReferenceGame {
+public:
+    struct Item {
+        Position pos;
+        int type;
+    };
+
+    ReferenceGame(uint64_t seed, const LevelMap* map, int foods, bool easy, bool wrap)
+        : level(map), foodTarget(foods), easyMode(easy), wrapMode(wrap), rng(seed) {
+        reset();
+    }
+
+    void reset() {
+        spawnSnake();
+        score = 0;
+        foodsEaten = 0;
+        gameOver = false;
+        paused = false;
+        tick = 0;
+        scheduled = 0;
+        restartItems();
+    }
+
+    void setDirection(const Position& d) {
+        if (d.x == 0 && d.y == 0) return;
+        if (body.size() > 1 && Position(body[0].x + d.x, body[0].y + d.y) == body[1]) return;
+        dir = d;
+    }
+
+    void setPaused(bool p) { paused = p; }
+
+    const vector<Position>& getBody() const { return body; }
+    const Position& getDirection() const { return dir; }
+    const vector<Item>& getItems() const { return items; }
+    int getScore() const { return score; }
+    int getFoodsEaten() const { return foodsEaten; }
+    bool isGameOver() const { return gameOver; }
+    uint64_t getTick() const { return tick; }
+    uint64_t rngState() const { return rng.getState(); }
+    bool isPaused() const { return paused; }
+
+    RuleTimers getTimers() const {
+        RuleTimers t;
+        t.specialReady = specialReady;
+        t.poisonReady = poisonReady;
+        t.specialSpawn = specialSpawn.due;
+        t.specialExpire = specialExpire.due;
+        t.poisonSpawn = poisonSpawn.due;
+        return t;
+    }
+
+    bool update() {
+        if (gameOver || paused) return false;
+        ++tick;
+        runTimers();
+        if (filled()) {
+            gameOver = true;
+            return true;
+        }
+
+        Position head(body[0].x + dir.x, body[0].y + dir.y);
+        int width = level->width();
+        int height = level->height();
+        if (wrapMode) {
+            if (head.x <= 0) head.x = width - 2;
+            else if (head.x >= width - 1) head.x = 1;
+            if (head.y <= 0) head.y = height - 2;
+            else if (head.y >= height - 1) head.y = 1;
+        }
+        uint32_t cell = static_cast<uint32_t>(head.y * width + head.x);
+        if (level->isPortal(cell)) {
+            cell = level->portalTarget(cell);
+            head = Position(cell % width, cell / width);
+        }
+
+        bool hit = level->isWall(cell);
+        for (size_t i = 1; i < body.size(); ++i) {
+            if (body[i] == head) hit = true;
+        }
+        if (hit) {
+            if (easyMode) {
+                score = score > 50 ? score - 50 : 0;
+                spawnSnake();
+                foodsEaten = 0;
+                restartItems();
+                return false;
+            }
+            gameOver = true;
+            return true;
+        }
+
+        bool grow = eat(head);
+        body.insert(body.begin(), head);
+        if (!grow) body.pop_back();
+        if (filled()) {
+            gameOver = true;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    // A pending timer; order breaks ties between timers due on the same
+    // tick, earliest armed first
+    struct Timer {
+        uint64_t due;
+        uint64_t order;
+        Timer() : due(0), order(0) {}
+    };
+
+    const LevelMap* level;
+    vector<Position> body;
+    Position dir;
+    vector<Item> items;
+    int foodTarget;
+    int score;
+    int foodsEaten;
+    bool gameOver;
+    bool paused;
+    bool easyMode;
+    bool wrapMode;
+    uint64_t tick;
+    uint64_t scheduled;
+    uint64_t specialReady;
+    uint64_t poisonReady;
+    Timer specialSpawn;
+    Timer specialExpire;
+    Timer poisonSpawn;
+    GameRng rng;
+
+    void spawnSnake() {
+        uint32_t spawns = level->spawnCount();
+        uint32_t cell = level->spawnCell(spawns > 1 ? rng.below(spawns) : 0);
+        body.assign(1, Position(cell % level->width(), cell / level->width()));
+        dir = Position(1, 0);
+    }
+
+    int findItem(const Position& p) const {
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (items[i].pos == p) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    int countItems(int type) const {
+        int n = 0;
+        for (size_t i = 0; i < items.size(); ++i) n += items[i].type == type;
+        return n;
+    }
+
+    // Removing an item moves the last one into its place
+    void removeItem(int index) {
+        items[index] = items.back();
+        items.pop_back();
+    }
+
+    void addItem(int type, const Position& p) {
+        Item item;
+        item.pos = p;
+        item.type = type;
+        items.push_back(item);
+    }
+
+    Position randomFreeCell() {
+        int width = level->width();
+        while (true) {
+            uint32_t cell = level->freeCell(rng.below(static_cast<int>(level->freeCount())));
+            Position p(cell % width, cell / width);
+            if (findItem(p) >= 0) continue;
+            if (std::find(body.begin(), body.end(), p) != body.end()) continue;
+            return p;
+        }
+    }
+
+    // Every free cell holds the snake or poison
+    bool filled() const { return body.size() + countItems(ITEM_POISON) >= level->freeCount(); }
+
+    // Some cell is held by neither the snake, an item nor the head about to
+    // move in (pending)
+    bool hasRoom(size_t pending) const { return body.size() + items.size() + pending < level->freeCount(); }
+
+    void arm(Timer& timer, uint64_t due) {
+        timer.due = due;
+        timer.order = ++scheduled;
+    }
+
+    void armSpecialSpawn(int cooldown) {
+        specialReady = tick + cooldown;
+        arm(specialSpawn, specialReady + rng.trialsUntil(SPECIAL_FOOD_CHANCE));
+    }
+
+    void armPoisonSpawn(int cooldown) {
+        poisonReady = tick + cooldown;
+        arm(poisonSpawn, poisonReady + rng.trialsUntil(POISON_FOOD_CHANCE));
+    }
+
+    void placeSpecial(const Position& p) {
+        addItem(ITEM_SPECIAL, p);
+        arm(specialExpire, tick + SPECIAL_FOOD_LIFETIME);
+        specialSpawn = Timer();
+    }
+
+    void placePoison() {
+        addItem(ITEM_POISON, randomFreeCell());
+        poisonSpawn = Timer();
+    }
+
+    void runTimers() {
+        Timer* due[3];
+        int n = 0;
+        Timer* all[3] = {&specialSpawn, &specialExpire, &poisonSpawn};
+        for (int i = 0; i < 3; ++i) {
+            if (all[i]->due != 0 && all[i]->due <= tick) due[n++] = all[i];
+        }
+        for (int i = 1; i < n; ++i) {
+            for (int j = i; j > 0 && due[j]->order < due[j - 1]->order; --j) std::swap(due[j], due[j - 1]);
+        }
+        for (int i = 0; i < n; ++i) {
+            Timer* t = due[i];
+            *t = Timer();
+            if (t == &specialSpawn) {
+                if (hasRoom(0)) placeSpecial(randomFreeCell());
+                else armSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+            } else if (t == &specialExpire) {
+                for (size_t k = 0; k < items.size(); ++k) {
+                    if (items[k].type == ITEM_SPECIAL) {
+                        removeItem(static_cast<int>(k));
+                        break;
+                    }
+                }
+                armSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+            } else if (hasRoom(0)) {
+                placePoison();
+            } else {
+                armPoisonSpawn(POISON_COOLDOWN_INIT);
+            }
+        }
+    }
+
+    void restartItems() {
+        items.clear();
+        specialExpire = Timer();
+        int foods = std::min(foodTarget, static_cast<int>(level->freeCount() / 2));
+        for (int i = 0; i < foods; ++i) addItem(ITEM_FOOD, randomFreeCell());
+        armSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+        armPoisonSpawn(POISON_COOLDOWN_INIT);
+    }
+
+    bool eat(const Position& head) {
+        int index = findItem(head);
+        if (index < 0) return false;
+        int type = items[index].type;
+        removeItem(index);
+        if (type == ITEM_SPECIAL) {
+            specialExpire = Timer();
+            score += SPECIAL_SCORE;
+            foodsEaten++;
+            armSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+            for (size_t k = 0; k < items.size(); ++k) {
+                if (items[k].type == ITEM_FOOD) {
+                    removeItem(static_cast<int>(k));
+                    addItem(ITEM_FOOD, randomFreeCell());
+                    break;
+                }
+            }
+            return true;
+        }
+        if (type == ITEM_POISON) {
+            score = score > POISON_PENALTY ? score - POISON_PENALTY : 0;
+            for (int i = 0; i < 3 && body.size() > 1; ++i) body.pop_back();
+            armPoisonSpawn(POISON_COOLDOWN_INIT);
+            return false;
+        }
+        score += FOOD_SCORE;
+        foodsEaten++;
+        if (hasRoom(1)) addItem(ITEM_FOOD, randomFreeCell());
+        if (countItems(ITEM_SPECIAL) == 0 && tick >= specialReady && rng.below(100) < SPECIAL_FOOD_CHANCE &&
+            hasRoom(1)) {
+            placeSpecial(randomFreeCell());
+        }
+        if (countItems(ITEM_POISON) == 0 && tick >= poisonReady && rng.below(100) < POISON_FOOD_CHANCE &&
+            hasRoom(1)) {
+            placePoison();
+        }
+        return true;
+    }
+};
+
+#endif
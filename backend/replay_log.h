@@ -0,0 +1,330 @@
+#ifndef REPLAY_LOG_H
+#define REPLAY_LOG_H
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "game_engine.h"
+#include "wire_format.h"
+
+// Whole-game replays. The engine is deterministic, so a game is its
+// starting state plus the direction going into each tick where that
+// direction changed. A replay file is a plain sequence of records, one
+// appended per finished game, so files can be concatenated and any number
+// of games streamed through one buffer.
+//
+//   record:  "SRPL"  u32 length  then length bytes:
+//            u8 version  u8 flags  u64 seed (version 2 on)
+//            varint level path length, path bytes
+//            varint ticks  varint score
+//            varint state length, GameEngine::writeState bytes
+//            varint move count, then per move: varint tick delta, u8 direction
+//
+// Each tick delta counts from the move before it (the first from the
+// starting state); directions use the same one-byte code as the rewind
+// history. ReplayGame::decode turns the deltas back into ticks counted
+// from the start.
+//
+// The seed is the one the engine was reseeded with just before the reset
+// that started the game, or 0 for a game that did not start that way (a
+// loaded save). With it a game can be rebuilt without trusting the
+// recorded starting state at all.
+//
+// Version 3 games draw their bonus spawn ticks with integer arithmetic; an
+// older record plays back with different spawns, so it cannot be verified.
+
+const uint8_t REPLAY_VERSION = 3;
+const uint32_t REPLAY_MAX_RECORD = 16 << 20;
+
+enum ReplayFlags {
+    REPLAY_DIED = 1,  // ended by a collision, not by quitting
+    REPLAY_AI = 2     // played by the autopilot
+};
+
+inline uint8_t replayDirectionCode(const Position& dir) {
+    return static_cast<uint8_t>((dir.x + 1) | ((dir.y + 1) << 2));
+}
+
+inline Position replayDirection(uint8_t code) {
+    return Position((code & 3) - 1, ((code >> 2) & 3) - 1);
+}
+
+struct ReplayMove {
+    uint64_t tick;
+    uint8_t dir;
+};
+
+// One decoded record; the vectors are reused from game to game
+struct ReplayGame {
+    uint8_t version;
+    uint8_t flags;
+    uint64_t seed;
+    std::string levelPath;
+    uint64_t ticks;
+    uint32_t score;
+    std::vector<uint8_t> state;
+    std::vector<ReplayMove> moves;
+
+    bool decode(const uint8_t* data, size_t size) {
+        WireReader r(data, size);
+        version = r.u8();
+        if (version < 1 || version > REPLAY_VERSION) return false;
+        flags = r.u8();
+        seed = version >= 2 ? r.u64() : 0;
+        uint32_t pathLength = r.varint();
+        if (!r.ok() || pathLength > size) return false;
+        levelPath.resize(pathLength);
+        for (uint32_t i = 0; i < pathLength; ++i) levelPath[i] = static_cast<char>(r.u8());
+        ticks = r.varint64();
+        score = r.varint();
+        uint32_t stateLength = r.varint();
+        if (!r.ok() || stateLength > size) return false;
+        state.resize(stateLength);
+        for (uint32_t i = 0; i < stateLength; ++i) state[i] = r.u8();
+        uint32_t count = r.varint();
+        if (!r.ok() || count > size) return false;
+        moves.resize(count);
+        uint64_t tick = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            tick += r.varint64();
+            moves[i].tick = tick;
+            moves[i].dir = r.u8();
+        }
+        return r.ok();
+    }
+};
+
+// Builds the record for the game in progress and, when the game ends,
+// appends it to the file if one is open and keeps it for lastRecord(). A
+// game that is abandoned (rewound, replaced by a load) is never finished.
+class ReplayRecorder {
+public:
+    static const size_t MOVE_RESERVE = 16384;
+
+    ReplayRecorder()
+        : file(NULL), active(false), flags(0), gameSeed(0), moveCount(0), lastDir(0), startTick(0), lastTick(0),
+          ticks(0), score(0) {}
+    ~ReplayRecorder() { close(); }
+
+    bool open(const std::string& path) {
+        file = fopen(path.c_str(), "ab");
+        return file != NULL;
+    }
+
+    void close() {
+        if (file) fclose(file);
+        file = NULL;
+    }
+
+    bool isOpen() const { return file != NULL; }
+
+    // Starts recording from the engine's current state, finishing any game
+    // still in progress as quit. seed is what the engine was seeded with
+    // right before its reset, or 0.
+    void begin(const GameEngine& game, const std::string& levelPath, bool ai, uint64_t seed) {
+        finish(false);
+        state.clear();
+        WireWriter w(state);
+        game.writeState(w);
+        // Room for a long game's turns up front, so recording a tick does
+        // not grow the buffer; a longer game still grows it, rarely
+        moves.clear();
+        if (moves.capacity() < MOVE_RESERVE) moves.reserve(MOVE_RESERVE);
+        moveCount = 0;
+        path = levelPath;
+        flags = ai ? REPLAY_AI : 0;
+        gameSeed = seed;
+        startTick = lastTick = game.getTick();
+        ticks = 0;
+        score = game.getScore();
+        lastDir = replayDirectionCode(game.getSnake().getDirection());
+        active = true;
+    }
+
+    // After each tick the engine advanced, with the direction going into it
+    void record(const GameEngine& game, const Position& dir) {
+        if (!active) return;
+        uint8_t code = replayDirectionCode(dir);
+        if (code != lastDir) {
+            WireWriter w(moves);
+            w.varint(game.getTick() - lastTick);
+            w.u8(code);
+            lastTick = game.getTick();
+            lastDir = code;
+            ++moveCount;
+        }
+        ticks = game.getTick() - startTick;
+        score = game.getScore();
+    }
+
+    void abandon() { active = false; }
+
+    // Encodes the record and appends it to the file; one write per game. A
+    // game that never moved is not worth one.
+    void finish(bool died) {
+        if (!active) return;
+        active = false;
+        if (ticks == 0) return;
+        body.resize(8);
+        WireWriter w(body);
+        w.u8(REPLAY_VERSION);
+        w.u8(flags | (died ? REPLAY_DIED : 0));
+        w.u64(gameSeed);
+        w.varint(static_cast<uint32_t>(path.size()));
+        for (size_t i = 0; i < path.size(); ++i) w.u8(static_cast<uint8_t>(path[i]));
+        w.varint(ticks);
+        w.varint(static_cast<uint32_t>(score));
+        w.varint(static_cast<uint32_t>(state.size()));
+        body.insert(body.end(), state.begin(), state.end());
+        w.varint(moveCount);
+        body.insert(body.end(), moves.begin(), moves.end());
+
+        memcpy(&body[0], "SRPL", 4);
+        uint32_t length = static_cast<uint32_t>(body.size() - 8);
+        for (int i = 0; i < 4; ++i) body[4 + i] = static_cast<uint8_t>(length >> (8 * i));
+        if (file) {
+            fwrite(&body[0], 1, body.size(), file);
+            fflush(file);
+        }
+    }
+
+    // The last finished game as written to the file, header included
+    const std::vector<uint8_t>& lastRecord() const { return body; }
+
+private:
+    FILE* file;
+    bool active;
+    uint8_t flags;
+    uint64_t gameSeed;
+    std::string path;
+    std::vector<uint8_t> state;
+    std::vector<uint8_t> moves;
+    std::vector<uint8_t> body;
+    uint32_t moveCount;
+    uint8_t lastDir;
+    uint64_t startTick;
+    uint64_t lastTick;
+    uint64_t ticks;
+    int score;
+
+    ReplayRecorder(const ReplayRecorder&);
+    ReplayRecorder& operator=(const ReplayRecorder&);
+};
+
+// Reads records one at a time into a caller-owned buffer
+class ReplayReader {
+public:
+    ReplayReader() : file(NULL), damaged(false) {}
+    ~ReplayReader() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+        damaged = false;
+        file = fopen(path.c_str(), "rb");
+        return file != NULL;
+    }
+
+    void close() {
+        if (file) fclose(file);
+        file = NULL;
+    }
+
+    // False at the end of the file or at the first damaged record
+    bool next(std::vector<uint8_t>& record) {
+        if (!file) return false;
+        uint8_t header[8];
+        size_t got = fread(header, 1, sizeof(header), file);
+        if (got == 0) return false;
+        uint32_t length = header[4] | (header[5] << 8) | (header[6] << 16) | (static_cast<uint32_t>(header[7]) << 24);
+        if (got != sizeof(header) || memcmp(header, "SRPL", 4) != 0 || length == 0 || length > REPLAY_MAX_RECORD) {
+            damaged = true;
+            return false;
+        }
+        record.resize(length);
+        if (fread(&record[0], 1, length, file) != length) {
+            damaged = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool isDamaged() const { return damaged; }
+
+private:
+    FILE* file;
+    bool damaged;
+
+    ReplayReader(const ReplayReader&);
+    ReplayReader& operator=(const ReplayReader&);
+};
+
+// Splits a whole record (as from lastRecord()) into its body
+inline bool replayRecordBody(const uint8_t* data, size_t size, const uint8_t*& body, size_t& length) {
+    if (size < 8 || memcmp(data, "SRPL", 4) != 0) return false;
+    length = data[4] | (data[5] << 8) | (data[6] << 16) | (static_cast<uint32_t>(data[7]) << 24);
+    if (length != size - 8) return false;
+    body = data + 8;
+    return true;
+}
+
+// Compiled levels by path, loaded on first use. Not shared between
+// threads; each replaying thread keeps its own. Paths come from the
+// records, so a cache serving other people's records is restricted to one
+// directory of level files.
+class LevelCache {
+public:
+    LevelCache() : restricted(false) {}
+
+    ~LevelCache() {
+        for (std::map<std::string, LevelMap*>::iterator it = levels.begin(); it != levels.end(); ++it) delete it->second;
+    }
+
+    // NULL when the level named in a replay cannot be loaded. "size:WxH"
+    // names a plain board of that size (snake_game --size).
+    const LevelMap* get(const std::string& path) {
+        if (path.empty()) return &LevelMap::standard();
+        std::map<std::string, LevelMap*>::iterator it = levels.find(path);
+        if (it != levels.end()) return it->second;
+        LevelMap* level = new LevelMap();
+        std::string error;
+        int w = 0, h = 0;
+        bool loaded = path.compare(0, 5, "size:") == 0
+                          ? sscanf(path.c_str() + 5, "%dx%d", &w, &h) == 2 && level->plain(w, h, error)
+                          : allowed(path) && level->load(path, error);
+        if (!loaded) {
+            delete level;
+            level = NULL;
+        }
+        levels[path] = level;
+        return level;
+    }
+
+    // From now on level files load only from inside dir (symlinks and ".."
+    // resolved); a dir that does not exist allows none
+    void restrictTo(const std::string& dir) {
+        restricted = true;
+        char resolved[PATH_MAX];
+        root = realpath(dir.c_str(), resolved) ? std::string(resolved) + "/" : "";
+    }
+
+private:
+    std::map<std::string, LevelMap*> levels;
+    bool restricted;
+    std::string root;
+
+    bool allowed(const std::string& path) const {
+        if (!restricted) return true;
+        char resolved[PATH_MAX];
+        return !root.empty() && realpath(path.c_str(), resolved) && strncmp(resolved, root.c_str(), root.size()) == 0;
+    }
+
+    LevelCache(const LevelCache&);
+    LevelCache& operator=(const LevelCache&);
+};
+
+#endif
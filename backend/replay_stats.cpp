@@ -0,0 +1,579 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "game_engine.h"
+#include "replay_log.h"
+#include "tick_profiler.h"
+#include "wire_format.h"
+
+using namespace std;
+
+// Mines a corpus of replays (see replay_log.h) for where snakes die and
+// why. Files and directories of .rpl files are streamed a batch of games
+// at a time, so the corpus never has to fit in memory: one thread reads,
+// the others replay each game through GameEngine and count into their own
+// accumulators, and the accumulators are added up once at the end.
+//
+// Every collision is put down to one cause: the border, an interior wall,
+// the snake's own body, or "trapped" when no other move was open either.
+// For trapped snakes the last food they ate is counted too, since that is
+// usually what led them in. Results go to PREFIX.bin (compact, varints)
+// and three CSV files.
+//
+// --generate writes a corpus of bot games to try it on.
+
+enum Cause {
+    CAUSE_BORDER,
+    CAUSE_TERRAIN,
+    CAUSE_SELF,
+    CAUSE_TRAPPED,
+    CAUSE_COUNT
+};
+
+static const char* const CAUSE_NAMES[CAUSE_COUNT] = {"border", "terrain", "self", "trapped"};
+
+// Game levels past this are counted as this one
+static const int MAX_GAME_LEVEL = 32;
+static const size_t BATCH_GAMES = 256;
+static const uint64_t GENERATE_MAX_TICKS = 5000;
+
+// Everything counted for one mode: level file plus game settings
+struct ModeStats {
+    int width;
+    int height;
+    uint64_t games;
+    uint64_t died;
+    uint64_t ticks;
+    uint64_t score;
+    uint64_t collisions[CAUSE_COUNT];
+    uint64_t levelGames[MAX_GAME_LEVEL];
+    uint64_t levelTicks[MAX_GAME_LEVEL];
+    LatencyHistogram length;
+    vector<uint64_t> visits;
+    vector<uint64_t> deaths;
+    vector<uint64_t> trapFood;
+
+    ModeStats() : width(0), height(0), games(0), died(0), ticks(0), score(0) {
+        memset(collisions, 0, sizeof(collisions));
+        memset(levelGames, 0, sizeof(levelGames));
+        memset(levelTicks, 0, sizeof(levelTicks));
+    }
+
+    void init(int w, int h) {
+        width = w;
+        height = h;
+        visits.assign(w * h, 0);
+        deaths.assign(w * h, 0);
+        trapFood.assign(w * h, 0);
+    }
+
+    void merge(const ModeStats& other) {
+        if (visits.empty()) init(other.width, other.height);
+        games += other.games;
+        died += other.died;
+        ticks += other.ticks;
+        score += other.score;
+        for (int i = 0; i < CAUSE_COUNT; ++i) collisions[i] += other.collisions[i];
+        for (int i = 0; i < MAX_GAME_LEVEL; ++i) {
+            levelGames[i] += other.levelGames[i];
+            levelTicks[i] += other.levelTicks[i];
+        }
+        length.merge(other.length);
+        for (size_t i = 0; i < visits.size(); ++i) {
+            visits[i] += other.visits[i];
+            deaths[i] += other.deaths[i];
+            trapFood[i] += other.trapFood[i];
+        }
+    }
+};
+
+// One per worker thread; nothing in it is shared until the final merge
+struct Accumulator {
+    map<string, ModeStats> modes;
+    uint64_t games;
+    uint64_t invalid;
+    uint64_t mismatched;
+
+    Accumulator() : games(0), invalid(0), mismatched(0) {}
+
+    void merge(const Accumulator& other) {
+        for (map<string, ModeStats>::const_iterator it = other.modes.begin(); it != other.modes.end(); ++it) {
+            modes[it->first].merge(it->second);
+        }
+        games += other.games;
+        invalid += other.invalid;
+        mismatched += other.mismatched;
+    }
+};
+
+// Up to BATCH_GAMES raw records; the buffers are kept between uses
+struct Batch {
+    vector<vector<uint8_t> > records;
+    size_t count;
+    Batch() : records(BATCH_GAMES), count(0) {}
+};
+
+// Full batches flow from the reader to the workers and empty ones back.
+// There are only a few batches, so the reader waits rather than reading
+// ahead of the workers.
+class BatchQueue {
+public:
+    explicit BatchQueue(int batches) : closed(false) {
+        for (int i = 0; i < batches; ++i) spare.push_back(new Batch());
+        all = spare;
+    }
+
+    ~BatchQueue() {
+        for (size_t i = 0; i < all.size(); ++i) delete all[i];
+    }
+
+    Batch* take() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return !spare.empty(); });
+        Batch* b = spare.back();
+        spare.pop_back();
+        b->count = 0;
+        return b;
+    }
+
+    void push(Batch* b) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            full.push_back(b);
+        }
+        changed.notify_all();
+    }
+
+    // NULL once the reader is done and everything has been handed out
+    Batch* pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return closed || !full.empty(); });
+        if (full.empty()) return NULL;
+        Batch* b = full.front();
+        full.pop_front();
+        return b;
+    }
+
+    void recycle(Batch* b) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            spare.push_back(b);
+        }
+        changed.notify_all();
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        changed.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    deque<Batch*> full;
+    vector<Batch*> spare;
+    vector<Batch*> all;
+    bool closed;
+
+    BatchQueue(const BatchQueue&);
+    BatchQueue& operator=(const BatchQueue&);
+};
+
+// Where the head goes if the snake moves dir, with the engine's wrap and
+// portal rules; true if that cell ends the move
+static bool blocked(const GameEngine& engine, const Position& dir, Position& at, bool& wall) {
+    const LevelMap& level = engine.getLevelMap();
+    int width = level.width();
+    int height = level.height();
+    Position p(engine.getSnake().head().x + dir.x, engine.getSnake().head().y + dir.y);
+    if (engine.isWrapMode()) {
+        if (p.x <= 0) p.x = width - 2;
+        else if (p.x >= width - 1) p.x = 1;
+        if (p.y <= 0) p.y = height - 2;
+        else if (p.y >= height - 1) p.y = 1;
+    }
+    uint32_t cell = static_cast<uint32_t>(p.y * width + p.x);
+    if (level.isPortal(cell)) {
+        cell = level.portalTarget(cell);
+        p = Position(cell % width, cell / width);
+    }
+    at = p;
+    wall = level.isWall(cell);
+    return wall || engine.getSnake().hitsSelf(p);
+}
+
+// The cause of the collision the next update will have, or -1
+static int collisionAhead(const GameEngine& engine) {
+    Position at;
+    bool wall;
+    if (!blocked(engine, engine.getSnake().getDirection(), at, wall)) return -1;
+    for (int d = 0; d < 4; ++d) {
+        Position other;
+        bool otherWall;
+        if (!blocked(engine, Position(LEVEL_DX[d], LEVEL_DY[d]), other, otherWall)) {
+            if (!wall) return CAUSE_SELF;
+            const LevelMap& level = engine.getLevelMap();
+            bool border = at.x == 0 || at.y == 0 || at.x == level.width() - 1 || at.y == level.height() - 1;
+            return border ? CAUSE_BORDER : CAUSE_TERRAIN;
+        }
+    }
+    return CAUSE_TRAPPED;
+}
+
+static string modeKey(const ReplayGame& game, const GameEngine& engine) {
+    ostringstream key;
+    key << (game.levelPath.empty() ? "standard" : game.levelPath) << (engine.isEasyMode() ? " easy" : " normal")
+        << (engine.isWrapMode() ? " wrap" : "") << " speed" << engine.getSpeedMode() << ((game.flags & REPLAY_AI) ? " ai" : "");
+    return key.str();
+}
+
+static int levelIndex(const GameEngine& engine) {
+    return std::min(engine.getLevel(), MAX_GAME_LEVEL) - 1;
+}
+
+// Replays one game and counts it into acc
+static void analyze(const ReplayGame& game, GameEngine& engine, LevelCache& levels, Accumulator& acc) {
+    const LevelMap* level = levels.get(game.levelPath);
+    if (!level || game.state.empty()) {
+        ++acc.invalid;
+        return;
+    }
+    if (&engine.getLevelMap() != level) engine.setLevel(level);
+    WireReader r(&game.state[0], game.state.size());
+    if (!engine.readState(r)) {
+        ++acc.invalid;
+        return;
+    }
+    engine.setPaused(false);
+
+    ModeStats& mode = acc.modes[modeKey(game, engine)];
+    if (mode.visits.empty()) mode.init(level->width(), level->height());
+    int width = level->width();
+    uint64_t start = engine.getTick();
+    int lastFood = -1;
+    int reached = levelIndex(engine);
+    size_t next = 0;
+    for (uint64_t t = 1; t <= game.ticks && !engine.isGameOver(); ++t) {
+        if (next < game.moves.size() && game.moves[next].tick == t) {
+            engine.setDirection(replayDirection(game.moves[next++].dir));
+        }
+        int cause = collisionAhead(engine);
+        const Position head = engine.getSnake().head();
+        int eaten = engine.getFoodsEaten();
+        ++mode.levelTicks[levelIndex(engine)];
+        engine.update();
+        if (cause >= 0) {
+            ++mode.collisions[cause];
+            ++mode.deaths[head.y * width + head.x];
+            if (cause == CAUSE_TRAPPED && lastFood >= 0) ++mode.trapFood[lastFood];
+            continue;
+        }
+        const Position& now = engine.getSnake().head();
+        ++mode.visits[now.y * width + now.x];
+        if (engine.getFoodsEaten() > eaten) lastFood = now.y * width + now.x;
+        reached = std::max(reached, levelIndex(engine));
+    }
+
+    uint64_t ticks = engine.getTick() - start;
+    bool died = (game.flags & REPLAY_DIED) != 0;
+    if (ticks != game.ticks || static_cast<uint32_t>(engine.getScore()) != game.score ||
+        died != engine.isGameOver()) {
+        ++acc.mismatched;
+    }
+    ++acc.games;
+    ++mode.games;
+    if (died) ++mode.died;
+    mode.ticks += ticks;
+    mode.score += game.score;
+    mode.length.record(ticks);
+    for (int i = 0; i <= reached; ++i) ++mode.levelGames[i];
+}
+
+static void work(BatchQueue& queue, Accumulator& acc) {
+    GameEngine engine;
+    LevelCache levels;
+    ReplayGame game;
+    while (Batch* batch = queue.pop()) {
+        for (size_t i = 0; i < batch->count; ++i) {
+            const vector<uint8_t>& record = batch->records[i];
+            if (game.decode(&record[0], record.size())) analyze(game, engine, levels, acc);
+            else ++acc.invalid;
+        }
+        queue.recycle(batch);
+    }
+}
+
+// Streams every record of one file into batches; returns false if the
+// file could not be read to the end
+static bool readFile(const string& path, BatchQueue& queue, Batch*& batch) {
+    ReplayReader reader;
+    if (!reader.open(path)) return false;
+    while (reader.next(batch->records[batch->count])) {
+        if (++batch->count == BATCH_GAMES) {
+            queue.push(batch);
+            batch = queue.take();
+        }
+    }
+    return !reader.isDamaged();
+}
+
+static bool endsWith(const string& s, const string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// A file, or every .rpl file directly inside a directory
+static void readPath(const string& path, BatchQueue& queue, Batch*& batch, uint64_t& files, uint64_t& damaged) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        cerr << "Cannot read " << path << "\n";
+        ++damaged;
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        ++files;
+        if (!readFile(path, queue, batch)) {
+            cerr << "Damaged or unreadable replay file " << path << "\n";
+            ++damaged;
+        }
+        return;
+    }
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        cerr << "Cannot read " << path << "\n";
+        ++damaged;
+        return;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        string name = entry->d_name;
+        if (endsWith(name, ".rpl")) readPath(path + "/" + name, queue, batch, files, damaged);
+    }
+    closedir(dir);
+}
+
+static void writeVarints(WireWriter& w, const vector<uint64_t>& values) {
+    for (size_t i = 0; i < values.size(); ++i) w.varint(values[i]);
+}
+
+// "SRST", version, then per mode its key, totals, causes, length
+// percentiles, per-level counts and the three heatmaps, all as varints
+static bool writeBinary(const string& path, const Accumulator& acc) {
+    vector<uint8_t> out;
+    WireWriter w(out);
+    w.u8('S');
+    w.u8('R');
+    w.u8('S');
+    w.u8('T');
+    w.u8(1);
+    w.varint(acc.games);
+    w.varint(acc.modes.size());
+    for (map<string, ModeStats>::const_iterator it = acc.modes.begin(); it != acc.modes.end(); ++it) {
+        const ModeStats& m = it->second;
+        w.varint(it->first.size());
+        for (size_t i = 0; i < it->first.size(); ++i) w.u8(static_cast<uint8_t>(it->first[i]));
+        w.varint(m.width);
+        w.varint(m.height);
+        w.varint(m.games);
+        w.varint(m.died);
+        w.varint(m.ticks);
+        w.varint(m.score);
+        for (int i = 0; i < CAUSE_COUNT; ++i) w.varint(m.collisions[i]);
+        w.varint(m.length.percentile(0.5));
+        w.varint(m.length.percentile(0.9));
+        w.varint(m.length.percentile(0.99));
+        w.varint(m.length.max());
+        w.varint(MAX_GAME_LEVEL);
+        for (int i = 0; i < MAX_GAME_LEVEL; ++i) {
+            w.varint(m.levelGames[i]);
+            w.varint(m.levelTicks[i]);
+        }
+        writeVarints(w, m.visits);
+        writeVarints(w, m.deaths);
+        writeVarints(w, m.trapFood);
+    }
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(&out[0], 1, out.size(), file) == out.size();
+    return fclose(file) == 0 && ok;
+}
+
+static bool writeCsv(const string& prefix, const Accumulator& acc) {
+    ofstream modes((prefix + "_modes.csv").c_str());
+    ofstream levels((prefix + "_levels.csv").c_str());
+    ofstream cells((prefix + "_cells.csv").c_str());
+    modes << "mode,games,died,mean_ticks,p50_ticks,p90_ticks,p99_ticks,max_ticks,mean_score";
+    for (int i = 0; i < CAUSE_COUNT; ++i) modes << "," << CAUSE_NAMES[i];
+    modes << "\n";
+    levels << "mode,level,games_reaching,mean_ticks\n";
+    cells << "mode,x,y,visits,deaths,trap_food\n";
+    for (map<string, ModeStats>::const_iterator it = acc.modes.begin(); it != acc.modes.end(); ++it) {
+        const string& key = it->first;
+        const ModeStats& m = it->second;
+        double games = m.games ? static_cast<double>(m.games) : 1;
+        modes << key << "," << m.games << "," << m.died << "," << m.ticks / games << ","
+              << m.length.percentile(0.5) << "," << m.length.percentile(0.9) << ","
+              << m.length.percentile(0.99) << "," << m.length.max() << "," << m.score / games;
+        for (int i = 0; i < CAUSE_COUNT; ++i) modes << "," << m.collisions[i];
+        modes << "\n";
+        for (int i = 0; i < MAX_GAME_LEVEL && m.levelGames[i]; ++i) {
+            levels << key << "," << i + 1 << "," << m.levelGames[i] << ","
+                   << static_cast<double>(m.levelTicks[i]) / m.levelGames[i] << "\n";
+        }
+        for (size_t c = 0; c < m.visits.size(); ++c) {
+            if (!m.visits[c] && !m.deaths[c] && !m.trapFood[c]) continue;
+            cells << key << "," << c % m.width << "," << c / m.width << "," << m.visits[c] << ","
+                  << m.deaths[c] << "," << m.trapFood[c] << "\n";
+        }
+    }
+    return modes && levels && cells;
+}
+
+// A simple bot: mostly toward the nearest item, sometimes at random,
+// never into a cell it can see is blocked if another is open
+static Position botMove(const GameEngine& engine, GameRng& rng) {
+    const ItemLayer& items = engine.getItems();
+    const Position& head = engine.getSnake().head();
+    int open[4];
+    int count = 0;
+    for (int d = 0; d < 4; ++d) {
+        Position at;
+        bool wall;
+        if (!blocked(engine, Position(LEVEL_DX[d], LEVEL_DY[d]), at, wall)) open[count++] = d;
+    }
+    if (count == 0) return engine.getSnake().getDirection();
+    int pick = open[rng.below(count)];
+    if (rng.below(8) != 0 && items.size() > 0) {
+        int best = 1 << 30;
+        for (int k = 0; k < count; ++k) {
+            Position p(head.x + LEVEL_DX[open[k]], head.y + LEVEL_DY[open[k]]);
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (items[i].type == ITEM_POISON) continue;
+                int distance = abs(items[i].pos.x - p.x) + abs(items[i].pos.y - p.y);
+                if (distance < best) {
+                    best = distance;
+                    pick = open[k];
+                }
+            }
+        }
+    }
+    return Position(LEVEL_DX[pick], LEVEL_DY[pick]);
+}
+
+static int generate(const string& path, uint64_t games, uint64_t seed, const string& levelPath) {
+    LevelMap level;
+    GameEngine engine(seed);
+    if (!levelPath.empty()) {
+        string error;
+        if (!level.load(levelPath, error)) {
+            cerr << error << "\n";
+            return 1;
+        }
+        engine.setLevel(&level);
+    }
+    ReplayRecorder recorder;
+    if (!recorder.open(path)) {
+        cerr << "Cannot open " << path << "\n";
+        return 1;
+    }
+    GameRng rng(seed ^ 0x9E3779B97F4A7C15ULL);
+    uint64_t ticks = 0;
+    uint64_t started = monotonicNanos();
+    for (uint64_t g = 0; g < games; ++g) {
+        uint64_t gameSeed = rng.next() | static_cast<uint64_t>(rng.next()) << 32;
+        engine.setModes(false, rng.below(4) == 0, 1 + rng.below(3));
+        engine.seed(gameSeed);
+        engine.reset();
+        recorder.begin(engine, levelPath, true, gameSeed);
+        for (uint64_t t = 0; t < GENERATE_MAX_TICKS && !engine.isGameOver(); ++t) {
+            engine.setDirection(botMove(engine, rng));
+            Position dir = engine.getSnake().getDirection();
+            engine.update();
+            recorder.record(engine, dir);
+        }
+        ticks += engine.getTick();
+        recorder.finish(engine.isGameOver());
+    }
+    double seconds = (monotonicNanos() - started) / 1e9;
+    cout << "Wrote " << games << " games (" << ticks << " ticks) to " << path << " in " << seconds << "s\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = static_cast<int>(thread::hardware_concurrency());
+    string prefix = "replay_stats";
+    string generatePath;
+    string levelPath;
+    uint64_t generateCount = 0;
+    uint64_t seed = 1;
+    vector<string> paths;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (arg == "--out" && i + 1 < argc) prefix = argv[++i];
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+        else if (arg == "--level" && i + 1 < argc) levelPath = argv[++i];
+        else if (arg == "--generate" && i + 2 < argc) {
+            generateCount = strtoull(argv[++i], NULL, 10);
+            generatePath = argv[++i];
+        } else if (arg.compare(0, 2, "--") != 0) {
+            paths.push_back(arg);
+        } else {
+            paths.clear();
+            generatePath.clear();
+            break;
+        }
+    }
+    if (!generatePath.empty()) return generate(generatePath, generateCount, seed, levelPath);
+    if (paths.empty()) {
+        cerr << "Usage: " << argv[0] << " [--threads N] [--out PREFIX] file.rpl|dir...\n"
+             << "       " << argv[0] << " --generate GAMES file.rpl [--seed N] [--level file.lvl]\n"
+             << "  Writes PREFIX.bin, PREFIX_modes.csv, PREFIX_levels.csv and PREFIX_cells.csv\n";
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+
+    uint64_t started = monotonicNanos();
+    BatchQueue queue(threads * 2 + 1);
+    vector<Accumulator> results(threads);
+    vector<thread> workers;
+    for (int i = 0; i < threads; ++i) workers.push_back(thread(work, std::ref(queue), std::ref(results[i])));
+    uint64_t files = 0;
+    uint64_t damaged = 0;
+    Batch* batch = queue.take();
+    for (size_t i = 0; i < paths.size(); ++i) readPath(paths[i], queue, batch, files, damaged);
+    queue.push(batch);
+    queue.close();
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+    for (size_t i = 1; i < results.size(); ++i) results[0].merge(results[i]);
+    const Accumulator& total = results[0];
+    double seconds = (monotonicNanos() - started) / 1e9;
+
+    if (!writeBinary(prefix + ".bin", total) || !writeCsv(prefix, total)) {
+        cerr << "Cannot write results to " << prefix << ".*\n";
+        return 1;
+    }
+    uint64_t ticks = 0;
+    for (map<string, ModeStats>::const_iterator it = total.modes.begin(); it != total.modes.end(); ++it) {
+        ticks += it->second.ticks;
+    }
+    cout << total.games << " games (" << ticks << " ticks) from " << files << " file(s) in " << seconds << "s on "
+         << threads << " thread(s), " << total.modes.size() << " mode(s)\n";
+    if (total.invalid) cout << total.invalid << " record(s) could not be replayed\n";
+    if (total.mismatched) cout << total.mismatched << " game(s) did not end as recorded\n";
+    if (damaged) cout << damaged << " file(s) damaged or unreadable\n";
+    return 0;
+}
@@ -0,0 +1,121 @@
+#ifndef REWIND_HISTORY_H
+#define REWIND_HISTORY_H
+
+#include <vector>
+#include <stdint.h>
+#include "game_engine.h"
+#include "wire_format.h"
+
+// Bounded history of one game for stepping it backwards. Every
+// KEYFRAME_INTERVAL ticks the engine's compact state is kept; in between
+// only the direction moved on each tick is stored, one byte per tick.
+// The engine is deterministic (seeded RNG, tick-keyed events), so any tick
+// in the window is rebuilt by restoring the keyframe at or before it and
+// replaying fewer than KEYFRAME_INTERVAL ticks.
+//
+// Keyframes and moves live in rings sized once from the capacity, and each
+// keyframe slot keeps its buffer from one use to the next, so recording a
+// tick allocates nothing once start() has sized the slots for the level.
+class RewindHistory {
+public:
+    static const uint64_t KEYFRAME_INTERVAL = 32;
+
+    explicit RewindHistory(uint64_t capacityTicks)
+        : capacity(capacityTicks), slots(capacityTicks / KEYFRAME_INTERVAL + 3),
+          moveRing(capacityTicks + 2 * KEYFRAME_INTERVAL + 1), firstKey(0), keyCount(0), firstMove(0),
+          moveCount(0), keyframeBytes(0) {}
+
+    // Starts a new history at the engine's current state
+    void start(const GameEngine& game) {
+        size_t bound = game.stateBytesBound();
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (slots[i].state.capacity() < bound) slots[i].state.reserve(bound);
+        }
+        keyCount = 0;
+        moveCount = 0;
+        keyframeBytes = 0;
+        addKeyframe(game);
+    }
+
+    // Call after each tick the engine advanced, with the direction the
+    // snake had going into that tick
+    void record(const GameEngine& game, const Position& dir) {
+        if (keyCount == 0) return;
+        if (moveCount == moveRing.size()) dropOldest();
+        moveRing[(firstMove + moveCount++) % moveRing.size()] =
+            static_cast<uint8_t>((dir.x + 1) | ((dir.y + 1) << 2));
+        uint64_t tick = game.getTick();
+        if (tick - key(keyCount - 1).tick >= KEYFRAME_INTERVAL) addKeyframe(game);
+        while (keyCount > 1 && tick - key(1).tick >= capacity) dropOldest();
+    }
+
+    uint64_t oldestTick() const { return keyCount == 0 ? 0 : key(0).tick; }
+    uint64_t ticksAvailable(const GameEngine& game) const {
+        return keyCount == 0 || capacity == 0 ? 0 : game.getTick() - oldestTick();
+    }
+    size_t memoryBytes() const { return keyframeBytes + moveCount; }
+
+    // Puts the game back up to ticks ticks and forgets everything after
+    // that point. Returns false when there is nothing older to go back to.
+    bool rewind(GameEngine& game, uint64_t ticks) {
+        if (ticksAvailable(game) == 0 || ticks == 0) return false;
+        uint64_t target = game.getTick() - (ticks < ticksAvailable(game) ? ticks : ticksAvailable(game));
+        while (keyCount > 1 && key(keyCount - 1).tick > target) {
+            keyframeBytes -= key(keyCount - 1).state.size();
+            --keyCount;
+        }
+        const Keyframe& last = key(keyCount - 1);
+        WireReader r(&last.state[0], last.state.size());
+        if (!game.readState(r)) return false;
+        game.setPaused(false);
+        uint64_t first = key(0).tick;
+        for (uint64_t t = last.tick + 1; t <= target; ++t) {
+            uint8_t m = moveRing[(firstMove + (t - first - 1)) % moveRing.size()];
+            game.setDirection(Position((m & 3) - 1, ((m >> 2) & 3) - 1));
+            game.update();
+        }
+        moveCount = target - first;
+        return true;
+    }
+
+private:
+    struct Keyframe {
+        uint64_t tick;
+        std::vector<uint8_t> state;
+    };
+
+    uint64_t capacity;
+    std::vector<Keyframe> slots;    // ring of keyframes, oldest at firstKey
+    std::vector<uint8_t> moveRing;  // ring of moves since the oldest keyframe
+    size_t firstKey;
+    size_t keyCount;
+    size_t firstMove;
+    size_t moveCount;
+    size_t keyframeBytes;
+
+    Keyframe& key(size_t i) { return slots[(firstKey + i) % slots.size()]; }
+    const Keyframe& key(size_t i) const { return slots[(firstKey + i) % slots.size()]; }
+
+    // Forgets the oldest keyframe and the moves up to the next one
+    void dropOldest() {
+        if (keyCount < 2) return;
+        size_t dropped = static_cast<size_t>(key(1).tick - key(0).tick);
+        firstMove = (firstMove + dropped) % moveRing.size();
+        moveCount -= dropped;
+        keyframeBytes -= key(0).state.size();
+        firstKey = (firstKey + 1) % slots.size();
+        --keyCount;
+    }
+
+    void addKeyframe(const GameEngine& game) {
+        if (keyCount == slots.size()) dropOldest();
+        Keyframe& k = key(keyCount++);
+        k.tick = game.getTick();
+        k.state.clear();
+        WireWriter w(k.state);
+        game.writeState(w);
+        keyframeBytes += k.state.size();
+    }
+};
+
+#endif
@@ -0,0 +1,624 @@
+#ifndef SCORE_ARCHIVE_H
+#define SCORE_ARCHIVE_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include "score_stats.h"
+
+// The full score history, for operations. scores.txt only ever holds the
+// leaderboard; the archive (score_history.txt by default) holds every
+// score imported, one "score timestamp" line each as in scores.txt, best
+// score first and, within a score, oldest first.
+//
+// Imports are an external merge sort: input lines are parsed into runs of
+// fixed-size records, each full run is sorted on a worker thread and
+// spilled to a temporary file while the next one is read, and finally the
+// archive and all runs are merged in one pass through a heap, into a new
+// file that replaces the archive. Memory is a few runs however much is
+// imported. Exports and statistics stream the archive, or any input, line
+// by line.
+//
+// Timestamps are to the minute, so equal lines can be different games, and
+// every line imported is kept. What keeps a file from going in twice is the
+// import log next to the archive (score_history.txt.imported): each file
+// imported is listed there with its size and content hash, and a file whose
+// size and hash are already listed, under any name, is skipped whole.
+// Input read from stdin cannot be checked and is always imported.
+//
+// Inputs are text ("score timestamp", as scores.txt) or CSV with the score
+// and the timestamp as the first two fields in either order; quotes are
+// stripped, and lines that do not parse (a CSV header, say) are counted
+// and skipped.
+
+const size_t ARCHIVE_STAMP_BYTES = 28;
+const size_t ARCHIVE_RUN_RECORDS = 1 << 20;
+
+struct ArchiveRecord {
+    int32_t score;
+    char stamp[ARCHIVE_STAMP_BYTES];  // NUL-padded
+};
+
+inline bool archiveBefore(const ArchiveRecord& a, const ArchiveRecord& b) {
+    if (a.score != b.score) return a.score > b.score;
+    return strncmp(a.stamp, b.stamp, ARCHIVE_STAMP_BYTES) < 0;
+}
+
+// Whole field as a non-negative score
+inline bool parseArchiveScore(const char* begin, const char* end, int32_t& score) {
+    if (begin == end || end - begin > 9) return false;
+    int32_t value = 0;
+    for (const char* p = begin; p < end; ++p) {
+        if (*p < '0' || *p > '9') return false;
+        value = value * 10 + (*p - '0');
+    }
+    score = value;
+    return true;
+}
+
+inline void trimField(const char*& begin, const char*& end) {
+    while (begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) --end;
+    if (end - begin >= 2 && *begin == '"' && end[-1] == '"') {
+        ++begin;
+        --end;
+    }
+}
+
+inline bool setArchiveStamp(const char* begin, const char* end, ArchiveRecord& out) {
+    trimField(begin, end);
+    size_t length = static_cast<size_t>(end - begin);
+    if (length == 0 || length >= ARCHIVE_STAMP_BYTES) return false;
+    memset(out.stamp, 0, sizeof(out.stamp));
+    memcpy(out.stamp, begin, length);
+    return true;
+}
+
+// One line without its newline
+inline bool parseArchiveLine(const char* begin, const char* end, ArchiveRecord& out) {
+    if (end > begin && end[-1] == '\r') --end;
+    const char* comma = begin;
+    while (comma < end && *comma != ',') ++comma;
+    if (comma == end) {
+        const char* space = begin;
+        while (space < end && *space != ' ') ++space;
+        return space < end && parseArchiveScore(begin, space, out.score) && setArchiveStamp(space + 1, end, out);
+    }
+    const char* second = comma + 1;
+    const char* secondEnd = second;
+    while (secondEnd < end && *secondEnd != ',') ++secondEnd;
+    const char* a = begin;
+    const char* aEnd = comma;
+    const char* b = second;
+    const char* bEnd = secondEnd;
+    trimField(a, aEnd);
+    trimField(b, bEnd);
+    if (parseArchiveScore(a, aEnd, out.score)) return setArchiveStamp(b, bEnd, out);
+    return parseArchiveScore(b, bEnd, out.score) && setArchiveStamp(a, aEnd, out);
+}
+
+// Lines out of a file ("-" is stdin) read in large blocks
+class LineReader {
+public:
+    LineReader() : file(NULL), ownsFile(false), start(0), filled(0), atEnd(false) {}
+
+    ~LineReader() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+        if (path == "-") {
+            file = stdin;
+        } else {
+            file = fopen(path.c_str(), "rb");
+            ownsFile = true;
+        }
+        buffer.resize(BLOCK);
+        start = filled = 0;
+        atEnd = false;
+        return file != NULL;
+    }
+
+    void close() {
+        if (file && ownsFile) fclose(file);
+        file = NULL;
+        ownsFile = false;
+    }
+
+    // The line stays valid until the next call
+    bool next(const char*& begin, const char*& end) {
+        while (true) {
+            char* from = &buffer[0] + start;
+            char* newline = static_cast<char*>(memchr(from, '\n', filled - start));
+            if (newline) {
+                begin = from;
+                end = newline;
+                start = newline - &buffer[0] + 1;
+                return true;
+            }
+            if (atEnd) {
+                if (start == filled) return false;
+                begin = from;
+                end = &buffer[0] + filled;
+                start = filled;
+                return true;
+            }
+            // Keep the partial line and refill behind it
+            size_t partial = filled - start;
+            memmove(&buffer[0], from, partial);
+            start = 0;
+            filled = partial;
+            if (filled == buffer.size()) buffer.resize(buffer.size() * 2);
+            size_t got = fread(&buffer[filled], 1, buffer.size() - filled, file);
+            filled += got;
+            if (got == 0) atEnd = true;
+        }
+    }
+
+    bool failed() const { return file && ferror(file); }
+
+private:
+    static const size_t BLOCK = 1 << 20;
+
+    FILE* file;
+    bool ownsFile;
+    std::vector<char> buffer;
+    size_t start;
+    size_t filled;
+    bool atEnd;
+
+    LineReader(const LineReader&);
+    LineReader& operator=(const LineReader&);
+};
+
+// Buffered text output in the archive's own format or as CSV
+class ArchiveWriter {
+public:
+    ArchiveWriter(FILE* file, bool csv) : file(file), csv(csv) { buffer.reserve(BLOCK + 64); }
+
+    ~ArchiveWriter() {
+        if (!buffer.empty()) flush();
+    }
+
+    void write(const ArchiveRecord& r) {
+        char line[64];
+        int n = snprintf(line, sizeof(line), csv ? "%d,\"%.*s\"\n" : "%d %.*s\n", r.score,
+                         static_cast<int>(ARCHIVE_STAMP_BYTES), r.stamp);
+        buffer.append(line, n);
+        if (buffer.size() >= BLOCK) flush();
+    }
+
+    bool flush() {
+        bool ok = buffer.empty() || fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        buffer.clear();
+        return ok && fflush(file) == 0;
+    }
+
+private:
+    static const size_t BLOCK = 1 << 16;
+
+    FILE* file;
+    bool csv;
+    std::string buffer;
+};
+
+// One sorted stream into the merge: a spilled run of raw records, or the
+// archive itself as text
+class MergeInput {
+public:
+    MergeInput() : run(NULL), lines(NULL), unsorted(false), at(0), held(0) {}
+
+    ~MergeInput() {
+        if (run) fclose(run);
+        delete lines;
+    }
+
+    bool openRun(const std::string& path) {
+        run = fopen(path.c_str(), "rb");
+        records.resize(BATCH);
+        return run != NULL;
+    }
+
+    bool openText(const std::string& path) {
+        lines = new LineReader();
+        return lines->open(path);
+    }
+
+    bool next(ArchiveRecord& out) {
+        if (lines) {
+            const char* begin;
+            const char* end;
+            while (lines->next(begin, end)) {
+                if (!parseArchiveLine(begin, end, out)) continue;
+                if (at > 0 && archiveBefore(out, last)) unsorted = true;
+                last = out;
+                at = 1;
+                return true;
+            }
+            return false;
+        }
+        if (at == held) {
+            held = fread(&records[0], sizeof(ArchiveRecord), BATCH, run);
+            at = 0;
+            if (held == 0) return false;
+        }
+        out = records[at++];
+        return true;
+    }
+
+    // The archive was edited by hand out of order; merging would be wrong
+    bool isUnsorted() const { return unsorted; }
+
+private:
+    static const size_t BATCH = 4096;
+
+    FILE* run;
+    LineReader* lines;
+    std::vector<ArchiveRecord> records;
+    ArchiveRecord last;
+    bool unsorted;
+    size_t at;
+    size_t held;
+
+    MergeInput(const MergeInput&);
+    MergeInput& operator=(const MergeInput&);
+};
+
+// One line of the import log: "size hash path", the hash as 16 hex digits
+struct ImportedFile {
+    uint64_t size;
+    uint64_t hash;
+    std::string path;
+};
+
+// Size and 64-bit FNV-1a hash of a whole file
+inline bool fingerprintFile(const std::string& path, ImportedFile& out) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    std::vector<unsigned char> block(1 << 16);
+    out.size = 0;
+    out.hash = 14695981039346656037ULL;
+    size_t got;
+    while ((got = fread(&block[0], 1, block.size(), file)) > 0) {
+        for (size_t i = 0; i < got; ++i) out.hash = (out.hash ^ block[i]) * 1099511628211ULL;
+        out.size += got;
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    out.path = path;
+    return ok;
+}
+
+struct ImportReport {
+    uint64_t imported;
+    uint64_t skipped;
+    uint64_t archived;  // in the archive afterwards
+    int runs;
+    std::vector<std::string> repeats;  // inputs not read, "path (as earlier path)"
+
+    ImportReport() : imported(0), skipped(0), archived(0), runs(0) {}
+};
+
+class ScoreImporter {
+public:
+    ScoreImporter(const std::string& archivePath, int threads, size_t runRecords = ARCHIVE_RUN_RECORDS)
+        : archivePath(archivePath), threads(threads < 1 ? 1 : threads),
+          runRecords(runRecords < 1024 ? 1024 : runRecords), joined(0) {}
+
+    ~ScoreImporter() {
+        joinAll();
+        removeRuns();
+    }
+
+    bool run(const std::vector<std::string>& paths, ImportReport& report, std::string& error) {
+        std::vector<ImportedFile> known;
+        if (!readLog(known, error)) return false;
+        size_t logged = known.size();
+        std::vector<ArchiveRecord>* current = newRun();
+        for (size_t i = 0; i < paths.size(); ++i) {
+            if (paths[i] != "-") {
+                ImportedFile file;
+                if (!fingerprintFile(paths[i], file)) {
+                    error = "cannot open " + paths[i];
+                    delete current;
+                    return false;
+                }
+                const ImportedFile* earlier = findImported(known, file);
+                if (earlier) {
+                    report.repeats.push_back(paths[i] + " (as " + earlier->path + ")");
+                    continue;
+                }
+                known.push_back(file);
+            }
+            LineReader reader;
+            if (!reader.open(paths[i])) {
+                error = "cannot open " + paths[i];
+                delete current;
+                return false;
+            }
+            const char* begin;
+            const char* end;
+            ArchiveRecord r;
+            while (reader.next(begin, end)) {
+                if (begin == end || (end - begin == 1 && *begin == '\r')) continue;
+                if (!parseArchiveLine(begin, end, r)) {
+                    ++report.skipped;
+                    continue;
+                }
+                current->push_back(r);
+                ++report.imported;
+                if (current->size() == runRecords) {
+                    spill(current);
+                    current = newRun();
+                }
+            }
+            if (reader.failed()) {
+                error = "cannot read " + paths[i];
+                delete current;
+                return false;
+            }
+        }
+        if (!current->empty()) {
+            spill(current);
+        } else {
+            delete current;
+        }
+        joinAll();
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            if (!jobs[i]->ok) {
+                error = "cannot write " + jobs[i]->path;
+                return false;
+            }
+        }
+        report.runs = static_cast<int>(jobs.size());
+        if (!merge(report, error)) return false;
+        if (!appendLog(known, logged)) {
+            error = "imported, but cannot add to " + logPath();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct SortJob {
+        std::vector<ArchiveRecord>* records;
+        std::string path;
+        bool ok;
+        std::thread worker;
+    };
+
+    std::string archivePath;
+    int threads;
+    size_t runRecords;
+    std::vector<SortJob*> jobs;
+    size_t joined;
+
+    std::string logPath() const { return archivePath + ".imported"; }
+
+    // A missing log is an archive nothing has been imported into yet
+    bool readLog(std::vector<ImportedFile>& known, std::string& error) const {
+        LineReader reader;
+        if (!reader.open(logPath())) return true;
+        const char* begin;
+        const char* end;
+        while (reader.next(begin, end)) {
+            std::string line(begin, end);
+            unsigned long long size;
+            unsigned long long hash;
+            int pathAt = 0;
+            if (line.empty()) continue;
+            if (sscanf(line.c_str(), "%llu %16llx %n", &size, &hash, &pathAt) != 2 || pathAt == 0) {
+                error = logPath() + " is damaged";
+                return false;
+            }
+            ImportedFile file;
+            file.size = size;
+            file.hash = hash;
+            file.path = line.substr(pathAt);
+            known.push_back(file);
+        }
+        return true;
+    }
+
+    static const ImportedFile* findImported(const std::vector<ImportedFile>& known, const ImportedFile& file) {
+        for (size_t i = 0; i < known.size(); ++i) {
+            if (known[i].size == file.size && known[i].hash == file.hash) return &known[i];
+        }
+        return NULL;
+    }
+
+    // Adds the files from known[from] on, once their scores are archived
+    bool appendLog(const std::vector<ImportedFile>& known, size_t from) const {
+        if (from == known.size()) return true;
+        FILE* file = fopen(logPath().c_str(), "a");
+        if (!file) return false;
+        for (size_t i = from; i < known.size(); ++i) {
+            fprintf(file, "%llu %016llx %s\n", static_cast<unsigned long long>(known[i].size),
+                    static_cast<unsigned long long>(known[i].hash), known[i].path.c_str());
+        }
+        return fclose(file) == 0;
+    }
+
+    std::vector<ArchiveRecord>* newRun() {
+        std::vector<ArchiveRecord>* records = new std::vector<ArchiveRecord>();
+        records->reserve(runRecords);
+        return records;
+    }
+
+    static void sortAndWrite(SortJob* job) {
+        std::sort(job->records->begin(), job->records->end(), archiveBefore);
+        FILE* file = fopen(job->path.c_str(), "wb");
+        job->ok = file && fwrite(&(*job->records)[0], sizeof(ArchiveRecord), job->records->size(), file) ==
+                              job->records->size();
+        if (file && fclose(file) != 0) job->ok = false;
+        delete job->records;
+        job->records = NULL;
+    }
+
+    // Hands a full run to a worker, waiting for the oldest one first when
+    // every thread is busy
+    void spill(std::vector<ArchiveRecord>* records) {
+        while (jobs.size() - joined >= static_cast<size_t>(threads)) jobs[joined++]->worker.join();
+        SortJob* job = new SortJob();
+        job->records = records;
+        job->path = archivePath + ".run" + std::to_string(jobs.size());
+        job->ok = false;
+        jobs.push_back(job);
+        job->worker = std::thread(&ScoreImporter::sortAndWrite, job);
+    }
+
+    void joinAll() {
+        while (joined < jobs.size()) jobs[joined++]->worker.join();
+    }
+
+    void removeRuns() {
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            remove(jobs[i]->path.c_str());
+            delete jobs[i];
+        }
+        jobs.clear();
+        joined = 0;
+    }
+
+    struct HeapEntry {
+        ArchiveRecord record;
+        size_t input;
+    };
+
+    struct HeapLater {
+        bool operator()(const HeapEntry& a, const HeapEntry& b) const {
+            return archiveBefore(b.record, a.record);
+        }
+    };
+
+    bool merge(ImportReport& report, std::string& error) {
+        std::vector<MergeInput*> inputs;
+        FILE* probe = fopen(archivePath.c_str(), "rb");
+        if (probe) {
+            fclose(probe);
+            inputs.push_back(new MergeInput());
+            if (!inputs.back()->openText(archivePath)) error = "cannot reopen " + archivePath;
+        }
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            inputs.push_back(new MergeInput());
+            if (!inputs.back()->openRun(jobs[i]->path)) error = "cannot reopen " + jobs[i]->path;
+        }
+        std::string tmp = archivePath + ".tmp";
+        FILE* out = error.empty() ? fopen(tmp.c_str(), "w") : NULL;
+        if (!out && error.empty()) error = "cannot write " + tmp;
+        if (out) {
+            ArchiveWriter writer(out, false);
+            std::priority_queue<HeapEntry, std::vector<HeapEntry>, HeapLater> heap;
+            HeapEntry e;
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                e.input = i;
+                if (inputs[i]->next(e.record)) heap.push(e);
+            }
+            while (!heap.empty()) {
+                e = heap.top();
+                heap.pop();
+                writer.write(e.record);
+                ++report.archived;
+                if (inputs[e.input]->next(e.record)) heap.push(e);
+            }
+            if (!writer.flush()) error = "cannot write " + tmp;
+            if (fclose(out) != 0 && error.empty()) error = "cannot write " + tmp;
+        }
+        if (error.empty() && probe && inputs[0]->isUnsorted()) {
+            error = archivePath + " is out of order; import it into a new archive first";
+        }
+        for (size_t i = 0; i < inputs.size(); ++i) delete inputs[i];
+        if (error.empty() && rename(tmp.c_str(), archivePath.c_str()) != 0) error = "cannot replace " + archivePath;
+        if (!error.empty()) remove(tmp.c_str());
+        return error.empty();
+    }
+
+    ScoreImporter(const ScoreImporter&);
+    ScoreImporter& operator=(const ScoreImporter&);
+};
+
+struct ExportRange {
+    int32_t minScore;
+    int32_t maxScore;
+    std::string since;  // timestamp prefixes, e.g. "2025-01" or "2025-03-14"
+    std::string until;  // inclusive
+    uint64_t limit;     // 0: no limit
+
+    ExportRange() : minScore(0), maxScore(INT32_MAX), limit(0) {}
+
+    bool matches(const ArchiveRecord& r) const {
+        if (r.score < minScore || r.score > maxScore) return false;
+        if (!since.empty() && strncmp(r.stamp, since.c_str(), ARCHIVE_STAMP_BYTES) < 0) return false;
+        return until.empty() || strncmp(r.stamp, until.c_str(), until.size()) <= 0;
+    }
+};
+
+// Streams the matching part of the archive; it is sorted by score, so a
+// score range stops reading as soon as it is passed
+inline bool exportScores(const std::string& archivePath, const ExportRange& range, bool csv, FILE* out,
+                         uint64_t& written, std::string& error) {
+    LineReader reader;
+    if (!reader.open(archivePath)) {
+        error = "cannot open " + archivePath;
+        return false;
+    }
+    ArchiveWriter writer(out, csv);
+    if (csv) fputs("score,timestamp\n", out);
+    written = 0;
+    const char* begin;
+    const char* end;
+    ArchiveRecord r;
+    while (reader.next(begin, end)) {
+        if (!parseArchiveLine(begin, end, r)) continue;
+        if (r.score < range.minScore) break;
+        if (!range.matches(r)) continue;
+        writer.write(r);
+        if (++written == range.limit) break;
+    }
+    return writer.flush();
+}
+
+struct ScoreSummary {
+    RunningStats moments;
+    TDigest digest;
+    DayHistogram days;
+    uint64_t skipped;
+
+    ScoreSummary() : skipped(0) {}
+
+    void add(const ArchiveRecord& r) {
+        moments.add(r.score);
+        digest.add(r.score);
+        days.add(r.stamp, r.score);
+    }
+};
+
+// One pass over each file, in any input format
+inline bool summarizeScores(const std::vector<std::string>& paths, ScoreSummary& summary, std::string& error) {
+    for (size_t i = 0; i < paths.size(); ++i) {
+        LineReader reader;
+        if (!reader.open(paths[i])) {
+            error = "cannot open " + paths[i];
+            return false;
+        }
+        const char* begin;
+        const char* end;
+        ArchiveRecord r;
+        while (reader.next(begin, end)) {
+            if (begin == end || (end - begin == 1 && *begin == '\r')) continue;
+            if (parseArchiveLine(begin, end, r)) {
+                summary.add(r);
+            } else {
+                ++summary.skipped;
+            }
+        }
+    }
+    return true;
+}
+
+#endif
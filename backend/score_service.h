@@ -0,0 +1,450 @@
+#ifndef SCORE_SERVICE_H
+#define SCORE_SERVICE_H
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <thread>
+#include <poll.h>
+#include "net_util.h"
+#include "score_verifier.h"
+
+// Local score service. One daemon owns scores.txt; games and menus talk to
+// it over a Unix socket instead of each rewriting the file. Requests are
+// single lines:
+//
+//   SUBMIT <score> <timestamp>   answered with OK (or NO, see below)
+//   REPLAY <hex> <timestamp>     a replay record of the game; answered with
+//                                OK, and the score is boarded once the game
+//                                has been played again and matches
+//   TOP                          answered with the board, then a "." line
+//   WATCH                        the board now and again after every change
+//
+// A daemon started with --verified answers SUBMIT with NO: only scores
+// that come with their game count, and only for the standard game (see
+// VerifyPolicy). Replays name their level; the daemon loads level files
+// only from its levels directory. The board is sent in the scores.txt
+// format, best score first, so clients parse it with the same code that
+// reads the file. When no daemon answers, callers fall back to the file
+// themselves.
+
+inline std::string scoreServiceAddress() {
+    const char* env = getenv("SNAKE_SCORE_SOCKET");
+    return env && *env ? env : "./scores.sock";
+}
+
+// Reads from fd until buffer holds a line equal to end or timeoutMs passes
+inline bool readUntilLine(int fd, std::string& buffer, const std::string& end, int timeoutMs) {
+    while (true) {
+        size_t pos = buffer.find("\n" + end + "\n");
+        if (buffer.compare(0, end.size() + 1, end + "\n") == 0 || pos != std::string::npos) return true;
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, timeoutMs) <= 0) return false;
+        char buf[4096];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) return false;
+        buffer.append(buf, n);
+    }
+}
+
+inline bool scoreServiceRequest(const std::string& request, const std::string& end, std::string& reply) {
+    int fd = connectTo(scoreServiceAddress());
+    if (fd < 0) return false;
+    bool ok = sendAll(fd, request.data(), request.size(), 1000) && readUntilLine(fd, reply, end, 1000);
+    close(fd);
+    return ok;
+}
+
+// Sends one request and reads its one-line answer. A REPLAY request can be
+// far bigger than the socket buffer, so it goes out in as many writes as
+// the daemon takes.
+inline bool scoreServiceAnswer(const std::string& request, std::string& answer) {
+    int fd = connectTo(scoreServiceAddress());
+    if (fd < 0) return false;
+    std::string buffer;
+    bool ok = sendAll(fd, request.data(), request.size(), 1000);
+    while (ok && buffer.find('\n') == std::string::npos) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        char buf[256];
+        ssize_t n;
+        ok = poll(&pfd, 1, 1000) > 0 && (n = read(fd, buf, sizeof(buf))) > 0;
+        if (ok) buffer.append(buf, n);
+    }
+    close(fd);
+    if (ok) answer = buffer.substr(0, buffer.find('\n'));
+    return ok;
+}
+
+// Returns false when no daemon is running; the caller then writes the file.
+// A daemon that refuses the score still owns the file, so that is true too.
+inline bool submitScoreToService(int score, const std::string& timestamp) {
+    std::ostringstream request;
+    request << "SUBMIT " << score << " " << timestamp << "\n";
+    std::string answer;
+    return scoreServiceAnswer(request.str(), answer);
+}
+
+// record as from ReplayRecorder::lastRecord()
+inline bool submitReplayToService(const std::vector<uint8_t>& record, const std::string& timestamp) {
+    static const char digits[] = "0123456789abcdef";
+    std::string request = "REPLAY ";
+    request.reserve(request.size() + record.size() * 2 + timestamp.size() + 2);
+    for (size_t i = 0; i < record.size(); ++i) {
+        request += digits[record[i] >> 4];
+        request += digits[record[i] & 15];
+    }
+    request += " " + timestamp + "\n";
+    std::string answer;
+    return scoreServiceAnswer(request, answer);
+}
+
+// Fills board with the leaderboard in scores.txt format
+inline bool fetchScoresFromService(std::string& board) {
+    std::string reply;
+    if (!scoreServiceRequest("TOP\n", ".", reply)) return false;
+    board = reply.substr(0, reply.size() - 2);
+    return true;
+}
+
+// A standing WATCH connection. Poll fd() for input and call readUpdate().
+class ScoreWatch {
+public:
+    ScoreWatch() : sock(-1) {}
+    ~ScoreWatch() {
+        if (sock >= 0) close(sock);
+    }
+
+    bool open() {
+        sock = connectTo(scoreServiceAddress());
+        if (sock < 0) return false;
+        if (!sendAll(sock, "WATCH\n", 6, 1000)) {
+            close(sock);
+            sock = -1;
+            return false;
+        }
+        setNonBlocking(sock);
+        return true;
+    }
+
+    int fd() const { return sock; }
+
+    // Returns true with the newest complete board once one has arrived. The
+    // watch closes (fd() goes to -1) when the daemon goes away or the
+    // connection fails, so a poll() loop never spins on a dead socket.
+    bool readUpdate(std::string& board) {
+        if (sock < 0) return false;
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(sock, buf, sizeof(buf))) > 0) pending.append(buf, n);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close(sock);
+            sock = -1;
+        }
+        bool found = false;
+        size_t end;
+        while ((end = boardEnd()) != std::string::npos) {
+            board = pending.substr(0, end);
+            pending.erase(0, end + 2);
+            found = true;
+        }
+        return found;
+    }
+
+private:
+    int sock;
+    std::string pending;
+
+    // Offset of the "." line closing the first board in pending
+    size_t boardEnd() const {
+        if (pending.compare(0, 2, ".\n") == 0) return 0;
+        size_t pos = pending.find("\n.\n");
+        return pos == std::string::npos ? pos : pos + 1;
+    }
+};
+
+// The daemon. Submissions update the in-memory board at once and are
+// answered straight away; the file is rewritten at most once per
+// FLUSH_MILLIS (and on shutdown), through a temporary file, fsync and
+// rename, so a crash leaves either the old board or the new one. Replays
+// are answered straight away too and handed to a VerifierPool; their
+// scores reach the board when the verdict comes back.
+class ScoreDaemon {
+public:
+    static const int FLUSH_MILLIS = 1000;
+    static const size_t MAX_ENTRIES = 10;
+    static const size_t MAX_PENDING_BYTES = 64 * 1024;
+    // A REPLAY line is twice its record
+    static const size_t MAX_REQUEST_BYTES = 1 << 20;
+
+    ScoreDaemon(const std::string& address, const std::string& file, bool verifiedOnly = false,
+                const std::string& levelDir = "levels",
+                int verifyThreads = static_cast<int>(std::thread::hardware_concurrency()))
+        : addr(address), path(file), listenFd(-1), dirty(false), batchStart(0),
+          submissions(0), flushes(0), verifiedOnly(verifiedOnly),
+          verifier(verifyThreads, daemonPolicy(verifiedOnly, levelDir)),
+          nextClaim(0), rejections(0) {}
+
+    ~ScoreDaemon() {
+        for (size_t i = 0; i < clients.size(); ++i) close(clients[i].fd);
+        if (listenFd >= 0) {
+            close(listenFd);
+            if (isUnixAddress(addr)) unlink(addr.c_str());
+        }
+    }
+
+    bool start() {
+        loadFile();
+        listenFd = listenOn(addr);
+        return listenFd >= 0;
+    }
+
+    // Serves until stop becomes non-zero, then writes any pending scores
+    void run(volatile sig_atomic_t& stop) {
+        while (!stop) {
+            std::vector<struct pollfd> fds(clients.size() + 2);
+            fds[0].fd = listenFd;
+            fds[0].events = POLLIN;
+            fds[1].fd = verifier.fd();
+            fds[1].events = POLLIN;
+            for (size_t i = 0; i < clients.size(); ++i) {
+                fds[i + 2].fd = clients[i].fd;
+                fds[i + 2].events = POLLIN | (clients[i].out.empty() ? 0 : POLLOUT);
+            }
+            int timeout = -1;
+            if (dirty) {
+                long wait = FLUSH_MILLIS - static_cast<long>(nowMillis() - batchStart);
+                timeout = wait > 0 ? static_cast<int>(wait) : 0;
+            }
+            poll(&fds[0], fds.size(), timeout);
+            if (fds[0].revents & POLLIN) acceptClients();
+            if (fds[1].revents & POLLIN) applyVerdicts();
+            for (size_t i = clients.size(); i-- > 0;) {
+                if (i + 2 < fds.size() && fds[i + 2].revents && !serve(clients[i])) {
+                    close(clients[i].fd);
+                    clients.erase(clients.begin() + i);
+                }
+            }
+            if (dirty && nowMillis() - batchStart >= static_cast<uint64_t>(FLUSH_MILLIS)) flush();
+        }
+        // Replays already received still count
+        ScoreVerdict v;
+        while (verifier.wait(v)) applyVerdict(v);
+        if (dirty) flush();
+    }
+
+    unsigned long submitted() const { return submissions; }
+    unsigned long fileWrites() const { return flushes; }
+    unsigned long rejected() const { return rejections; }
+
+private:
+    typedef std::pair<int, std::string> Entry;
+
+    struct Client {
+        int fd;
+        std::string in;
+        std::string out;
+        bool watching;
+    };
+
+    std::string addr;
+    std::string path;
+    int listenFd;
+    std::vector<Entry> board;
+    std::vector<Client> clients;
+    bool dirty;
+    uint64_t batchStart;
+    unsigned long submissions;
+    unsigned long flushes;
+    bool verifiedOnly;
+    VerifierPool verifier;
+    uint64_t nextClaim;
+    unsigned long rejections;
+
+    static uint64_t nowMillis() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    static bool better(const Entry& a, const Entry& b) { return a.first > b.first; }
+
+    static VerifyPolicy daemonPolicy(bool verifiedOnly, const std::string& levelDir) {
+        VerifyPolicy policy;
+        policy.standardOnly = verifiedOnly;
+        policy.levelDir = levelDir;
+        return policy;
+    }
+
+    void loadFile() {
+        board.clear();
+        std::ifstream file(path.c_str());
+        int score;
+        std::string timestamp;
+        while (file >> score) {
+            file.ignore();
+            getline(file, timestamp);
+            board.push_back(Entry(score, timestamp));
+        }
+        std::stable_sort(board.begin(), board.end(), better);
+        if (board.size() > MAX_ENTRIES) board.resize(MAX_ENTRIES);
+    }
+
+    std::string formatBoard() const {
+        std::ostringstream out;
+        for (size_t i = 0; i < board.size(); ++i) out << board[i].first << " " << board[i].second << "\n";
+        out << ".\n";
+        return out.str();
+    }
+
+    void flush() {
+        std::string tmp = path + ".tmp";
+        FILE* file = fopen(tmp.c_str(), "w");
+        if (!file) return;
+        std::string text = formatBoard();
+        fwrite(text.data(), 1, text.size() - 2, file);
+        fflush(file);
+        fsync(fileno(file));
+        fclose(file);
+        if (rename(tmp.c_str(), path.c_str()) == 0) {
+            dirty = false;
+            ++flushes;
+        }
+        batchStart = nowMillis();
+    }
+
+    void acceptClients() {
+        while (true) {
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd < 0) break;
+            setNonBlocking(fd);
+            Client c;
+            c.fd = fd;
+            c.watching = false;
+            clients.push_back(c);
+        }
+    }
+
+    void applyVerdict(const ScoreVerdict& v) {
+        if (v.code == VERIFY_OK) {
+            submit(v.score, v.timestamp);
+            return;
+        }
+        ++rejections;
+        fprintf(stderr, "Rejected score %d from %s: %s%s%s\n", v.score, v.timestamp.c_str(),
+                verifyCodeName(v.code), v.detail.empty() ? "" : ", ", v.detail.c_str());
+    }
+
+    void applyVerdicts() {
+        verifier.drain();
+        ScoreVerdict v;
+        while (verifier.next(v)) applyVerdict(v);
+    }
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    }
+
+    // "REPLAY <hex> <timestamp>"; false if the line is malformed
+    bool queueReplay(std::istringstream& request) {
+        std::string hex;
+        if (!(request >> hex) || hex.size() % 2 != 0) return false;
+        std::vector<uint8_t> record(hex.size() / 2);
+        for (size_t i = 0; i < record.size(); ++i) {
+            int hi = hexValue(hex[2 * i]);
+            int lo = hexValue(hex[2 * i + 1]);
+            if (hi < 0 || lo < 0) return false;
+            record[i] = static_cast<uint8_t>(hi << 4 | lo);
+        }
+        const uint8_t* body;
+        size_t length;
+        if (!replayRecordBody(record.empty() ? NULL : &record[0], record.size(), body, length)) return false;
+        ScoreClaim claim;
+        claim.id = nextClaim++;
+        claim.record.assign(body, body + length);
+        request.ignore();
+        getline(request, claim.timestamp);
+        verifier.submit(claim);
+        return true;
+    }
+
+    void submit(int score, const std::string& timestamp) {
+        ++submissions;
+        if (board.size() >= MAX_ENTRIES && score <= board.back().first) return;
+        board.push_back(Entry(score, timestamp));
+        std::stable_sort(board.begin(), board.end(), better);
+        if (board.size() > MAX_ENTRIES) board.resize(MAX_ENTRIES);
+        // The first change opens a batch; everything submitted before it
+        // closes goes out in one write
+        if (!dirty) {
+            dirty = true;
+            batchStart = nowMillis();
+        }
+        std::string update = formatBoard();
+        for (size_t i = 0; i < clients.size(); ++i) {
+            if (clients[i].watching) clients[i].out += update;
+        }
+    }
+
+    // Returns false when the client should be dropped
+    bool serve(Client& c) {
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(c.fd, buf, sizeof(buf))) > 0) c.in.append(buf, n);
+        if (n == 0) return false;
+        size_t eol;
+        while ((eol = c.in.find('\n')) != std::string::npos) {
+            std::string line = c.in.substr(0, eol);
+            c.in.erase(0, eol + 1);
+            std::istringstream request(line);
+            std::string verb;
+            request >> verb;
+            if (verb == "SUBMIT") {
+                int score;
+                std::string timestamp;
+                if (!(request >> score)) return false;
+                request.ignore();
+                getline(request, timestamp);
+                if (verifiedOnly) {
+                    ++rejections;
+                    c.out += "NO scores need a replay\n";
+                } else {
+                    submit(score, timestamp);
+                    c.out += "OK\n";
+                }
+            } else if (verb == "REPLAY") {
+                if (!queueReplay(request)) return false;
+                c.out += "OK\n";
+            } else if (verb == "TOP") {
+                c.out += formatBoard();
+            } else if (verb == "WATCH") {
+                c.watching = true;
+                c.out += formatBoard();
+            } else {
+                return false;
+            }
+        }
+        if (c.in.size() > MAX_REQUEST_BYTES) return false;
+        while (!c.out.empty()) {
+            ssize_t sent = sendSome(c.fd, c.out.data(), c.out.size());
+            if (sent < 0) return false;
+            if (sent == 0) break;
+            c.out.erase(0, sent);
+        }
+        return c.out.size() <= MAX_PENDING_BYTES;
+    }
+};
+
+#endif
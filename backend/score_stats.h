@@ -0,0 +1,216 @@
+#ifndef SCORE_STATS_H
+#define SCORE_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// One-pass statistics over any number of scores in fixed memory: mean and
+// standard deviation by Welford's update, percentiles from a t-digest, and
+// a few counters per day. Nothing here keeps the scores themselves.
+
+// Merging t-digest (Dunning & Ertl). Values are buffered, and each time the
+// buffer fills it is sorted and merged with the centroids in one sweep;
+// neighbours are combined while the merged centroid stays within one unit
+// of the k1 scale, k(q) = compression / 2pi * asin(2q - 1). The scale is
+// steep near 0 and 1, so the tails stay in small centroids and p99 or
+// p99.9 come out far more exactly than the median needs to. At most about
+// compression * pi / 2 centroids survive a merge, however many values
+// went in.
+class TDigest {
+public:
+    explicit TDigest(double compression = 200)
+        : compression(compression), total(0), lowest(0), highest(0) {
+        bufferLimit = static_cast<size_t>(compression * 5);
+        buffer.reserve(bufferLimit);
+    }
+
+    void add(double x) {
+        if (total == 0 && buffer.empty()) {
+            lowest = highest = x;
+        } else {
+            lowest = std::min(lowest, x);
+            highest = std::max(highest, x);
+        }
+        buffer.push_back(x);
+        if (buffer.size() >= bufferLimit) merge();
+    }
+
+    uint64_t count() {
+        merge();
+        return static_cast<uint64_t>(total);
+    }
+
+    size_t centroidCount() {
+        merge();
+        return centroids.size();
+    }
+
+    // Interpolates between centroid centres; the ends run out to the
+    // smallest and largest value seen
+    double quantile(double q) {
+        merge();
+        if (centroids.empty()) return 0;
+        if (centroids.size() == 1 || q <= 0) return q <= 0 ? lowest : centroids[0].mean;
+        if (q >= 1) return highest;
+        double index = q * total;
+        const Centroid& first = centroids[0];
+        if (index < first.weight / 2) {
+            return lowest + (first.mean - lowest) * index / (first.weight / 2);
+        }
+        double soFar = first.weight / 2;
+        for (size_t i = 0; i + 1 < centroids.size(); ++i) {
+            double step = (centroids[i].weight + centroids[i + 1].weight) / 2;
+            if (soFar + step > index) {
+                return centroids[i].mean + (centroids[i + 1].mean - centroids[i].mean) * (index - soFar) / step;
+            }
+            soFar += step;
+        }
+        const Centroid& last = centroids.back();
+        double rest = std::min(1.0, (index - soFar) / (last.weight / 2));
+        return last.mean + (highest - last.mean) * rest;
+    }
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    double compression;
+    double total;
+    double lowest;
+    double highest;
+    size_t bufferLimit;
+    std::vector<double> buffer;
+    std::vector<Centroid> centroids;
+    std::vector<Centroid> merged;
+
+    double scale(double q) const { return compression / (2 * M_PI) * asin(2 * q - 1); }
+
+    void merge() {
+        if (buffer.empty()) return;
+        std::sort(buffer.begin(), buffer.end());
+        double newTotal = total + buffer.size();
+        merged.clear();
+        size_t c = 0, b = 0;
+        Centroid current = takeSmallest(c, b);
+        double soFar = 0;
+        double kLow = scale(0);
+        while (c < centroids.size() || b < buffer.size()) {
+            Centroid next = takeSmallest(c, b);
+            double proposed = current.weight + next.weight;
+            if (scale((soFar + proposed) / newTotal) - kLow <= 1) {
+                current.mean += (next.mean - current.mean) * next.weight / proposed;
+                current.weight = proposed;
+            } else {
+                soFar += current.weight;
+                kLow = scale(soFar / newTotal);
+                merged.push_back(current);
+                current = next;
+            }
+        }
+        merged.push_back(current);
+        centroids.swap(merged);
+        total = newTotal;
+        buffer.clear();
+    }
+
+    // Next by mean of the two sorted inputs
+    Centroid takeSmallest(size_t& c, size_t& b) const {
+        if (b >= buffer.size() || (c < centroids.size() && centroids[c].mean <= buffer[b])) return centroids[c++];
+        Centroid single = {buffer[b++], 1};
+        return single;
+    }
+};
+
+class RunningStats {
+public:
+    RunningStats() : n(0), mu(0), m2(0), lowest(0), highest(0) {}
+
+    void add(double x) {
+        ++n;
+        if (n == 1) lowest = highest = x;
+        lowest = std::min(lowest, x);
+        highest = std::max(highest, x);
+        double delta = x - mu;
+        mu += delta / n;
+        m2 += delta * (x - mu);
+    }
+
+    uint64_t count() const { return n; }
+    double mean() const { return mu; }
+    double stddev() const { return n > 1 ? sqrt(m2 / (n - 1)) : 0; }
+    double min() const { return lowest; }
+    double max() const { return highest; }
+
+private:
+    uint64_t n;
+    double mu;
+    double m2;
+    double lowest;
+    double highest;
+};
+
+// Games per day by score band; grows with the number of days, not scores
+class DayHistogram {
+public:
+    static const int BANDS = 6;
+
+    void add(const char* stamp, int score) {
+        // Timestamps start with YYYY-MM-DD; anything else is one "unknown" day
+        std::string day(stamp, strnlen(stamp, 10));
+        if (day.size() != 10 || day[4] != '-' || day[7] != '-') day = "unknown";
+        Day& d = days[day];
+        ++d.games;
+        d.points += score;
+        d.best = std::max(d.best, score);
+        ++d.bands[band(score)];
+    }
+
+    size_t dayCount() const { return days.size(); }
+
+    void print(FILE* out) const {
+        fprintf(out, "%-10s %9s %8s %6s", "day", "games", "mean", "best");
+        for (int b = 0; b < BANDS; ++b) fprintf(out, " %9s", bandName(b));
+        fprintf(out, "\n");
+        for (std::map<std::string, Day>::const_iterator it = days.begin(); it != days.end(); ++it) {
+            const Day& d = it->second;
+            fprintf(out, "%-10s %9llu %8.1f %6d", it->first.c_str(), static_cast<unsigned long long>(d.games),
+                    static_cast<double>(d.points) / d.games, d.best);
+            for (int b = 0; b < BANDS; ++b) fprintf(out, " %9llu", static_cast<unsigned long long>(d.bands[b]));
+            fprintf(out, "\n");
+        }
+    }
+
+private:
+    struct Day {
+        uint64_t games;
+        uint64_t points;
+        int best;
+        uint64_t bands[BANDS];
+
+        Day() : games(0), points(0), best(0) { std::fill(bands, bands + BANDS, 0); }
+    };
+
+    std::map<std::string, Day> days;
+
+    static int band(int score) {
+        static const int floors[BANDS] = {0, 50, 100, 200, 500, 1000};
+        int b = BANDS - 1;
+        while (b > 0 && score < floors[b]) --b;
+        return b;
+    }
+
+    static const char* bandName(int b) {
+        static const char* const names[BANDS] = {"0-49", "50-99", "100-199", "200-499", "500-999", "1000+"};
+        return names[b];
+    }
+};
+
+#endif
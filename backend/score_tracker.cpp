@@ -5,6 +5,9 @@
 #include <iomanip>
 #include <sstream>
 #include <ctime>
+#include "score_archive.h"
+#include "score_service.h"
+#include "tick_profiler.h"
 
 using namespace std;
 
@@ -42,19 +45,37 @@ public:
         loadScores();
     }
     
+    // Asks the score daemon first and reads the file only if none is running
     void loadScores() {
-        scores.clear();
+        string board;
+        if (fetchScoresFromService(board)) {
+            istringstream in(board);
+            readScores(in);
+            return;
+        }
         ifstream file(scoreFile);
         if (file.is_open()) {
-            int score;
-            string timestamp;
-            while (file >> score) {
-                file.ignore(); // Skip space
-                getline(file, timestamp);
-                scores.push_back(ScoreEntry(score, timestamp));
-            }
+            readScores(file);
             file.close();
-            sort(scores.begin(), scores.end(), greater<ScoreEntry>());
+        } else {
+            scores.clear();
+        }
+    }
+    
+    // Reads "score timestamp" lines, as stored in the file and sent by the
+    // daemon. Only the top 10 are kept, inserted in order as they come, so
+    // a long file costs neither memory nor a sort.
+    void readScores(istream& in) {
+        scores.clear();
+        int score;
+        string timestamp;
+        while (in >> score) {
+            in.ignore(); // Skip space
+            getline(in, timestamp);
+            if (scores.size() == 10 && score <= scores.back().score) continue;
+            ScoreEntry entry(score, timestamp);
+            scores.insert(upper_bound(scores.begin(), scores.end(), entry, greater<ScoreEntry>()), entry);
+            if (scores.size() > 10) scores.pop_back();
         }
     }
     
@@ -67,8 +88,11 @@ public:
         if (scores.size() > 10) {
             scores.resize(10);
         }
+        if (submitScoreToService(score, timestamp)) {
+            return;
+        }
         
-        // Save to file
+        // No daemon: write the file ourselves
         ofstream file(scoreFile);
         if (file.is_open()) {
             for (const auto& entry : scores) {
@@ -115,28 +139,207 @@ public:
     }
 };
 
-// Example usage and testing
-int main() {
-    ScoreTracker tracker;
-    
-    cout << "Score Tracker Test\n";
-    cout << "==================\n\n";
-    
-    // Display current leaderboard
-    tracker.displayLeaderboard();
-    
-    // Test adding scores
-    cout << "\nAdding test scores...\n";
-    tracker.saveScore(150);
-    tracker.saveScore(80);
-    tracker.saveScore(200);
-    tracker.saveScore(120);
+static volatile sig_atomic_t stopDaemon = 0;
+
+static void onStopSignal(int) {
+    stopDaemon = 1;
+}
+
+// Owns scores.txt and serves it to games and menus until SIGINT or SIGTERM
+int runDaemon(const string& address, bool verifiedOnly, const string& levelDir) {
+    ScoreDaemon daemon(address, "scores.txt", verifiedOnly, levelDir);
+    if (!daemon.start()) {
+        cerr << "Cannot listen on " << address << "\n";
+        return 1;
+    }
+    signal(SIGINT, onStopSignal);
+    signal(SIGTERM, onStopSignal);
+    signal(SIGPIPE, SIG_IGN);
+    cout << "Score daemon listening on " << address << "\n";
+    daemon.run(stopDaemon);
+    cout << daemon.submitted() << " scores received, " << daemon.rejected() << " rejected, "
+         << daemon.fileWrites() << " file writes\n";
+    return 0;
+}
+
+// Checks every game in the given replay files on all cores and reports how
+// many reproduce their score. Reading stays at most a few claims per
+// thread ahead of the workers.
+int runVerify(const vector<string>& paths, int threads, const VerifyPolicy& policy) {
+    VerifierPool pool(threads, policy);
+    unsigned long counts[VERIFY_CODE_COUNT] = {0};
+    unsigned long games = 0;
+    unsigned long long points = 0;
+    size_t window = static_cast<size_t>(pool.threadCount()) * 64;
+    uint64_t started = monotonicNanos();
+    ScoreClaim claim;
+    ScoreVerdict v;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        ReplayReader reader;
+        if (!reader.open(paths[i])) {
+            cerr << "Cannot open " << paths[i] << "\n";
+            continue;
+        }
+        while (reader.next(claim.record)) {
+            claim.id = games++;
+            pool.submit(claim);
+            while (pool.pending() > window && pool.wait(v)) {
+                ++counts[v.code];
+                if (v.code == VERIFY_OK) points += v.score;
+            }
+        }
+        if (reader.isDamaged()) cerr << paths[i] << " is damaged; stopped at game " << games << "\n";
+    }
+    while (pool.wait(v)) {
+        ++counts[v.code];
+        if (v.code == VERIFY_OK) points += v.score;
+    }
+    double seconds = (monotonicNanos() - started) / 1e9;
+    cout << games << " games checked in " << seconds << "s on " << pool.threadCount() << " thread(s)\n";
+    for (int code = 0; code < VERIFY_CODE_COUNT; ++code) {
+        if (counts[code]) cout << "  " << setw(8) << counts[code] << "  " << verifyCodeName(code) << "\n";
+    }
+    cout << "  " << points << " points verified\n";
+    return counts[VERIFY_OK] == games ? 0 : 2;
+}
+
+// Merges text or CSV score files into the archive (see score_archive.h)
+int runImport(const string& archive, const vector<string>& paths, int threads) {
+    uint64_t started = monotonicNanos();
+    ScoreImporter importer(archive, threads);
+    ImportReport report;
+    string error;
+    if (!importer.run(paths, report, error)) {
+        cerr << error << "\n";
+        return 1;
+    }
+    double seconds = (monotonicNanos() - started) / 1e9;
+    for (size_t i = 0; i < report.repeats.size(); ++i) cout << "already imported: " << report.repeats[i] << "\n";
+    cout << report.imported << " scores imported (" << report.skipped << " lines skipped) in " << report.runs
+         << " run(s), " << seconds << "s; " << archive << " now holds " << report.archived << "\n";
+    return 0;
+}
+
+int runExport(const string& archive, const ExportRange& range, bool csv) {
+    uint64_t written = 0;
+    string error;
+    if (!exportScores(archive, range, csv, stdout, written, error)) {
+        cerr << (error.empty() ? "cannot write output" : error) << "\n";
+        return 1;
+    }
+    cerr << written << " scores exported\n";
+    return 0;
+}
+
+int runStats(const vector<string>& paths, bool perDay) {
+    ScoreSummary summary;
+    string error;
+    if (!summarizeScores(paths, summary, error)) {
+        cerr << error << "\n";
+        return 1;
+    }
+    const RunningStats& m = summary.moments;
+    printf("%llu scores (%llu lines skipped)\n", static_cast<unsigned long long>(m.count()),
+           static_cast<unsigned long long>(summary.skipped));
+    if (m.count() == 0) return 0;
+    printf("mean %.2f  stddev %.2f  min %.0f  max %.0f\n", m.mean(), m.stddev(), m.min(), m.max());
+    static const double quantiles[] = {0.5, 0.75, 0.9, 0.99, 0.999};
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); ++i) {
+        printf("%sp%g %.1f", i ? "  " : "", quantiles[i] * 100, summary.digest.quantile(quantiles[i]));
+    }
+    printf("  (t-digest, %zu centroids)\n", summary.digest.centroidCount());
+    if (perDay) {
+        printf("\n");
+        summary.days.print(stdout);
+    }
+    return 0;
+}
+
+static void usage(const char* program) {
+    cerr << "Usage: " << program << "                     show the leaderboard\n"
+         << "       " << program << " --add SCORE\n"
+         << "       " << program << " --daemon [--verified] [--levels DIR] [ADDR]\n"
+         << "       " << program << " --verify [--threads N] [--standard] [--levels DIR] file.rpl...\n"
+         << "       " << program << " --import [--archive FILE] [--threads N] file.txt|file.csv|-...\n"
+         << "       " << program << " --export [--archive FILE] [--min N] [--max N] [--since DATE] [--until DATE]\n"
+         << "                      [--limit N] [--csv]\n"
+         << "       " << program << " --stats [--days] [--archive FILE | file...]\n"
+         << "  The archive (default score_history.txt) keeps every score; scores.txt only the top 10\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && string(argv[1]) == "--daemon") {
+        string address = scoreServiceAddress();
+        bool verifiedOnly = false;
+        string levelDir = "levels";
+        for (int i = 2; i < argc; ++i) {
+            if (string(argv[i]) == "--verified") verifiedOnly = true;
+            else if (string(argv[i]) == "--levels" && i + 1 < argc) levelDir = argv[++i];
+            else address = argv[i];
+        }
+        return runDaemon(address, verifiedOnly, levelDir);
+    }
+    if (argc >= 2 && string(argv[1]) == "--verify") {
+        int threads = static_cast<int>(thread::hardware_concurrency());
+        VerifyPolicy policy;
+        vector<string> paths;
+        for (int i = 2; i < argc; ++i) {
+            if (string(argv[i]) == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+            else if (string(argv[i]) == "--standard") policy.standardOnly = true;
+            else if (string(argv[i]) == "--levels" && i + 1 < argc) policy.levelDir = argv[++i];
+            else paths.push_back(argv[i]);
+        }
+        if (paths.empty()) {
+            usage(argv[0]);
+            return 1;
+        }
+        return runVerify(paths, threads, policy);
+    }
+    string command = argc >= 2 ? argv[1] : "";
+    if (command == "--import" || command == "--export" || command == "--stats") {
+        string archive = "score_history.txt";
+        int threads = static_cast<int>(thread::hardware_concurrency());
+        ExportRange range;
+        bool csv = false;
+        bool perDay = false;
+        vector<string> paths;
+        for (int i = 2; i < argc; ++i) {
+            string arg = argv[i];
+            if (arg == "--archive" && i + 1 < argc) archive = argv[++i];
+            else if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+            else if (arg == "--min" && i + 1 < argc) range.minScore = atoi(argv[++i]);
+            else if (arg == "--max" && i + 1 < argc) range.maxScore = atoi(argv[++i]);
+            else if (arg == "--since" && i + 1 < argc) range.since = argv[++i];
+            else if (arg == "--until" && i + 1 < argc) range.until = argv[++i];
+            else if (arg == "--limit" && i + 1 < argc) range.limit = strtoull(argv[++i], NULL, 10);
+            else if (arg == "--csv") csv = true;
+            else if (arg == "--days") perDay = true;
+            else if (arg == "-" || arg.compare(0, 2, "--") != 0) paths.push_back(arg);
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        if (command == "--import") {
+            if (paths.empty()) {
+                usage(argv[0]);
+                return 1;
+            }
+            return runImport(archive, paths, threads);
+        }
+        if (command == "--export") return runExport(archive, range, csv);
+        if (paths.empty()) paths.push_back(archive);
+        return runStats(paths, perDay);
+    }
     
-    cout << "\nUpdated Leaderboard:\n";
+    ScoreTracker tracker;
+    if (command == "--add" && argc == 3) {
+        tracker.saveScore(atoi(argv[2]));
+    } else if (!command.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
     tracker.displayLeaderboard();
-    
-    cout << "\nHigh Score: " << tracker.getHighScore() << "\n";
-    
     return 0;
 }
 
@@ -0,0 +1,257 @@
+#ifndef SCORE_VERIFIER_H
+#define SCORE_VERIFIER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include "game_engine.h"
+#include "replay_log.h"
+
+// Checks claimed scores by playing the claimed game again. A claim is a
+// replay record (see replay_log.h); the game is rebuilt from its seed, its
+// settings and its level, and the recorded directions are fed back in. The
+// score counts only if that game ends on the recorded tick with the
+// recorded score. Nothing from the recorded starting state is trusted
+// beyond the settings, so a record cannot start a game from a better place.
+//
+// The engine runs as fast as it can, with no tick timing, so a game of a
+// few minutes is checked in well under a millisecond.
+
+enum VerifyCode {
+    VERIFY_OK,
+    VERIFY_BAD_RECORD,
+    VERIFY_UNFINISHED,
+    VERIFY_NO_SEED,
+    VERIFY_AI,
+    VERIFY_NO_LEVEL,
+    VERIFY_DIVERGED,
+    VERIFY_OLD_RECORD,
+    VERIFY_NOT_STANDARD,
+    VERIFY_CODE_COUNT
+};
+
+inline const char* verifyCodeName(int code) {
+    static const char* const names[VERIFY_CODE_COUNT] = {
+        "verified", "damaged record", "game did not end", "no seed (loaded game)",
+        "played by the autopilot", "level not found", "replay does not match",
+        "recorded by an older game", "not the standard game"};
+    return code >= 0 && code < VERIFY_CODE_COUNT ? names[code] : "unknown";
+}
+
+// Longer claims are refused rather than tying up a worker
+const uint64_t VERIFY_MAX_TICKS = 20000000;
+// Foods on the board in the standard game, as GameEngine starts
+const int VERIFY_STANDARD_FOODS = 1;
+
+// What a verifier takes. One leaderboard only compares like with like, so
+// a board that counts only verified scores takes only the standard game:
+// the standard board, one food and no easy mode. Wrap and speed stay free;
+// neither makes a score easier to get.
+struct VerifyPolicy {
+    bool standardOnly;
+    std::string levelDir;  // level files load only from here; "" for anywhere
+
+    VerifyPolicy() : standardOnly(false) {}
+};
+
+// engine and settings are scratch engines owned by the caller
+inline int verifyReplay(const ReplayGame& game, GameEngine& engine, GameEngine& settings, LevelCache& levels,
+                        const VerifyPolicy& policy, std::string& detail) {
+    if (game.version < REPLAY_VERSION) return VERIFY_OLD_RECORD;
+    if (!(game.flags & REPLAY_DIED)) return VERIFY_UNFINISHED;
+    if (game.seed == 0) return VERIFY_NO_SEED;
+    if (game.flags & REPLAY_AI) return VERIFY_AI;
+    if (policy.standardOnly && !game.levelPath.empty()) return VERIFY_NOT_STANDARD;
+    const LevelMap* level = levels.get(game.levelPath);
+    if (!level) return VERIFY_NO_LEVEL;
+    if (game.state.empty() || game.ticks > VERIFY_MAX_TICKS) return VERIFY_BAD_RECORD;
+    if (&settings.getLevelMap() != level) settings.setLevel(level);
+    WireReader r(&game.state[0], game.state.size());
+    if (!settings.readState(r)) return VERIFY_BAD_RECORD;
+    if (policy.standardOnly && (settings.getFoodCount() != VERIFY_STANDARD_FOODS || settings.isEasyMode())) {
+        return VERIFY_NOT_STANDARD;
+    }
+
+    if (&engine.getLevelMap() != level) engine.setLevel(level);
+    engine.setModes(settings.isEasyMode(), settings.isWrapMode(), settings.getSpeedMode());
+    engine.setFoodCount(settings.getFoodCount());
+    engine.seed(game.seed);
+    engine.reset();
+    size_t next = 0;
+    for (uint64_t t = 1; t <= game.ticks; ++t) {
+        if (engine.isGameOver()) {
+            std::ostringstream out;
+            out << "ended at tick " << t - 1 << " of " << game.ticks;
+            detail = out.str();
+            return VERIFY_DIVERGED;
+        }
+        if (next < game.moves.size() && game.moves[next].tick == t) {
+            engine.setDirection(replayDirection(game.moves[next++].dir));
+        }
+        engine.update();
+    }
+    if (!engine.isGameOver() || static_cast<uint32_t>(engine.getScore()) != game.score) {
+        std::ostringstream out;
+        out << (engine.isGameOver() ? "scored " : "still alive with ") << engine.getScore() << ", claimed "
+            << game.score;
+        detail = out.str();
+        return VERIFY_DIVERGED;
+    }
+    return VERIFY_OK;
+}
+
+struct ScoreClaim {
+    uint64_t id;
+    std::vector<uint8_t> record;  // body only, as ReplayReader returns it
+    std::string timestamp;
+};
+
+struct ScoreVerdict {
+    uint64_t id;
+    int code;
+    int score;
+    std::string timestamp;
+    std::string detail;
+};
+
+// Worker threads that verify claims as they are submitted. Verdicts wait
+// in a queue: a poll() loop watches fd() and calls drain() then next(); a
+// plain caller blocks in wait().
+class VerifierPool {
+public:
+    explicit VerifierPool(int threads, const VerifyPolicy& policy = VerifyPolicy())
+        : policy(policy), stopping(false), inFlight(0) {
+        wakeFds[0] = wakeFds[1] = -1;
+        if (pipe(wakeFds) == 0) {
+            fcntl(wakeFds[0], F_SETFL, fcntl(wakeFds[0], F_GETFL) | O_NONBLOCK);
+            fcntl(wakeFds[1], F_SETFL, fcntl(wakeFds[1], F_GETFL) | O_NONBLOCK);
+        }
+        if (threads < 1) threads = 1;
+        for (int i = 0; i < threads; ++i) workers.push_back(std::thread(&VerifierPool::loop, this));
+    }
+
+    ~VerifierPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+        if (wakeFds[0] >= 0) close(wakeFds[0]);
+        if (wakeFds[1] >= 0) close(wakeFds[1]);
+    }
+
+    int threadCount() const { return static_cast<int>(workers.size()); }
+
+    // Takes the claim's buffers
+    void submit(ScoreClaim& claim) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            claims.push_back(ScoreClaim());
+            ScoreClaim& queued = claims.back();
+            queued.id = claim.id;
+            queued.record.swap(claim.record);
+            queued.timestamp.swap(claim.timestamp);
+            ++inFlight;
+        }
+        work.notify_one();
+    }
+
+    // Claims submitted whose verdict has not been taken yet
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return inFlight;
+    }
+
+    int fd() const { return wakeFds[0]; }
+
+    void drain() {
+        char buf[256];
+        while (read(wakeFds[0], buf, sizeof(buf)) > 0) {
+        }
+    }
+
+    bool next(ScoreVerdict& v) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return take(v);
+    }
+
+    // Blocks for the next verdict; false when nothing is pending
+    bool wait(ScoreVerdict& v) {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return !verdicts.empty() || inFlight == 0; });
+        return take(v);
+    }
+
+private:
+    VerifyPolicy policy;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable done;
+    std::deque<ScoreClaim> claims;
+    std::deque<ScoreVerdict> verdicts;
+    bool stopping;
+    size_t inFlight;
+    int wakeFds[2];
+
+    bool take(ScoreVerdict& v) {
+        if (verdicts.empty()) return false;
+        v = verdicts.front();
+        verdicts.pop_front();
+        --inFlight;
+        return true;
+    }
+
+    void loop() {
+        GameEngine engine;
+        GameEngine settings;
+        LevelCache levels;
+        if (!policy.levelDir.empty()) levels.restrictTo(policy.levelDir);
+        ReplayGame game;
+        ScoreClaim claim;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work.wait(lock, [this] { return stopping || !claims.empty(); });
+                if (stopping) return;
+                claim.id = claims.front().id;
+                claim.record.swap(claims.front().record);
+                claim.timestamp.swap(claims.front().timestamp);
+                claims.pop_front();
+            }
+            ScoreVerdict v;
+            v.id = claim.id;
+            v.score = 0;
+            v.timestamp.swap(claim.timestamp);
+            if (!claim.record.empty() && game.decode(&claim.record[0], claim.record.size())) {
+                v.score = static_cast<int>(game.score);
+                v.code = verifyReplay(game, engine, settings, levels, policy, v.detail);
+            } else {
+                v.code = VERIFY_BAD_RECORD;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                verdicts.push_back(v);
+            }
+            done.notify_all();
+            if (wakeFds[1] >= 0) {
+                char one = 1;
+                ssize_t ignored = write(wakeFds[1], &one, 1);
+                (void)ignored;
+            }
+        }
+    }
+
+    VerifierPool(const VerifierPool&);
+    VerifierPool& operator=(const VerifierPool&);
+};
+
+#endif
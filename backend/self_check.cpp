@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "endless_world.h"
+#include "score_archive.h"
+#include "score_stats.h"
+#include "snake_core.h"
+
+using namespace std;
+
+// Checks the data structures that the game's own lockstep check
+// (diff_harness) does not reach, each against a plain model built with the
+// standard library from the same random input:
+//
+//   archive  ScoreImporter's external merge, with runs small enough that
+//            every import spills several, against a sorted multiset;
+//            files sharing scores and minutes all count, but importing a
+//            file again, under its own name or another, changes nothing
+//   digest   TDigest quantiles against the exact sorted values, by rank
+//   stats    RunningStats against a two-pass mean and deviation
+//   chunks   ChunkMap inserts and deletes against std::map, on keys packed
+//            close enough that probe runs overlap and deletes must shift
+//
+// Prints one line per check and exits 1 if any failed.
+
+static int failures = 0;
+
+static void report(const char* name, bool ok, const string& detail) {
+    printf("%-8s %s%s%s\n", name, ok ? "ok" : "FAILED", detail.empty() ? "" : ": ", detail.c_str());
+    if (!ok) ++failures;
+}
+
+static string format(const char* fmt, double a, double b = 0, double c = 0) {
+    char buf[160];
+    snprintf(buf, sizeof(buf), fmt, a, b, c);
+    return buf;
+}
+
+// Scores cluster on a few values and stamps on a few minutes, so equal
+// records are common both within one file and across files
+static ArchiveRecord randomRecord(GameRng& rng) {
+    ArchiveRecord r;
+    memset(&r, 0, sizeof(r));
+    r.score = rng.below(40) * 10;
+    snprintf(r.stamp, sizeof(r.stamp), "2025-%02d-%02d %02d:%02d", 1 + rng.below(2), 1 + rng.below(3),
+             rng.below(2), rng.below(4));
+    return r;
+}
+
+static bool writeScores(const string& path, const vector<ArchiveRecord>& records) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    for (size_t i = 0; i < records.size(); ++i) fprintf(file, "%d %s\n", records[i].score, records[i].stamp);
+    return fclose(file) == 0;
+}
+
+static bool readArchive(const string& path, vector<ArchiveRecord>& out) {
+    out.clear();
+    LineReader reader;
+    if (!reader.open(path)) return false;
+    const char* begin;
+    const char* end;
+    ArchiveRecord r;
+    while (reader.next(begin, end)) {
+        if (!parseArchiveLine(begin, end, r)) return false;
+        out.push_back(r);
+    }
+    return true;
+}
+
+static string recordKey(const ArchiveRecord& r) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%09d %s", 999999999 - r.score, r.stamp);
+    return buf;
+}
+
+static bool sameAsModel(const vector<ArchiveRecord>& archive, const map<string, uint64_t>& model, string& detail) {
+    for (size_t i = 1; i < archive.size(); ++i) {
+        if (archiveBefore(archive[i], archive[i - 1])) {
+            detail = format("out of order at line %.0f", static_cast<double>(i + 1));
+            return false;
+        }
+    }
+    map<string, uint64_t> counts;
+    for (size_t i = 0; i < archive.size(); ++i) ++counts[recordKey(archive[i])];
+    if (counts != model) {
+        detail = format("%.0f distinct records, %.0f expected", static_cast<double>(counts.size()),
+                        static_cast<double>(model.size()));
+        return false;
+    }
+    return true;
+}
+
+static void checkArchive(uint64_t seed, const string& dir) {
+    GameRng rng(seed);
+    string archive = dir + "/archive.txt";
+    vector<string> inputs;
+    map<string, uint64_t> model;
+    string detail;
+    bool ok = true;
+    vector<ArchiveRecord> records;
+    for (int pass = 0; pass < 2 && ok; ++pass) {
+        records.clear();
+        for (int i = 0; i < 20000; ++i) {
+            records.push_back(randomRecord(rng));
+            ++model[recordKey(records.back())];
+        }
+        string input = dir + "/input" + to_string(pass) + ".txt";
+        string copy = dir + "/copy" + to_string(pass) + ".txt";
+        ok = writeScores(input, records) && writeScores(copy, records);
+        inputs.push_back(input);
+        inputs.push_back(copy);
+        // Then the same file again and a copy of it; neither may be read
+        for (int again = 0; again < 2 && ok; ++again) {
+            vector<string> paths(1, input);
+            if (again) paths.push_back(copy);
+            ScoreImporter importer(archive, 3, 1024);
+            ImportReport importReport;
+            ok = importer.run(paths, importReport, detail);
+            vector<ArchiveRecord> merged;
+            ok = ok && readArchive(archive, merged) && sameAsModel(merged, model, detail);
+            if (ok && again && (importReport.repeats.size() != 2 || importReport.imported != 0)) {
+                detail = format("re-import read %.0f scores, skipped %.0f of 2 files",
+                                static_cast<double>(importReport.imported),
+                                static_cast<double>(importReport.repeats.size()));
+                ok = false;
+            }
+        }
+    }
+    for (size_t i = 0; i < inputs.size(); ++i) remove(inputs[i].c_str());
+    remove(archive.c_str());
+    remove((archive + ".imported").c_str());
+    report("archive", ok, ok ? format("2 inputs of 20000 imported twice each, %.0f distinct records",
+                                      static_cast<double>(model.size()))
+                             : detail);
+}
+
+static void checkDigest(uint64_t seed) {
+    GameRng rng(seed);
+    const int N = 1000000;
+    static const double qs[] = {0.001, 0.01, 0.1, 0.5, 0.9, 0.99, 0.999};
+    double worst = 0;
+    bool ok = true;
+    for (int shape = 0; shape < 2; ++shape) {
+        TDigest digest;
+        vector<double> values(N);
+        for (int i = 0; i < N; ++i) {
+            double u = (rng.next() + 0.5) / 4294967296.0;
+            values[i] = shape == 0 ? u * 1000 : -log(u) * 100;  // uniform, then a long right tail
+            digest.add(values[i]);
+        }
+        sort(values.begin(), values.end());
+        for (size_t k = 0; k < sizeof(qs) / sizeof(qs[0]); ++k) {
+            double q = qs[k];
+            double estimate = digest.quantile(q);
+            double rank = static_cast<double>(upper_bound(values.begin(), values.end(), estimate) - values.begin()) / N;
+            // Error allowed in rank: a tenth of q's distance to the nearer
+            // end, at least 2.5e-4
+            double allowed = max(2.5e-4, min(q, 1 - q) / 10);
+            double error = fabs(rank - q);
+            worst = max(worst, error / allowed);
+            if (error > allowed) {
+                report("digest", false, format("q %.3f came out at rank %.5f", q, rank));
+                ok = false;
+            }
+        }
+        if (digest.count() != static_cast<uint64_t>(N)) {
+            report("digest", false, format("count %.0f", static_cast<double>(digest.count())));
+            ok = false;
+        }
+    }
+    if (ok) report("digest", true, format("worst rank error %.0f%% of the allowance", worst * 100));
+}
+
+static void checkStats(uint64_t seed) {
+    GameRng rng(seed);
+    RunningStats stats;
+    vector<double> values;
+    for (int i = 0; i < 100000; ++i) {
+        values.push_back(1e6 + rng.below(1000));  // a large offset is where naive sums lose digits
+        stats.add(values.back());
+    }
+    double mean = 0;
+    for (size_t i = 0; i < values.size(); ++i) mean += values[i];
+    mean /= values.size();
+    double squares = 0;
+    for (size_t i = 0; i < values.size(); ++i) squares += (values[i] - mean) * (values[i] - mean);
+    double stddev = sqrt(squares / (values.size() - 1));
+    bool ok = fabs(stats.mean() - mean) < 1e-6 && fabs(stats.stddev() - stddev) < 1e-6 &&
+              stats.count() == values.size();
+    report("stats", ok, format("mean %.4f sd %.4f (two-pass %.4f)", stats.mean(), stats.stddev(), stddev));
+}
+
+static void checkChunks(uint64_t seed) {
+    GameRng rng(seed);
+    ChunkMap chunks;
+    map<uint64_t, int32_t> model;
+    bool ok = true;
+    string detail;
+    for (int op = 0; op < 300000 && ok; ++op) {
+        uint64_t k = ChunkMap::key(rng.below(24) - 12, rng.below(24) - 12);
+        bool present = model.count(k) != 0;
+        if (rng.below(3) == 0 || (present && rng.below(2) == 0)) {
+            chunks.erase(k);
+            model.erase(k);
+        } else if (!present) {
+            chunks.insert(k, op);
+            model[k] = op;
+        }
+        if (op % 997 == 0 || chunks.size() != model.size()) {
+            if (chunks.size() != model.size()) {
+                detail = format("after op %.0f: %.0f entries, %.0f expected", op, static_cast<double>(chunks.size()),
+                                static_cast<double>(model.size()));
+                ok = false;
+            }
+            for (int x = -12; x < 12 && ok; ++x) {
+                for (int y = -12; y < 12 && ok; ++y) {
+                    uint64_t probe = ChunkMap::key(x, y);
+                    map<uint64_t, int32_t>::iterator it = model.find(probe);
+                    int32_t want = it == model.end() ? ChunkMap::NONE : it->second;
+                    if (chunks.find(probe) != want) {
+                        detail = format("after op %.0f: chunk (%.0f,%.0f) lost or stale", op, x, y);
+                        ok = false;
+                    }
+                }
+            }
+        }
+    }
+    report("chunks", ok, ok ? format("300000 operations, capacity %.0f", static_cast<double>(chunks.capacity()))
+                            : detail);
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t seed = static_cast<uint64_t>(time(NULL));
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            cerr << "Usage: " << argv[0] << " [--seed N]\n";
+            return 1;
+        }
+    }
+    printf("Seed %llu\n", static_cast<unsigned long long>(seed));
+    char dir[] = "/tmp/snake_check.XXXXXX";
+    if (!mkdtemp(dir)) {
+        cerr << "Cannot create a scratch directory\n";
+        return 1;
+    }
+    checkArchive(seed, dir);
+    rmdir(dir);
+    checkDigest(seed);
+    checkStats(seed);
+    checkChunks(seed);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+#ifndef SESSION_RECORDER_H
+#define SESSION_RECORDER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include "spectator.h"
+#include "tick_profiler.h"
+
+// Records what the player sees as an asciinema v2 cast. Frames are stored
+// as the same line diffs spectators receive, so an idle board costs nothing
+// and a moving one a few dozen bytes per tick.
+//
+// The caller only encodes and appends to a memory batch; a background
+// thread writes the batch out every FLUSH_MILLIS or once it grows past
+// BATCH_BYTES, so a slow disk never reaches the frame loop. With nothing
+// batched the writer sleeps without a timeout.
+class AsciicastRecorder {
+public:
+    static const size_t BATCH_BYTES = 64 * 1024;
+    static const int FLUSH_MILLIS = 500;
+
+    AsciicastRecorder() : file(NULL), origin(0), stopping(false) {}
+
+    ~AsciicastRecorder() { close(); }
+
+    // glyphs draws the recorded cells, as it draws the player's screen
+    bool open(const std::string& path, const GlyphRenderer& glyphs) {
+        file = fopen(path.c_str(), "wb");
+        if (!file) return false;
+        encoder = ScreenDiffEncoder(glyphs);
+        writer = std::thread(&AsciicastRecorder::writerLoop, this);
+        return true;
+    }
+
+    bool isOpen() const { return file != NULL; }
+
+    // Takes the screen as cells (lines separated by '\n'). The header is
+    // written with the first frame, sized to fit it in cells.
+    void record(const char* text, size_t len) {
+        if (!file) return;
+        splitScreenLines(text, len, current);
+        uint64_t now = monotonicNanos();
+        if (origin == 0) {
+            origin = now;
+            appendHeader();
+            encoder.encodeKeyframe(current, encoded);
+        } else {
+            encoder.encodeDiff(previous, current, encoded);
+        }
+        previous.swap(current);
+        if (encoded.empty()) return;
+
+        event.clear();
+        char stamp[48];
+        snprintf(stamp, sizeof(stamp), "[%.6f, \"o\", \"", (now - origin) / 1e9);
+        event += stamp;
+        appendJsonEscaped(event, encoded);
+        event += "\"]\n";
+        append(event);
+    }
+
+    // Flushes everything recorded so far and closes the file
+    void close() {
+        if (!file) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+        fclose(file);
+        file = NULL;
+    }
+
+private:
+    FILE* file;
+    uint64_t origin;
+    ScreenDiffEncoder encoder;
+    std::vector<std::string> previous;
+    std::vector<std::string> current;
+    std::string encoded;
+    std::string event;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::string batch;
+    bool stopping;
+
+    void appendHeader() {
+        size_t width = 80;
+        for (size_t i = 0; i < current.size(); ++i) {
+            if (current[i].size() > width) width = current[i].size();
+        }
+        size_t height = current.size() > 24 ? current.size() : 24;
+        const char* term = getenv("TERM");
+        std::string header;
+        char buf[128];
+        snprintf(buf, sizeof(buf), "{\"version\": 2, \"width\": %u, \"height\": %u, \"timestamp\": %ld",
+                 static_cast<unsigned>(width), static_cast<unsigned>(height), static_cast<long>(time(NULL)));
+        header += buf;
+        header += ", \"env\": {\"TERM\": \"";
+        appendJsonEscaped(header, term ? term : "xterm");
+        header += "\"}}\n";
+        append(header);
+    }
+
+    void append(const std::string& text) {
+        bool wakeWriter;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wakeWriter = batch.empty();
+            batch += text;
+            wakeWriter = wakeWriter || batch.size() >= BATCH_BYTES;
+        }
+        if (wakeWriter) wake.notify_one();
+    }
+
+    void writerLoop() {
+        std::string pending;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || !batch.empty(); });
+            wake.wait_for(lock, std::chrono::milliseconds(FLUSH_MILLIS),
+                          [this] { return stopping || batch.size() >= BATCH_BYTES; });
+            pending.swap(batch);
+            bool done = stopping;
+            lock.unlock();
+            if (!pending.empty()) {
+                fwrite(pending.data(), 1, pending.size(), file);
+                fflush(file);
+                pending.clear();
+            }
+            if (done) return;
+            lock.lock();
+        }
+    }
+
+    static void appendJsonEscaped(std::string& out, const std::string& text) {
+        for (size_t i = 0; i < text.size(); ++i) {
+            unsigned char c = text[i];
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (c == '\n') {
+                out += "\\n";
+            } else if (c == '\r') {
+                out += "\\r";
+            } else if (c < 0x20 || c == 0x7f) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+
+    AsciicastRecorder(const AsciicastRecorder&);
+    AsciicastRecorder& operator=(const AsciicastRecorder&);
+};
+
+#endif
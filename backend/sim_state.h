@@ -0,0 +1,482 @@
+#ifndef SIM_STATE_H
+#define SIM_STATE_H
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+#include "snake_core.h"
+#include "game_engine.h"
+
+// Boards up to this many cells and this many items fit in a SimState
+const int SIM_MAX_CELLS = 1024;
+const int SIM_MAX_ITEMS = 32;
+
+struct SimTimer {
+    uint32_t due;    // 0 when not armed
+    uint32_t order;  // breaks ties between timers due on the same tick
+};
+
+// The whole of a single-player game in one flat block of about 550 bytes,
+// for search code that copies a state millions of times a second. Copying
+// is plain assignment (a memcpy); there are no pointers to own except the
+// shared, immutable level.
+//
+// The body is the tail cell plus one 2-bit move per segment, in a ring,
+// and an occupancy bitmap answers "is the snake here". Items are a short
+// array, timers three tick numbers. The rules are GameEngine's, with the
+// same random draws at the same points, so a state loaded from an engine
+// plays on exactly as the engine would (diff_harness checks this).
+struct SimState {
+    enum Flag {
+        FLAG_OVER = 1,
+        FLAG_PAUSED = 2,
+        FLAG_EASY = 4,
+        FLAG_WRAP = 8
+    };
+
+    const LevelMap* level;
+    GameRng rng;
+    uint32_t tick;
+    uint32_t scheduled;
+    uint32_t specialReady;
+    uint32_t poisonReady;
+    SimTimer specialSpawn;
+    SimTimer specialExpire;
+    SimTimer poisonSpawn;
+    int32_t score;
+    int32_t foodsEaten;
+    uint16_t head;
+    uint16_t neck;
+    uint16_t tail;
+    uint16_t length;
+    uint16_t firstMove;
+    uint8_t dir;
+    uint8_t flags;
+    uint8_t foodTarget;
+    uint8_t itemCount;
+    uint16_t itemCell[SIM_MAX_ITEMS];
+    uint8_t itemType[SIM_MAX_ITEMS];
+    uint8_t moves[SIM_MAX_CELLS / 4];
+    uint64_t occupied[SIM_MAX_CELLS / 64];
+
+    static bool fits(const LevelMap& map, int foods) {
+        return map.cellCount() <= static_cast<uint32_t>(SIM_MAX_CELLS) && foods <= SIM_MAX_ITEMS - 2;
+    }
+
+    // A fresh game, as GameEngine::reset() starts one from this seed
+    void reset(const LevelMap* map, uint64_t seed, int foods, bool easy, bool wrap) {
+        *this = SimState();
+        level = map;
+        rng.seed(seed);
+        foodTarget = static_cast<uint8_t>(foods);
+        flags = (easy ? FLAG_EASY : 0) | (wrap ? FLAG_WRAP : 0);
+        spawnSnake();
+        restartItems();
+    }
+
+    // Copies the engine's current game. Fails when the board or the item
+    // count does not fit, or the body is not a connected path. image is the
+    // caller's scratch buffer for the engine's state, kept from call to
+    // call; sized by GameEngine::stateBytesBound it is never grown here.
+    bool load(const GameEngine& engine, std::vector<uint8_t>& image) {
+        const LevelMap& map = engine.getLevelMap();
+        if (!fits(map, engine.getFoodCount())) return false;
+        image.clear();
+        WireWriter w(image);
+        engine.writeState(w);
+        WireReader r(&image[0], image.size());
+
+        *this = SimState();
+        level = &map;
+        tick = static_cast<uint32_t>(r.varint64());
+        score = static_cast<int32_t>(r.varint());
+        foodsEaten = static_cast<int32_t>(r.varint());
+        uint8_t engineFlags = r.u8();
+        flags = (engineFlags & 1 ? FLAG_OVER : 0) | (engineFlags & 2 ? FLAG_PAUSED : 0) |
+                (engineFlags & 4 ? FLAG_EASY : 0) | (engineFlags & 8 ? FLAG_WRAP : 0);
+        r.u8();
+        foodTarget = static_cast<uint8_t>(r.varint());
+        rng.seed(r.u64());
+        specialReady = static_cast<uint32_t>(r.varint64());
+        poisonReady = static_cast<uint32_t>(r.varint64());
+        uint32_t specialSeq = r.varint();
+        uint32_t poisonSeq = r.varint();
+
+        uint8_t dirByte = r.u8();
+        Position d((dirByte & 3) - 1, ((dirByte >> 2) & 3) - 1);
+        dir = static_cast<uint8_t>(directionIndex(d));
+        uint32_t len = r.varint();
+        if (!r.ok() || len == 0 || len > map.cellCount()) return false;
+        // Head to tail; each segment's move is taken from the one before
+        uint32_t previous = r.varint();
+        head = neck = tail = static_cast<uint16_t>(previous);
+        length = static_cast<uint16_t>(len);
+        occupy(previous);
+        for (uint32_t i = 1; i < len; ++i) {
+            uint32_t cell = r.varint();
+            if (i == 1) neck = static_cast<uint16_t>(cell);
+            tail = static_cast<uint16_t>(cell);
+            occupy(cell);
+            int step = stepBetween(cell, previous);
+            if (step < 0) return false;
+            setMove(len - 1 - i, step);
+            previous = cell;
+        }
+
+        uint32_t items = r.varint();
+        if (items > static_cast<uint32_t>(SIM_MAX_ITEMS)) return false;
+        for (uint32_t i = 0; i < items; ++i) {
+            int type = r.u8();
+            uint32_t cell = r.varint();
+            uint32_t expiryEvent = r.varint();
+            uint32_t expiresAt = static_cast<uint32_t>(r.varint64());
+            addItem(type, cell);
+            if (type == ITEM_SPECIAL) {
+                specialExpire.due = expiresAt;
+                specialExpire.order = expiryEvent;
+            }
+        }
+        scheduled = r.varint();
+        uint32_t events = r.varint();
+        for (uint32_t i = 0; i < events; ++i) {
+            uint32_t due = static_cast<uint32_t>(r.varint64());
+            uint32_t seq = r.varint();
+            r.u8();
+            r.varint();
+            if (seq == specialSeq && specialSeq != 0) {
+                specialSpawn.due = due;
+                specialSpawn.order = seq;
+            } else if (seq == poisonSeq && poisonSeq != 0) {
+                poisonSpawn.due = due;
+                poisonSpawn.order = seq;
+            }
+        }
+        if (scheduled > 0) --scheduled;
+        return r.ok();
+    }
+
+    bool isOver() const { return (flags & FLAG_OVER) != 0; }
+    bool isPaused() const { return (flags & FLAG_PAUSED) != 0; }
+
+    RuleTimers getTimers() const {
+        RuleTimers t;
+        t.specialReady = specialReady;
+        t.poisonReady = poisonReady;
+        t.specialSpawn = specialSpawn.due;
+        t.specialExpire = specialExpire.due;
+        t.poisonSpawn = poisonSpawn.due;
+        return t;
+    }
+    int direction() const { return dir; }
+
+    // Same rule as Snake::setDirection: no turning back onto the neck
+    bool turnsBack(int d) const {
+        int width = level->width();
+        return length > 1 && static_cast<int>(head % width) + LEVEL_DX[d] == static_cast<int>(neck % width) &&
+               static_cast<int>(head / width) + LEVEL_DY[d] == static_cast<int>(neck / width);
+    }
+
+    void setDirection(int d) {
+        if (!turnsBack(d)) dir = static_cast<uint8_t>(d);
+    }
+
+    void setPaused(bool paused) {
+        flags = paused ? (flags | FLAG_PAUSED) : (flags & ~FLAG_PAUSED);
+    }
+
+    // The cell the head enters moving d, after wrapping and portals
+    uint32_t target(int d) const { return stepFrom(head, d); }
+
+    // True if moving d ends the game (or costs a life in easy mode)
+    bool blocked(int d) const {
+        uint32_t cell = stepFrom(head, d);
+        return level->isWall(cell) || (isOccupied(cell) && cell != head);
+    }
+
+    bool isOccupied(uint32_t cell) const { return occupied[cell >> 6] >> (cell & 63) & 1; }
+
+    int findItem(uint32_t cell) const {
+        for (int i = 0; i < itemCount; ++i) {
+            if (itemCell[i] == cell) return i;
+        }
+        return -1;
+    }
+
+    // Manhattan distance from cell to the nearest plain or special food,
+    // ignoring walls, wrap and portals; a large number when there is none
+    int foodDistance(uint32_t cell) const {
+        int width = level->width();
+        int x = static_cast<int>(cell % width);
+        int y = static_cast<int>(cell / width);
+        int best = 1 << 20;
+        for (int i = 0; i < itemCount; ++i) {
+            if (itemType[i] == ITEM_POISON) continue;
+            int dx = static_cast<int>(itemCell[i] % width) - x;
+            int dy = static_cast<int>(itemCell[i] / width) - y;
+            int distance = (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+            if (distance < best) best = distance;
+        }
+        return best;
+    }
+
+    // Segments from head to tail
+    void bodyCells(std::vector<uint32_t>& out) const {
+        out.resize(length);
+        uint32_t cell = tail;
+        out[length - 1] = cell;
+        for (int i = 0; i + 1 < length; ++i) {
+            cell = stepFrom(cell, move(i));
+            out[length - 2 - i] = cell;
+        }
+    }
+
+    // Advances one tick. Returns true on the tick the game ends.
+    bool step() {
+        if (flags & (FLAG_OVER | FLAG_PAUSED)) return false;
+        ++tick;
+        runTimers();
+        if (filled()) {
+            flags |= FLAG_OVER;
+            return true;
+        }
+
+        uint32_t cell = stepFrom(head, dir);
+        if (level->isWall(cell) || (isOccupied(cell) && cell != head)) {
+            if (flags & FLAG_EASY) {
+                score = score > 50 ? score - 50 : 0;
+                spawnSnake();
+                foodsEaten = 0;
+                restartItems();
+                return false;
+            }
+            flags |= FLAG_OVER;
+            return true;
+        }
+
+        bool grow = eat(cell);
+        setMove(length - 1, dir);
+        neck = head;
+        head = static_cast<uint16_t>(cell);
+        occupy(cell);
+        ++length;
+        if (!grow) popTail();
+        if (filled()) {
+            flags |= FLAG_OVER;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    static int directionIndex(const Position& d) {
+        for (int i = 0; i < 4; ++i) {
+            if (LEVEL_DX[i] == d.x && LEVEL_DY[i] == d.y) return i;
+        }
+        return 1;
+    }
+
+    uint32_t stepFrom(uint32_t cell, int d) const {
+        int width = level->width();
+        int height = level->height();
+        int x = static_cast<int>(cell % width) + LEVEL_DX[d];
+        int y = static_cast<int>(cell / width) + LEVEL_DY[d];
+        if (flags & FLAG_WRAP) {
+            if (x <= 0) x = width - 2;
+            else if (x >= width - 1) x = 1;
+            if (y <= 0) y = height - 2;
+            else if (y >= height - 1) y = 1;
+        }
+        uint32_t next = static_cast<uint32_t>(y * width + x);
+        return level->isPortal(next) ? level->portalTarget(next) : next;
+    }
+
+    int stepBetween(uint32_t from, uint32_t to) const {
+        for (int d = 0; d < 4; ++d) {
+            if (stepFrom(from, d) == to) return d;
+        }
+        return -1;
+    }
+
+    // Move i leads from segment i (counted from the tail) to segment i + 1
+    int move(int i) const {
+        int slot = (firstMove + i) % SIM_MAX_CELLS;
+        return moves[slot >> 2] >> ((slot & 3) * 2) & 3;
+    }
+
+    void setMove(int i, int d) {
+        int slot = (firstMove + i) % SIM_MAX_CELLS;
+        int shift = (slot & 3) * 2;
+        moves[slot >> 2] = static_cast<uint8_t>((moves[slot >> 2] & ~(3 << shift)) | (d << shift));
+    }
+
+    void occupy(uint32_t cell) { occupied[cell >> 6] |= 1ULL << (cell & 63); }
+    void vacate(uint32_t cell) { occupied[cell >> 6] &= ~(1ULL << (cell & 63)); }
+
+    void popTail() {
+        vacate(tail);
+        tail = static_cast<uint16_t>(stepFrom(tail, move(0)));
+        firstMove = static_cast<uint16_t>((firstMove + 1) % SIM_MAX_CELLS);
+        --length;
+    }
+
+    void spawnSnake() {
+        uint32_t spawns = level->spawnCount();
+        uint32_t cell = level->spawnCell(spawns > 1 ? rng.below(spawns) : 0);
+        memset(occupied, 0, sizeof(occupied));
+        head = neck = tail = static_cast<uint16_t>(cell);
+        length = 1;
+        firstMove = 0;
+        occupy(cell);
+        dir = 1;
+    }
+
+    void addItem(int type, uint32_t cell) {
+        itemCell[itemCount] = static_cast<uint16_t>(cell);
+        itemType[itemCount] = static_cast<uint8_t>(type);
+        ++itemCount;
+    }
+
+    // Removing an item moves the last one into its place, as ItemLayer does
+    void removeItem(int index) {
+        --itemCount;
+        itemCell[index] = itemCell[itemCount];
+        itemType[index] = itemType[itemCount];
+    }
+
+    bool hasItem(int type) const {
+        for (int i = 0; i < itemCount; ++i) {
+            if (itemType[i] == type) return true;
+        }
+        return false;
+    }
+
+    uint32_t randomFreeCell() {
+        int freeCount = static_cast<int>(level->freeCount());
+        while (true) {
+            uint32_t cell = level->freeCell(rng.below(freeCount));
+            if (findItem(cell) < 0 && !isOccupied(cell)) return cell;
+        }
+    }
+
+    bool filled() const { return static_cast<uint32_t>(length + hasItem(ITEM_POISON)) >= level->freeCount(); }
+
+    // Same rule as GameEngine::hasRoom
+    bool hasRoom(int pending) const {
+        return static_cast<uint32_t>(length + itemCount + pending) < level->freeCount();
+    }
+
+    void arm(SimTimer& timer, uint32_t due) {
+        timer.due = due;
+        timer.order = ++scheduled;
+    }
+
+    void armSpecialSpawn(int cooldown) {
+        specialReady = tick + cooldown;
+        arm(specialSpawn, specialReady + rng.trialsUntil(SPECIAL_FOOD_CHANCE));
+    }
+
+    void armPoisonSpawn(int cooldown) {
+        poisonReady = tick + cooldown;
+        arm(poisonSpawn, poisonReady + rng.trialsUntil(POISON_FOOD_CHANCE));
+    }
+
+    void placeSpecial(uint32_t cell) {
+        addItem(ITEM_SPECIAL, cell);
+        arm(specialExpire, tick + SPECIAL_FOOD_LIFETIME);
+        specialSpawn.due = 0;
+    }
+
+    void placePoison() {
+        addItem(ITEM_POISON, randomFreeCell());
+        poisonSpawn.due = 0;
+    }
+
+    void runTimers() {
+        SimTimer* due[3];
+        int n = 0;
+        SimTimer* all[3] = {&specialSpawn, &specialExpire, &poisonSpawn};
+        for (int i = 0; i < 3; ++i) {
+            if (all[i]->due != 0 && all[i]->due <= tick) due[n++] = all[i];
+        }
+        for (int i = 1; i < n; ++i) {
+            for (int j = i; j > 0 && due[j]->order < due[j - 1]->order; --j) {
+                SimTimer* t = due[j];
+                due[j] = due[j - 1];
+                due[j - 1] = t;
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            SimTimer* t = due[i];
+            t->due = 0;
+            if (t == &specialSpawn) {
+                if (hasRoom(0)) placeSpecial(randomFreeCell());
+                else armSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+            } else if (t == &specialExpire) {
+                for (int k = 0; k < itemCount; ++k) {
+                    if (itemType[k] == ITEM_SPECIAL) {
+                        removeItem(k);
+                        break;
+                    }
+                }
+                armSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+            } else if (hasRoom(0)) {
+                placePoison();
+            } else {
+                armPoisonSpawn(POISON_COOLDOWN_INIT);
+            }
+        }
+    }
+
+    void restartItems() {
+        itemCount = 0;
+        specialExpire.due = 0;
+        int foods = foodTarget;
+        if (foods > static_cast<int>(level->freeCount() / 2)) foods = level->freeCount() / 2;
+        for (int i = 0; i < foods; ++i) addItem(ITEM_FOOD, randomFreeCell());
+        armSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+        armPoisonSpawn(POISON_COOLDOWN_INIT);
+    }
+
+    bool eat(uint32_t cell) {
+        int index = findItem(cell);
+        if (index < 0) return false;
+        int type = itemType[index];
+        removeItem(index);
+        if (type == ITEM_SPECIAL) {
+            specialExpire.due = 0;
+            score += SPECIAL_SCORE;
+            foodsEaten++;
+            armSpecialSpawn(SPECIAL_COOLDOWN_INIT);
+            for (int k = 0; k < itemCount; ++k) {
+                if (itemType[k] == ITEM_FOOD) {
+                    removeItem(k);
+                    addItem(ITEM_FOOD, randomFreeCell());
+                    break;
+                }
+            }
+            return true;
+        }
+        if (type == ITEM_POISON) {
+            score = score > POISON_PENALTY ? score - POISON_PENALTY : 0;
+            for (int i = 0; i < 3 && length > 1; ++i) popTail();
+            armPoisonSpawn(POISON_COOLDOWN_INIT);
+            return false;
+        }
+        score += FOOD_SCORE;
+        foodsEaten++;
+        if (hasRoom(1)) addItem(ITEM_FOOD, randomFreeCell());
+        if (!hasItem(ITEM_SPECIAL) && tick >= specialReady && rng.below(100) < SPECIAL_FOOD_CHANCE && hasRoom(1)) {
+            placeSpecial(randomFreeCell());
+        }
+        if (!hasItem(ITEM_POISON) && tick >= poisonReady && rng.below(100) < POISON_FOOD_CHANCE && hasRoom(1)) {
+            placePoison();
+        }
+        return true;
+    }
+};
+
+static_assert(std::is_trivially_copyable<SimState>::value, "SimState must copy as raw bytes");
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef SNAKE_CORE_H
+#define SNAKE_CORE_H
+
+#include <vector>
+#include <stdint.h>
+#include <termios.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+
+using namespace std;
+
+const int BOARD_WIDTH = 30;
+const int BOARD_HEIGHT = 20;
+const char SNAKE_BODY = 'O';
+const char SNAKE_HEAD = '@';
+const char FOOD = '*';
+const char SPECIAL_FOOD = '$';
+const char POISON_FOOD = '!';
+const char WALL = '#';
+const char EMPTY = ' ';
+const int BASE_SPEED = 150000;
+const int MIN_SPEED = 50000;
+const int SPEED_STEP = 5000;
+const int FOOD_SCORE = 10;
+const int SPECIAL_SCORE = 50;
+const int POISON_PENALTY = 20;
+const int FOODS_PER_LEVEL = 5;
+const int SPECIAL_FOOD_CHANCE = 20;
+const int SPECIAL_FOOD_LIFETIME = 30;
+const int SPECIAL_COOLDOWN_INIT = 20;
+const int POISON_FOOD_CHANCE = 15;
+const int POISON_COOLDOWN_INIT = 25;
+
+// The timers behind bonus and poison food as tick numbers, 0 for one not
+// running. Every model of the rules reports them this way, so diff_harness
+// can compare what has not reached the board yet.
+struct RuleTimers {
+    uint64_t specialReady;
+    uint64_t poisonReady;
+    uint64_t specialSpawn;
+    uint64_t specialExpire;
+    uint64_t poisonSpawn;
+};
+
+// SplitMix64: tiny, seedable and identical on every platform, so a game is
+// reproducible from its seed and the inputs applied to it
+class GameRng {
+public:
+    explicit GameRng(uint64_t seed = 1) : state(seed) {}
+    void seed(uint64_t value) { state = value; }
+    uint64_t getState() const { return state; }
+
+    uint32_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+    }
+
+    int below(int n) { return static_cast<int>(next() % static_cast<uint32_t>(n)); }
+
+    // Number of independent percent% rolls up to and including the first
+    // success, drawn from one number (geometric distribution, always >= 1).
+    // More than k rolls are needed with chance (1 - p)^k; that threshold is
+    // kept as a 32-bit fraction and shrunk by integer steps, so the draw
+    // is the same on every platform, with no libm involved. It takes about
+    // 100 / percent steps.
+    uint32_t trialsUntil(int percent) {
+        if (percent >= 100) return 1;
+        if (percent <= 0) return 0x7FFFFFFF;
+        uint64_t u = next();
+        uint64_t survive = 1ULL << 32;
+        uint32_t trials = 1;
+        while (true) {
+            survive = survive * static_cast<uint64_t>(100 - percent) / 100;
+            if (u >= survive) return trials;
+            ++trials;
+        }
+    }
+
+private:
+    uint64_t state;
+};
+
+struct Position {
+    int x, y;
+    Position(int x = 0, int y = 0) : x(x), y(y) {}
+    bool operator==(const Position& other) const {
+        return x == other.x && y == other.y;
+    }
+};
+
+class TerminalInput {
+private:
+    struct termios oldTermios;
+    bool initialized;
+    
+public:
+    TerminalInput() : initialized(false) {
+        tcgetattr(STDIN_FILENO, &oldTermios);
+        struct termios newTermios = oldTermios;
+        newTermios.c_lflag &= ~(ICANON | ECHO);
+        tcsetattr(STDIN_FILENO, TCSANOW, &newTermios);
+        fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
+        initialized = true;
+    }
+    
+    ~TerminalInput() {
+        if (initialized) {
+            tcsetattr(STDIN_FILENO, TCSANOW, &oldTermios);
+        }
+    }
+    
+    bool kbhit() {
+        fd_set readfds;
+        struct timeval timeout;
+        FD_ZERO(&readfds);
+        FD_SET(STDIN_FILENO, &readfds);
+        timeout.tv_sec = 0;
+        timeout.tv_usec = 0;
+        return select(STDIN_FILENO + 1, &readfds, NULL, NULL, &timeout) > 0;
+    }
+    
+    char getch() {
+        char ch;
+        if (read(STDIN_FILENO, &ch, 1) == 1) {
+            return ch;
+        }
+        return 0;
+    }
+};
+
+class Snake {
+public:
+    Snake(int startX = BOARD_WIDTH / 2, int startY = BOARD_HEIGHT / 2) {
+        body.push_back(Position(startX, startY));
+        dir = Position(1, 0);
+    }
+    
+    const vector<Position>& getBody() const { return body; }
+    const Position& head() const { return body[0]; }
+    const Position& getDirection() const { return dir; }
+    
+    void setDirection(const Position& newDir) {
+        if (newDir.x == 0 && newDir.y == 0) return;
+        if (body.size() > 1) {
+            Position nextHead = head();
+            nextHead.x += newDir.x;
+            nextHead.y += newDir.y;
+            if (nextHead == body[1]) {
+                return;
+            }
+        }
+        dir = newDir;
+    }
+    
+    Position nextHead() const {
+        Position nh = head();
+        nh.x += dir.x;
+        nh.y += dir.y;
+        return nh;
+    }
+    
+    void moveTo(const Position& newHead, bool grow) {
+        body.insert(body.begin(), newHead);
+        if (!grow && !body.empty()) {
+            body.pop_back();
+        }
+    }
+    
+    bool hitsSelf(const Position& p) const {
+        for (size_t i = 1; i < body.size(); ++i) {
+            if (body[i] == p) return true;
+        }
+        return false;
+    }
+    
+    void shrink(int amount) {
+        while (amount > 0 && body.size() > 1) {
+            body.pop_back();
+            --amount;
+        }
+    }
+    
+    // Back to a single segment heading right; keeps the body's capacity
+    void respawn(int x, int y) {
+        body.clear();
+        body.push_back(Position(x, y));
+        dir = Position(1, 0);
+    }
+    
+    // Room for a body this long, so moveTo never reallocates below it
+    void reserve(size_t length) { body.reserve(length); }
+    
+    void setBodyAndDirection(const vector<Position>& newBody, const Position& newDir) {
+        body = newBody;
+        dir = newDir;
+    }
+    
+private:
+    vector<Position> body;
+    Position dir;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <climits>
 #include <cstdlib>
 #include <ctime>
 #include <iomanip>
@@ -10,6 +11,30 @@
 #include <fstream>
 #include <algorithm>
 #include <sstream>
+#include <thread>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <cerrno>
+#define ALLOC_COUNTER_HOOKS
+#include "alloc_counter.h"
+#include "snake_core.h"
+#include "game_engine.h"
+#include "tick_profiler.h"
+#include "multiplayer.h"
+#include "spectator.h"
+#include "telnet_server.h"
+#include "rewind_history.h"
+#include "frame_pipeline.h"
+#include "glyph_renderer.h"
+#include "session_recorder.h"
+#include "replay_log.h"
+#include "score_service.h"
+#include "mcts_ai.h"
+#include "hamilton_ai.h"
+#include "arena.h"
+#include "endless_world.h"
+#include "live_metrics.h"
 
 using namespace std;
 
@@ -32,14 +57,10 @@ private:
     
     string getCurrentTimestamp() {
         time_t now = time(0);
-        tm* ltm = localtime(&now);
-        stringstream ss;
-        ss << (1900 + ltm->tm_year) << "-"
-           << setfill('0') << setw(2) << (1 + ltm->tm_mon) << "-"
-           << setfill('0') << setw(2) << ltm->tm_mday << " "
-           << setfill('0') << setw(2) << ltm->tm_hour << ":"
-           << setfill('0') << setw(2) << ltm->tm_min;
-        return ss.str();
+        struct tm local;
+        char buf[32];
+        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M", localtime_r(&now, &local));
+        return buf;
     }
     
 public:
@@ -47,29 +68,52 @@ public:
         loadScores();
     }
     
+    // Asks the score daemon first and reads the file only if none is running
     void loadScores() {
-        scores.clear();
+        string board;
+        if (fetchScoresFromService(board)) {
+            istringstream in(board);
+            readScores(in);
+            return;
+        }
         ifstream file(scoreFile);
         if (file.is_open()) {
-            int score;
-            string timestamp;
-            while (file >> score) {
-                file.ignore();
-                getline(file, timestamp);
-                scores.push_back(ScoreEntry(score, timestamp));
-            }
+            readScores(file);
             file.close();
-            sort(scores.begin(), scores.end(), greater<ScoreEntry>());
+        } else {
+            scores.clear();
         }
     }
     
-    void saveScore(int score) {
+    // Reads "score timestamp" lines, as stored in the file and sent by the daemon
+    void readScores(istream& in) {
+        scores.clear();
+        int score;
+        string timestamp;
+        while (in >> score) {
+            in.ignore();
+            getline(in, timestamp);
+            scores.push_back(ScoreEntry(score, timestamp));
+        }
+        sort(scores.begin(), scores.end(), greater<ScoreEntry>());
+    }
+    
+    // With a replay the daemon checks the score by playing the game again
+    void saveScore(int score, const vector<uint8_t>* replay = NULL) {
         string timestamp = getCurrentTimestamp();
         scores.push_back(ScoreEntry(score, timestamp));
         sort(scores.begin(), scores.end(), greater<ScoreEntry>());
         if (scores.size() > 10) {
             scores.resize(10);
         }
+        if (replay && !replay->empty() && submitReplayToService(*replay, timestamp)) {
+            return;
+        }
+        if (submitScoreToService(score, timestamp)) {
+            return;
+        }
+        
+        // No daemon: write the file ourselves
         ofstream file(scoreFile);
         if (file.is_open()) {
             for (const auto& entry : scores) {
@@ -87,161 +131,89 @@ public:
     }
 };
 
-const int BOARD_WIDTH = 30;
-const int BOARD_HEIGHT = 20;
-const char SNAKE_BODY = 'O';
-const char SNAKE_HEAD = '@';
-const char FOOD = '*';
-const char SPECIAL_FOOD = '$';
-const char POISON_FOOD = '!';
-const char WALL = '#';
-const char EMPTY = ' ';
-const int BASE_SPEED = 150000;
-const int MIN_SPEED = 50000;
-const int SPEED_STEP = 5000;
-const int FOOD_SCORE = 10;
-const int SPECIAL_SCORE = 50;
-const int POISON_PENALTY = 20;
-const int FOODS_PER_LEVEL = 5;
-const int SPECIAL_FOOD_CHANCE = 20;
-const int SPECIAL_FOOD_LIFETIME = 30;
-const int SPECIAL_COOLDOWN_INIT = 20;
-const int POISON_FOOD_CHANCE = 15;
-const int POISON_COOLDOWN_INIT = 25;
+struct GameOptions {
+    bool debugHud;
+    string traceFile;
+    string recordFile;
+    string replayFile;
+    string levelPath;
+    string serverAddress;
+    string connectAddress;
+    string spectateAddress;
+    string watchAddress;
+    string telnetAddress;
+    string telnetLoadAddress;
+    int maxSessions;
+    int loadSessions;
+    int loadSeconds;
+    bool botClient;
+    long maxTicks;
+    int tickMicros;
+    int foods;
+    const LevelMap* level;
+    int rewindSeconds;
+    string ai;
+    int aiThreads;
+    int arenaSnakes;
+    bool endless;
+    int solveBenchGames;
+    bool live;
+    ColorMode colorMode;
+    bool unicode;
 
-struct Position {
-    int x, y;
-    Position(int x = 0, int y = 0) : x(x), y(y) {}
-    bool operator==(const Position& other) const {
-        return x == other.x && y == other.y;
-    }
-};
-
-class TerminalInput {
-private:
-    struct termios oldTermios;
-    bool initialized;
-    
-public:
-    TerminalInput() : initialized(false) {
-        tcgetattr(STDIN_FILENO, &oldTermios);
-        struct termios newTermios = oldTermios;
-        newTermios.c_lflag &= ~(ICANON | ECHO);
-        tcsetattr(STDIN_FILENO, TCSANOW, &newTermios);
-        fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
-        initialized = true;
-    }
-    
-    ~TerminalInput() {
-        if (initialized) {
-            tcsetattr(STDIN_FILENO, TCSANOW, &oldTermios);
-        }
-    }
-    
-    bool kbhit() {
-        fd_set readfds;
-        struct timeval timeout;
-        FD_ZERO(&readfds);
-        FD_SET(STDIN_FILENO, &readfds);
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 0;
-        return select(STDIN_FILENO + 1, &readfds, NULL, NULL, &timeout) > 0;
-    }
-    
-    char getch() {
-        char ch;
-        if (read(STDIN_FILENO, &ch, 1) == 1) {
-            return ch;
-        }
-        return 0;
-    }
+    GameOptions()
+        : debugHud(false), maxSessions(20000), loadSessions(100), loadSeconds(10),
+          botClient(false), maxTicks(0), tickMicros(BASE_SPEED), foods(1), level(NULL),
+          rewindSeconds(10), aiThreads(0), arenaSnakes(0), endless(false),
+          solveBenchGames(0), live(true), colorMode(COLOR_NONE), unicode(false) {}
 };
 
-class Snake {
-public:
-    Snake(int startX = BOARD_WIDTH / 2, int startY = BOARD_HEIGHT / 2) {
-        body.push_back(Position(startX, startY));
-        dir = Position(1, 0);
-    }
-    
-    const vector<Position>& getBody() const { return body; }
-    const Position& head() const { return body[0]; }
-    const Position& getDirection() const { return dir; }
-    
-    void setDirection(const Position& newDir) {
-        if (newDir.x == 0 && newDir.y == 0) return;
-        if (body.size() > 1) {
-            Position nextHead = head();
-            nextHead.x += newDir.x;
-            nextHead.y += newDir.y;
-            if (nextHead == body[1]) {
-                return;
-            }
-        }
-        dir = newDir;
-    }
-    
-    Position nextHead() const {
-        Position nh = head();
-        nh.x += dir.x;
-        nh.y += dir.y;
-        return nh;
-    }
-    
-    void moveTo(const Position& newHead, bool grow) {
-        body.insert(body.begin(), newHead);
-        if (!grow && !body.empty()) {
-            body.pop_back();
-        }
-    }
-    
-    bool hitsSelf(const Position& p) const {
-        for (size_t i = 1; i < body.size(); ++i) {
-            if (body[i] == p) return true;
-        }
-        return false;
-    }
-    
-    void shrink(int amount) {
-        while (amount > 0 && body.size() > 1) {
-            body.pop_back();
-            --amount;
-        }
-    }
-    
-    void setBodyAndDirection(const vector<Position>& newBody, const Position& newDir) {
-        body = newBody;
-        dir = newDir;
-    }
-    
-private:
-    vector<Position> body;
-    Position dir;
-};
+// Arrow keys arrive from the input thread already decoded to these
+const char KEY_ARROW_UP = 0x1C;
+const char KEY_ARROW_DOWN = 0x1D;
+const char KEY_ARROW_RIGHT = 0x1E;
+const char KEY_ARROW_LEFT = 0x1F;
 
 class SnakeGame {
 private:
-    Snake snake;
-    Position food;
-    Position specialFood;
-    Position poisonFood;
-    int score;
+    GameEngine game;
     int highScore;
-    int foodsEaten;
-    bool hasSpecialFood;
-    bool hasPoisonFood;
-    int specialFoodTimer;
-    int specialCooldown;
-    int poisonCooldown;
-    bool gameOver;
-    bool gamePaused;
     TerminalInput terminal;
     ScoreTracker scoreTracker;
-    bool easyMode;
-    bool wrapMode;
-    int speedMode;
     string saveFileName;
     int tickCount;
+    bool running;
+    FrameWriter frame;
+    vector<char> cells;
+    GlyphRenderer glyphs;
+    vector<uint8_t> simImage;
+    RewindHistory history;
+    bool practice;
+    bool rewound;
+    char deferredKey;
+    TickProfiler profiler;
+    SpectatorHub* spectators;
+    AsciicastRecorder recorder;
+    ReplayRecorder replays;
+    string levelPath;
+    MctsController* autopilot;
+    HamiltonSolver* solver;
+    LivePublisher live;
+    LiveSample liveSample;
+    uint64_t tickAllocations;
+    uint64_t lastTickAllocations;
+    uint64_t allocationTicks;
+    GameRng seeds;
+    SpscQueue<char, 256> keys;
+    TripleBuffer<FrameSnapshot> frames;
+    FrameStats frameStats;
+    std::thread inputThread;
+    std::thread renderThread;
+    std::atomic<bool> pipelineStopping;
+    int renderWakeFd;
+    int inputWakeFd;
+    int inputStopFd;
+    int stdoutFlags;
     
     void clearScreen() {
         cout << "\033[2J\033[H";
@@ -259,396 +231,243 @@ private:
         cout << "\033[?25h";
     }
     
+    // Sleeps in poll() until the terminal has input; no timer wakeups
     char waitForKey() {
         char k = 0;
         while (k == 0) {
-            if (terminal.kbhit()) {
-                k = terminal.getch();
-                if (k != 0) break;
-            }
-            usleep(50000);
+            struct pollfd pfd;
+            pfd.fd = STDIN_FILENO;
+            pfd.events = POLLIN;
+            poll(&pfd, 1, -1);
+            k = terminal.getch();
         }
         return k;
     }
     
-    Position generateFood() {
-        Position newFood;
-        bool valid = false;
-        const vector<Position>& body = snake.getBody();
-        while (!valid) {
-            newFood.x = rand() % (BOARD_WIDTH - 2) + 1;
-            newFood.y = rand() % (BOARD_HEIGHT - 2) + 1;
-            valid = true;
-            for (const auto& segment : body) {
-                if (segment == newFood) {
-                    valid = false;
-                    break;
-                }
-            }
-            if (hasSpecialFood && newFood == specialFood) {
-                valid = false;
-            }
-            if (hasPoisonFood && newFood == poisonFood) {
-                valid = false;
-            }
-        }
-        return newFood;
-    }
-    
-    void spawnSpecialFood() {
-        if (!hasSpecialFood && specialCooldown <= 0) {
-            if ((rand() % 100) < SPECIAL_FOOD_CHANCE) {
-                specialFood = generateFood();
-                hasSpecialFood = true;
-                specialFoodTimer = SPECIAL_FOOD_LIFETIME;
-                specialCooldown = SPECIAL_COOLDOWN_INIT;
-            }
-        }
-    }
-    
-    void updateSpecialFood() {
-        if (hasSpecialFood) {
-            if (--specialFoodTimer <= 0) {
-                hasSpecialFood = false;
-            }
-        } else {
-            if (specialCooldown > 0) {
-                --specialCooldown;
-            } else {
-                spawnSpecialFood();
-            }
-        }
-    }
-    
-    void spawnPoisonFood() {
-        if (!hasPoisonFood && poisonCooldown <= 0) {
-            if ((rand() % 100) < POISON_FOOD_CHANCE) {
-                poisonFood = generateFood();
-                hasPoisonFood = true;
-                poisonCooldown = POISON_COOLDOWN_INIT;
-            }
-        }
-    }
-    
-    void updatePoisonFood() {
-        if (!hasPoisonFood) {
-            if (poisonCooldown > 0) {
-                --poisonCooldown;
-            } else {
-                spawnPoisonFood();
-            }
-        }
-    }
-    
-    void updateFoods() {
-        updateSpecialFood();
-        updatePoisonFood();
-    }
-    
-    int getLevel() const {
-        return foodsEaten / FOODS_PER_LEVEL + 1;
-    }
-    
-    int calculateSpeed() const {
-        int level = getLevel();
-        int speed = BASE_SPEED - (level - 1) * SPEED_STEP;
-        if (speed < MIN_SPEED) speed = MIN_SPEED;
-        return speed;
-    }
-    
-    int getAdjustedSpeed() const {
-        int baseSpeed = calculateSpeed();
-        if (speedMode == 1) baseSpeed = static_cast<int>(baseSpeed * 1.5);
-        else if (speedMode == 3) baseSpeed = static_cast<int>(baseSpeed * 0.7);
-        if (snake.getDirection().y != 0) {
-            return static_cast<int>(baseSpeed * 1.8);
-        }
-        return baseSpeed;
-    }
-    
     void drawBoard() {
-        setCursorPosition(0, 0);
-        for (int i = 0; i < BOARD_WIDTH; i++) {
-            cout << WALL;
-        }
-        cout << endl;
-        
-        const vector<Position>& body = snake.getBody();
+        // Terrain and items come from the engine's cell grids and the snake
+        // is stamped on top once, so no cell is compared against every item
+        // or segment
+        const LevelMap& level = game.getLevelMap();
+        const vector<Position>& body = game.getSnake().getBody();
+        const ItemLayer& items = game.getItems();
         char bodyChar = (tickCount % 2 == 0 ? SNAKE_BODY : 'o');
-        
-        for (int y = 1; y < BOARD_HEIGHT - 1; y++) {
-            cout << WALL;
-            for (int x = 1; x < BOARD_WIDTH - 1; x++) {
-                Position pos(x, y);
-                if (pos == body[0]) {
-                    cout << SNAKE_HEAD;
-                } else if (pos == food) {
-                    cout << FOOD;
-                } else if (hasSpecialFood && pos == specialFood) {
-                    cout << SPECIAL_FOOD;
-                } else if (hasPoisonFood && pos == poisonFood) {
-                    cout << POISON_FOOD;
-                } else {
-                    bool isSnakeBody = false;
-                    for (size_t i = 1; i < body.size(); i++) {
-                        if (body[i] == pos) {
-                            cout << bodyChar;
-                            isSnakeBody = true;
-                            break;
-                        }
-                    }
-                    if (!isSnakeBody) {
-                        cout << EMPTY;
-                    }
-                }
+        int width = level.width();
+        int height = level.height();
+        cells.resize(width * height);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint32_t cell = y * width + x;
+                if (level.isWall(cell)) cells[cell] = WALL;
+                else if (level.isPortal(cell)) cells[cell] = PORTAL;
+                else cells[cell] = items.glyphAt(x, y);
             }
-            cout << WALL;
-            cout << endl;
         }
-        
-        for (int i = 0; i < BOARD_WIDTH; i++) {
-            cout << WALL;
+        for (size_t i = 1; i < body.size(); i++) {
+            char& cell = cells[body[i].y * width + body[i].x];
+            if (cell == EMPTY) cell = bodyChar;
         }
-        cout << endl;
+        cells[body[0].y * width + body[0].x] = SNAKE_HEAD;
+        
+        GlyphRenderer::markBoard(frame.text(), &cells[0], width, height);
     }
     
     void drawUI() {
-        int level = getLevel();
-        cout << "\n";
-        cout << "  Score: " << setw(6) << score;
-        cout << "  |  High Score: " << setw(6) << highScore;
-        cout << "  |  Level: " << setw(3) << level;
-        cout << "  |  Length: " << setw(3) << snake.getBody().size();
-        cout << "\n";
+        int level = game.getLevel();
+        int score = game.getScore();
+        bool gameOver = game.isGameOver();
+        bool gamePaused = game.isPaused();
+        int speedMode = game.getSpeedMode();
+        frame << "\n";
+        frame << "  Score: " << padded(score, 6);
+        frame << "  |  High Score: " << padded(highScore, 6);
+        frame << "  |  Level: " << padded(level, 3);
+        frame << "  |  Length: " << padded(game.getSnake().getBody().size(), 3);
+        frame << "\n";
         
-        cout << "  Mode: " << (easyMode ? "Easy " : "Normal ")
-             << (wrapMode ? "| Wrap " : "| NoWrap ")
+        frame << "  Mode: " << (game.isEasyMode() ? "Easy " : "Normal ")
+             << (game.isWrapMode() ? "| Wrap " : "| NoWrap ")
              << "| Speed: " << (speedMode == 1 ? "Slow" : (speedMode == 2 ? "Normal" : "Fast")) << "\n";
         
-        if (hasSpecialFood && !gameOver && !gamePaused) {
-            cout << "  " << SPECIAL_FOOD << " = " << SPECIAL_SCORE << " points (limited time)\n";
+        if (game.specialFoodActive() && !gameOver && !gamePaused) {
+            frame << "  ";
+            GlyphRenderer::markCell(frame.text(), SPECIAL_FOOD);
+            frame << " = " << SPECIAL_SCORE << " points (limited time)\n";
         }
-        if (hasPoisonFood && !gameOver && !gamePaused) {
-            cout << "  " << POISON_FOOD << " = -" << POISON_PENALTY << " points, snake shrinks\n";
+        if (game.poisonFoodActive() && !gameOver && !gamePaused) {
+            frame << "  ";
+            GlyphRenderer::markCell(frame.text(), POISON_FOOD);
+            frame << " = -" << POISON_PENALTY << " points, snake shrinks\n";
+        }
+        
+        if (practice) {
+            frame << "  [PRACTICE] Rewind used - this score will not be recorded ("
+                  << history.ticksAvailable(game) << " ticks, "
+                  << history.memoryBytes() << " bytes of history)\n";
         }
         
         if (gamePaused && !gameOver) {
-            cout << "  [PAUSED] P=Resume | S=Save | L=Load | Q=Quit\n";
+            frame << "  [PAUSED] P=Resume | B=Step back | S=Save | L=Load | Q=Quit\n";
         }
         
         if (gameOver) {
-            cout << "\n";
-            cout << "  ========================================\n";
-            cout << "  |         GAME OVER!                  |\n";
-            cout << "  |         Final Score: " << setw(6) << score << "      |\n";
-            cout << "  |         Level Reached: " << setw(3) << level << "        |\n";
-            cout << "  ========================================\n";
+            frame << "\n";
+            frame << "  ========================================\n";
+            if (game.isBoardFilled()) {
+                frame << "  |         BOARD FILLED!               |\n";
+            } else {
+                frame << "  |         GAME OVER!                  |\n";
+            }
+            frame << "  |         Final Score: " << padded(score, 6) << "      |\n";
+            frame << "  |         Level Reached: " << padded(level, 3) << "        |\n";
+            frame << "  ========================================\n";
             if (score > highScore) {
-                cout << "  *** NEW HIGH SCORE! ***\n";
+                frame << "  *** NEW HIGH SCORE! ***\n";
             }
-            cout << "  Press 'R' to restart or 'Q' to quit\n";
+            frame << "  Press 'R' to restart, hold 'B' to rewind or 'Q' to quit\n";
         } else if (!gamePaused) {
-            cout << "  Controls: Arrow Keys or WASD | P=Pause | Q=Quit\n";
+            frame << "  Controls: Arrow Keys or WASD | P=Pause | B=Rewind (hold) | Q=Quit\n";
+        }
+        
+        if (profiler.showHud()) {
+            profiler.appendHudLine(frame.text());
+            frame << '\n';
+            appendTerminalHudLine();
+            appendAllocationHudLine();
+            if (autopilot) {
+                frame << "  [ai] mcts " << autopilot->playouts() << " playouts/move on "
+                      << autopilot->threadCount() << " thread(s)\n";
+            }
+            if (solver) {
+                frame << "  [ai] hamilton cycle of " << solver->cycleLength() << " cells, "
+                      << solver->shortcutsTaken() << " shortcuts in " << solver->decisionsMade() << " moves\n";
+            }
         }
     }
     
-    bool checkCollision(const Position& head) {
-        if (!wrapMode) {
-            if (head.x <= 0 || head.x >= BOARD_WIDTH - 1 ||
-                head.y <= 0 || head.y >= BOARD_HEIGHT - 1) {
-                return true;
+    void update() {
+        if (rewound) {
+            rewound = false;
+            return;
+        }
+        if (aiPlaying() && !game.isPaused() && !game.isGameOver()) steer();
+        Position dir = game.getSnake().getDirection();
+        uint64_t tick = game.getTick();
+        bool ended = game.update();
+        if (game.getTick() != tick) {
+            history.record(game, dir);
+            replays.record(game, dir);
+        }
+        if (ended) replays.finish(true);
+        // Games the AI played stay off the leaderboard
+        if (ended && !practice && !aiPlaying()) {
+            int score = game.getScore();
+            if (score > highScore) {
+                highScore = score;
+            }
+            if (score > 0) {
+                scoreTracker.saveScore(score, &replays.lastRecord());
             }
         }
-        if (snake.hitsSelf(head)) {
-            return true;
-        }
-        return false;
-    }
-    
-    bool handleFoodCollision(const Position& head) {
-        if (hasSpecialFood && head == specialFood) {
-            score += SPECIAL_SCORE;
-            foodsEaten++;
-            hasSpecialFood = false;
-            food = generateFood();
-            return true;
-        } else if (hasPoisonFood && head == poisonFood) {
-            score -= POISON_PENALTY;
-            if (score < 0) score = 0;
-            hasPoisonFood = false;
-            snake.shrink(3);
-            poisonCooldown = POISON_COOLDOWN_INIT;
-            return false;
-        } else if (head == food) {
-            score += FOOD_SCORE;
-            foodsEaten++;
-            food = generateFood();
-            spawnSpecialFood();
-            spawnPoisonFood();
-            return true;
-        }
-        return false;
-    }
-    
-    void handleCollisionInEasyMode() {
-        score -= 50;
-        if (score < 0) score = 0;
-        snake = Snake(BOARD_WIDTH / 2, BOARD_HEIGHT / 2);
-        foodsEaten = 0;
-        hasSpecialFood = false;
-        hasPoisonFood = false;
-        specialFoodTimer = 0;
-        specialCooldown = SPECIAL_COOLDOWN_INIT;
-        poisonCooldown = POISON_COOLDOWN_INIT;
-        food = generateFood();
     }
     
-    void update() {
-        if (gameOver || gamePaused) return;
-        
-        updateFoods();
-        
-        Position dir = snake.getDirection();
-        Position newHead = snake.head();
-        newHead.x += dir.x;
-        newHead.y += dir.y;
-        
-        if (wrapMode) {
-            if (newHead.x <= 0) newHead.x = BOARD_WIDTH - 2;
-            else if (newHead.x >= BOARD_WIDTH - 1) newHead.x = 1;
-            if (newHead.y <= 0) newHead.y = BOARD_HEIGHT - 2;
-            else if (newHead.y >= BOARD_HEIGHT - 1) newHead.y = 1;
+    bool aiPlaying() const { return autopilot != NULL || solver != NULL; }
+    
+    // Lets the search spend half of this tick, at most 50ms, choosing the
+    // next move
+    void steer() {
+        if (solver) {
+            int d = solver->choose(game);
+            game.setDirection(Position(LEVEL_DX[d], LEVEL_DY[d]));
+            return;
         }
-        
-        if (checkCollision(newHead)) {
-            if (easyMode) {
-                handleCollisionInEasyMode();
-                return;
-            } else {
-                gameOver = true;
-                if (score > highScore) {
-                    highScore = score;
-                }
-                if (score > 0) {
-                    scoreTracker.saveScore(score);
-                }
-                return;
+        SimState root;
+        if (!root.load(game, simImage)) return;
+        int d = autopilot->choose(root, std::min(game.getAdjustedSpeed() / 2, 50000));
+        game.setDirection(Position(LEVEL_DX[d], LEVEL_DY[d]));
+    }
+    
+    // Steps back one tick per 'B' received. Autorepeat queues the key faster
+    // than ticks run, so the queued repeats are consumed together and the
+    // rewind stops as soon as the key is released.
+    void rewind() {
+        uint64_t steps = 1;
+        char next;
+        while (keys.pop(next)) {
+            if (next != 'b' && next != 'B') {
+                deferredKey = next;
+                break;
             }
+            ++steps;
+        }
+        bool paused = game.isPaused();
+        if (history.rewind(game, steps)) {
+            practice = true;
+            replays.abandon();
+            rewound = true;
+            game.setPaused(paused);
         }
-        
-        bool grew = handleFoodCollision(newHead);
-        snake.moveTo(newHead, grew);
     }
     
     bool saveGame() {
         ofstream file(saveFileName);
         if (!file.is_open()) return false;
-        
-        file << score << " " << foodsEaten << " "
-             << easyMode << " " << wrapMode << " " << speedMode << " "
-             << hasSpecialFood << " " << specialFood.x << " " << specialFood.y << " "
-             << specialFoodTimer << " " << specialCooldown << " "
-             << hasPoisonFood << " " << poisonFood.x << " " << poisonFood.y << " "
-             << poisonCooldown << "\n";
-        
-        file << food.x << " " << food.y << "\n";
-        
-        const vector<Position>& body = snake.getBody();
-        file << body.size() << "\n";
-        for (const auto& seg : body) {
-            file << seg.x << " " << seg.y << "\n";
-        }
-        Position dir = snake.getDirection();
-        file << dir.x << " " << dir.y << "\n";
-        
+        game.save(file);
         return true;
     }
     
     bool loadGame() {
         ifstream file(saveFileName);
         if (!file.is_open()) return false;
-        
-        int easyFlag, wrapFlag;
-        int hasSpec, hasPois;
-        file >> score >> foodsEaten
-             >> easyFlag >> wrapFlag >> speedMode
-             >> hasSpec >> specialFood.x >> specialFood.y
-             >> specialFoodTimer >> specialCooldown
-             >> hasPois >> poisonFood.x >> poisonFood.y
-             >> poisonCooldown;
-        
-        easyMode = (easyFlag != 0);
-        wrapMode = (wrapFlag != 0);
-        hasSpecialFood = (hasSpec != 0);
-        hasPoisonFood = (hasPois != 0);
-        
-        file >> food.x >> food.y;
-        
-        size_t len;
-        file >> len;
-        vector<Position> body;
-        body.reserve(len);
-        for (size_t i = 0; i < len; ++i) {
-            Position p;
-            file >> p.x >> p.y;
-            body.push_back(p);
-        }
-        Position dir;
-        file >> dir.x >> dir.y;
-        
-        if (!file) return false;
-        
-        snake.setBodyAndDirection(body, dir);
-        gameOver = false;
-        gamePaused = false;
+        if (!game.load(file)) return false;
+        history.start(game);
+        replays.begin(game, levelPath, aiPlaying(), 0);
+        practice = false;
         tickCount = 0;
         highScore = scoreTracker.getHighScore();
-        
         return true;
     }
     
     void handleInput() {
-        if (!terminal.kbhit()) return;
-        
-        char key = terminal.getch();
+        char key = deferredKey;
+        deferredKey = 0;
+        if (key == 0 && !keys.pop(key)) return;
         
-        if (gamePaused && !gameOver) {
+        if (game.isPaused() && !game.isGameOver()) {
             if (key >= 'A' && key <= 'Z') key = key + 32;
             switch (key) {
                 case 'p':
-                    gamePaused = false;
+                    game.setPaused(false);
+                    return;
+                case 'b':
+                    rewind();
                     return;
                 case 's':
                     saveGame();
                     return;
                 case 'l':
-                    if (loadGame()) gamePaused = false;
+                    if (loadGame()) game.setPaused(false);
                     return;
                 case 'q':
-                    showCursor();
-                    exit(0);
+                    running = false;
+                    return;
             }
             return;
         }
         
-        if (key == '\033') {
-            terminal.getch();
-            char arrow = terminal.getch();
-            switch (arrow) {
-                case 'A':
-                    snake.setDirection(Position(0, -1));
-                    break;
-                case 'B':
-                    snake.setDirection(Position(0, 1));
-                    break;
-                case 'C':
-                    snake.setDirection(Position(1, 0));
-                    break;
-                case 'D':
-                    snake.setDirection(Position(-1, 0));
-                    break;
-            }
-            return;
+        switch (key) {
+            case KEY_ARROW_UP:
+                game.setDirection(Position(0, -1));
+                return;
+            case KEY_ARROW_DOWN:
+                game.setDirection(Position(0, 1));
+                return;
+            case KEY_ARROW_RIGHT:
+                game.setDirection(Position(1, 0));
+                return;
+            case KEY_ARROW_LEFT:
+                game.setDirection(Position(-1, 0));
+                return;
         }
         
         if (key >= 'A' && key <= 'Z') {
@@ -657,44 +476,44 @@ private:
         
         switch (key) {
             case 'w':
-                snake.setDirection(Position(0, -1));
+                game.setDirection(Position(0, -1));
                 break;
             case 's':
-                snake.setDirection(Position(0, 1));
+                game.setDirection(Position(0, 1));
                 break;
             case 'a':
-                snake.setDirection(Position(-1, 0));
+                game.setDirection(Position(-1, 0));
                 break;
             case 'd':
-                snake.setDirection(Position(1, 0));
+                game.setDirection(Position(1, 0));
                 break;
             case 'p':
-                if (!gameOver) gamePaused = !gamePaused;
+                if (!game.isGameOver()) game.setPaused(!game.isPaused());
                 break;
             case 'r':
-                if (gameOver) {
+                if (game.isGameOver()) {
                     reset();
                 }
                 break;
+            case 'b':
+                rewind();
+                break;
             case 'q':
-                showCursor();
-                exit(0);
+                running = false;
                 break;
         }
     }
     
     void reset() {
-        snake = Snake(BOARD_WIDTH / 2, BOARD_HEIGHT / 2);
-        score = 0;
-        foodsEaten = 0;
-        gameOver = false;
-        gamePaused = false;
-        hasSpecialFood = false;
-        hasPoisonFood = false;
-        specialFoodTimer = 0;
-        specialCooldown = SPECIAL_COOLDOWN_INIT;
-        poisonCooldown = POISON_COOLDOWN_INIT;
-        food = generateFood();
+        // Every game starts from its own seed, so a replay of it can be
+        // rebuilt from the seed alone and checked
+        uint64_t seed = seeds.next() | static_cast<uint64_t>(seeds.next()) << 32;
+        game.seed(seed);
+        game.reset();
+        history.start(game);
+        replays.begin(game, levelPath, aiPlaying(), seed);
+        practice = false;
+        rewound = false;
         tickCount = 0;
         highScore = scoreTracker.getHighScore();
     }
@@ -715,10 +534,8 @@ private:
         while (c < '1' || c > '4') {
             c = waitForKey();
         }
-        if (c == '1') { easyMode = false; wrapMode = false; }
-        else if (c == '2') { easyMode = true; wrapMode = false; }
-        else if (c == '3') { easyMode = false; wrapMode = true; }
-        else { easyMode = true; wrapMode = true; }
+        bool easyMode = (c == '2' || c == '4');
+        bool wrapMode = (c == '3' || c == '4');
         
         clearScreen();
         cout << "============================================\n";
@@ -734,42 +551,370 @@ private:
         while (c < '1' || c > '3') {
             c = waitForKey();
         }
-        if (c == '1') speedMode = 1;
-        else if (c == '2') speedMode = 2;
-        else speedMode = 3;
+        game.setModes(easyMode, wrapMode, c - '0');
         
         reset();
     }
     
+    // Input thread: decodes keystrokes, arrow escapes included, into the
+    // key queue so the simulation never reads the terminal itself. It sleeps
+    // in poll() until a key or the stop signal arrives.
+    void inputLoop() {
+        int escape = 0;
+        while (!pipelineStopping.load(std::memory_order_relaxed)) {
+            struct pollfd pfd[2];
+            pfd[0].fd = STDIN_FILENO;
+            pfd[0].events = POLLIN;
+            pfd[1].fd = inputStopFd;
+            pfd[1].events = POLLIN;
+            if (poll(pfd, 2, -1) <= 0 || !(pfd[0].revents & POLLIN)) continue;
+            char buf[64];
+            ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+            for (ssize_t i = 0; i < n; ++i) {
+                char c = buf[i];
+                if (escape == 1) {
+                    escape = (c == '[' || c == 'O') ? 2 : 0;
+                    continue;
+                }
+                if (escape == 2) {
+                    escape = 0;
+                    if (c == 'A') keys.push(KEY_ARROW_UP);
+                    else if (c == 'B') keys.push(KEY_ARROW_DOWN);
+                    else if (c == 'C') keys.push(KEY_ARROW_RIGHT);
+                    else if (c == 'D') keys.push(KEY_ARROW_LEFT);
+                    continue;
+                }
+                if (c == '\033') escape = 1;
+                else keys.push(c);
+            }
+            if (n > 0) notify(inputWakeFd);
+        }
+    }
+    
+    // Bytes written to the terminal but not yet taken by whatever reads it
+    // (the emulator, sshd, tmux). Zero when stdout is not a terminal.
+    static int terminalBacklog() {
+        int queued = 0;
+        if (ioctl(STDOUT_FILENO, TIOCOUTQ, &queued) < 0) return 0;
+        return queued;
+    }
+    
+    // Render thread: writes whichever frame is newest when the terminal is
+    // ready for it. Stdout is non-blocking, so a slow link shows up as a
+    // partial write or a growing output queue instead of a stalled thread.
+    // While either lasts no new frame is started; the frames published
+    // meanwhile are coalesced into the newest one and counted as dropped.
+    void renderLoop() {
+        uint64_t startAllocations = threadAllocations();
+        const FrameSnapshot* current = NULL;
+        size_t offset = 0;
+        uint64_t lastTick = 0;
+        bool wroteAny = false;
+        uint64_t frameStart = 0;
+        uint64_t drainAverage = 0;
+        uint64_t windowStart = monotonicNanos();
+        uint64_t windowFrames = 0;
+        while (true) {
+            bool stopping = pipelineStopping.load(std::memory_order_acquire);
+            struct pollfd pfd[2];
+            pfd[0].fd = renderWakeFd;
+            pfd[0].events = POLLIN;
+            pfd[1].fd = STDOUT_FILENO;
+            pfd[1].events = POLLOUT;
+            int backlog = terminalBacklog();
+            frameStats.backlogBytes.store(backlog, std::memory_order_relaxed);
+            // A whole frame still queued downstream: let it drain rather
+            // than pile another one behind it
+            bool congested = !stopping && backlog > 0 && static_cast<size_t>(backlog) >= lastFrameSize();
+            if (current) {
+                if (stopping && stdoutFlags != -1) {
+                    // The last frame (the game over screen) is always
+                    // finished, so it is written blocking
+                    fcntl(STDOUT_FILENO, F_SETFL, stdoutFlags & ~O_NONBLOCK);
+                }
+                ssize_t n = write(STDOUT_FILENO, current->text.data() + offset, current->text.size() - offset);
+                if (n > 0) offset += n;
+                if (offset < current->text.size()) {
+                    if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                        current = NULL;
+                    } else {
+                        poll(pfd, 2, -1);
+                    }
+                } else {
+                    current = NULL;
+                    uint64_t drain = monotonicNanos() - frameStart;
+                    drainAverage = drainAverage ? (drainAverage * 7 + drain) / 8 : drain;
+                    frameStats.drainMicros.store(static_cast<uint32_t>(drainAverage / 1000), std::memory_order_relaxed);
+                    frameStats.written.fetch_add(1, std::memory_order_relaxed);
+                    ++windowFrames;
+                }
+            } else if (congested) {
+                poll(pfd, 1, 5);
+            } else {
+                // Idle until the next frame; spectators need a pump now and
+                // then to accept new viewers
+                poll(pfd, 1, stopping ? 0 : (spectators ? 100 : -1));
+            }
+            uint64_t wakeups;
+            if (read(renderWakeFd, &wakeups, sizeof(wakeups)) < 0) wakeups = 0;
+            
+            if (!current && !congested && frames.consume()) {
+                const FrameSnapshot& snap = frames.readSlot();
+                if (wroteAny && snap.tick > lastTick + 1) {
+                    frameStats.dropped.fetch_add(snap.tick - lastTick - 1, std::memory_order_relaxed);
+                }
+                lastTick = snap.tick;
+                wroteAny = true;
+                current = &snap;
+                offset = 0;
+                frameStart = monotonicNanos();
+                if (spectators) spectators->publish(snap.cells.data(), snap.cells.size());
+                recorder.record(snap.cells.data(), snap.cells.size());
+            }
+            if (spectators) spectators->pump();
+            frameStats.allocations.store(threadAllocations() - startAllocations, std::memory_order_relaxed);
+            
+            uint64_t now = monotonicNanos();
+            if (now - windowStart >= 1000000000ULL) {
+                frameStats.fpsTenths.store(static_cast<uint32_t>(windowFrames * 10000000000ULL / (now - windowStart)),
+                                           std::memory_order_relaxed);
+                windowStart = now;
+                windowFrames = 0;
+            }
+            if (stopping && !current) break;
+        }
+    }
+    
+    size_t lastFrameSize() const {
+        size_t size = frames.readSlot().text.size();
+        return size ? size : 1;
+    }
+    
+    void appendTerminalHudLine() {
+        char buf[160];
+        uint32_t fps = frameStats.fpsTenths.load(std::memory_order_relaxed);
+        snprintf(buf, sizeof(buf), "  [term] %u.%u fps | written %llu dropped %llu | queued %uB | drain %.1fms\n",
+                 fps / 10, fps % 10,
+                 (unsigned long long)frameStats.written.load(std::memory_order_relaxed),
+                 (unsigned long long)frameStats.dropped.load(std::memory_order_relaxed),
+                 frameStats.backlogBytes.load(std::memory_order_relaxed),
+                 frameStats.drainMicros.load(std::memory_order_relaxed) / 1000.0);
+        frame << buf;
+    }
+    
+    // Heap allocations by the simulation thread during the last tick (this
+    // one is still being composed) and since the game started ticking, and
+    // by the render thread overall
+    void appendAllocationHudLine() {
+        char buf[160];
+        snprintf(buf, sizeof(buf), "  [alloc] %llu last tick | %llu in %llu ticks | render %llu\n",
+                 (unsigned long long)lastTickAllocations, (unsigned long long)tickAllocations,
+                 (unsigned long long)allocationTicks,
+                 (unsigned long long)frameStats.allocations.load(std::memory_order_relaxed));
+        frame << buf;
+    }
+    
+    void startPipeline() {
+        cout.flush();
+        stdoutFlags = fcntl(STDOUT_FILENO, F_GETFL);
+        if (stdoutFlags != -1) fcntl(STDOUT_FILENO, F_SETFL, stdoutFlags | O_NONBLOCK);
+        renderWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        inputWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        inputStopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        pipelineStopping.store(false);
+        inputThread = std::thread(&SnakeGame::inputLoop, this);
+        renderThread = std::thread(&SnakeGame::renderLoop, this);
+    }
+    
+    void stopPipeline() {
+        pipelineStopping.store(true, std::memory_order_release);
+        wakeRenderer();
+        notify(inputStopFd);
+        if (renderThread.joinable()) renderThread.join();
+        if (inputThread.joinable()) inputThread.join();
+        close(renderWakeFd);
+        close(inputWakeFd);
+        close(inputStopFd);
+        renderWakeFd = inputWakeFd = inputStopFd = -1;
+        // Back to the flags startPipeline found. Stdin usually shares the
+        // terminal's file description, which TerminalInput has already made
+        // non-blocking; the menus read escape sequences that way
+        if (stdoutFlags != -1) fcntl(STDOUT_FILENO, F_SETFL, stdoutFlags);
+    }
+    
+    void wakeRenderer() { notify(renderWakeFd); }
+    
+    static void notify(int eventFd) {
+        uint64_t one = 1;
+        if (write(eventFd, &one, sizeof(one)) < 0) {
+            // Counter saturated: the reader is already due to wake
+        }
+    }
+    
+    // Paused or game over: nothing on screen changes until a key arrives
+    bool idle() const {
+        return (game.isPaused() || game.isGameOver()) && deferredKey == 0;
+    }
+    
+    // Blocks the simulation until the input thread has queued a key
+    void waitForQueuedKey() {
+        while (running) {
+            uint64_t wakeups;
+            if (read(inputWakeFd, &wakeups, sizeof(wakeups)) < 0) wakeups = 0;
+            if (!keys.empty()) return;
+            struct pollfd pfd;
+            pfd.fd = inputWakeFd;
+            pfd.events = POLLIN;
+            poll(&pfd, 1, -1);
+        }
+    }
+    
+    // Sleeps to an absolute deadline so ticks keep their cadence no matter
+    // how long the tick itself took. After a long stall (a suspended
+    // process, say) the schedule restarts instead of bursting to catch up.
+    // Returns how far past the deadline the tick ran, in microseconds; 0 or
+    // less when it finished in time.
+    static long sleepUntilNextTick(struct timespec& deadline, int periodMicros) {
+        deadline.tv_nsec += static_cast<long>(periodMicros) * 1000;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long lagMicros = (now.tv_sec - deadline.tv_sec) * 1000000L + (now.tv_nsec - deadline.tv_nsec) / 1000;
+        if (lagMicros > periodMicros) {
+            deadline = now;
+            return lagMicros;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+        }
+        return lagMicros;
+    }
+    
+    void noteOverrun(long lagMicros) {
+        if (lagMicros <= 0) return;
+        ++liveSample.overruns;
+        liveSample.lastOverrunMicros = static_cast<uint64_t>(lagMicros);
+        if (liveSample.lastOverrunMicros > liveSample.maxOverrunMicros) {
+            liveSample.maxOverrunMicros = liveSample.lastOverrunMicros;
+        }
+    }
+    
+    // Plain stores into shared memory; see live_metrics.h
+    void publishLive(size_t frameBytes) {
+        if (!live.isOpen()) return;
+        liveSample.tick = static_cast<uint64_t>(game.getTick());
+        liveSample.score = static_cast<uint64_t>(game.getScore());
+        liveSample.length = game.getSnake().getBody().size();
+        liveSample.level = static_cast<uint64_t>(game.getLevel());
+        liveSample.state = game.isGameOver() ? LIVE_OVER : game.isPaused() ? LIVE_PAUSED : LIVE_PLAYING;
+        liveSample.modeFlags = (game.isEasyMode() ? LIVE_EASY : 0) | (game.isWrapMode() ? LIVE_WRAP : 0) |
+                               static_cast<uint64_t>(game.getSpeedMode()) << 4;
+        liveSample.periodMicros = static_cast<uint64_t>(game.getAdjustedSpeed());
+        liveSample.frameBytes = frameBytes;
+        liveSample.frameBytesTotal += frameBytes;
+        ++liveSample.frames;
+        liveSample.updatedNanos = monotonicNanos();
+        live.publish(liveSample);
+    }
+    
 public:
-    SnakeGame()
-        : snake(BOARD_WIDTH / 2, BOARD_HEIGHT / 2),
-          score(0),
+    SnakeGame(const GameOptions& options = GameOptions())
+        : game(static_cast<uint64_t>(time(0)) ^ (static_cast<uint64_t>(getpid()) << 32)),
           highScore(0),
-          foodsEaten(0),
-          hasSpecialFood(false),
-          hasPoisonFood(false),
-          specialFoodTimer(0),
-          specialCooldown(SPECIAL_COOLDOWN_INIT),
-          poisonCooldown(POISON_COOLDOWN_INIT),
-          gameOver(false),
-          gamePaused(false),
           scoreTracker("scores.txt"),
-          easyMode(false),
-          wrapMode(false),
-          speedMode(2),
           saveFileName("savegame.txt"),
-          tickCount(0) {
-        srand(time(0));
+          tickCount(0),
+          running(true),
+          history(static_cast<uint64_t>(options.rewindSeconds > 0 ? options.rewindSeconds : 0) *
+                  1000000 / MIN_SPEED),
+          practice(false),
+          rewound(false),
+          deferredKey(0),
+          spectators(NULL),
+          autopilot(NULL),
+          solver(NULL),
+          tickAllocations(0),
+          lastTickAllocations(0),
+          allocationTicks(0),
+          seeds(static_cast<uint64_t>(time(0)) ^ (static_cast<uint64_t>(getpid()) << 40)),
+          pipelineStopping(false),
+          renderWakeFd(-1),
+          inputWakeFd(-1),
+          inputStopFd(-1),
+          stdoutFlags(-1) {
+        glyphs.configure(options.colorMode, options.unicode);
+        if (options.debugHud) profiler.enableHud();
+        if (!options.traceFile.empty()) profiler.enableTrace(options.traceFile);
+        if (!options.spectateAddress.empty()) {
+            spectators = new SpectatorHub(options.spectateAddress, glyphs);
+            if (!spectators->start()) {
+                cerr << "Cannot open spectator endpoint " << options.spectateAddress << "\n";
+                delete spectators;
+                spectators = NULL;
+            }
+        }
+        if (!options.recordFile.empty() && !recorder.open(options.recordFile, glyphs)) {
+            cerr << "Cannot open recording " << options.recordFile << "\n";
+        }
+        if (!options.replayFile.empty() && !replays.open(options.replayFile)) {
+            cerr << "Cannot open replay file " << options.replayFile << "\n";
+        }
+        levelPath = options.levelPath;
+        game.setFoodCount(options.foods);
+        if (options.level) game.setLevel(options.level);
+        reserveBuffers();
+        if (options.ai == "mcts") {
+            if (SimState::fits(game.getLevelMap(), game.getFoodCount())) {
+                autopilot = new MctsController(options.aiThreads);
+            } else {
+                cerr << "Board too large for the AI; playing by hand\n";
+                usleep(1000000);
+            }
+        } else if (options.ai == "hamilton") {
+            if (HamiltonSolver::fits(game.getLevelMap())) {
+                solver = new HamiltonSolver(game.getLevelMap());
+            } else {
+                cerr << "The solver needs a plain board with an even side; playing by hand\n";
+                usleep(1000000);
+            }
+        }
+        if (options.live) {
+            memset(&liveSample, 0, sizeof(liveSample));
+            string mode = autopilot ? "ai mcts" : solver ? "ai hamilton" : "solo";
+            if (!levelPath.empty() && levelPath.compare(0, 5, "size:") != 0) {
+                size_t slash = levelPath.rfind('/');
+                mode += " " + (slash == string::npos ? levelPath : levelPath.substr(slash + 1));
+            }
+            // A monitor is a nice-to-have; the game runs the same without one
+            live.open(game.getLevelMap().width(), game.getLevelMap().height(), mode);
+        }
         scoreTracker.loadScores();
         reset();
         hideCursor();
     }
     
     ~SnakeGame() {
+        replays.finish(false);
+        delete spectators;
+        delete autopilot;
+        delete solver;
         showCursor();
     }
     
+    // Sizes every buffer a tick touches for the largest game this board
+    // can hold, so once play starts a tick allocates nothing
+    void reserveBuffers() {
+        game.reserveCapacity();
+        simImage.reserve(game.stateBytesBound());
+        const LevelMap& level = game.getLevelMap();
+        size_t boardBytes = glyphs.maxBoardBytes(level.width(), level.height());
+        cells.reserve(static_cast<size_t>(level.width()) * level.height());
+        for (int i = 0; i < 3; ++i) {
+            frames.slot(i).cells.reserve(cells.capacity() + level.height() + 2048);
+            frames.slot(i).text.reserve(boardBytes + 2048);
+        }
+    }
+    
     void run() {
         clearScreen();
         cout << "  ============================================\n";
@@ -797,23 +942,188 @@ public:
             configureModes();
         }
         
-        while (true) {
+        // This thread is the simulation: it never touches the terminal, so
+        // a slow write cannot delay the next tick
+        startPipeline();
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        while (running) {
+            uint64_t allocationsBefore = threadAllocations();
+            profiler.beginTick();
             handleInput();
+            profiler.mark(PHASE_INPUT);
+            if (!running) break;
             update();
+            profiler.mark(PHASE_UPDATE);
             
-            clearScreen();
+            FrameSnapshot& snap = frames.writeSlot();
+            frame.begin(snap.cells);
             drawBoard();
             drawUI();
+            snap.text.assign("\033[2J\033[H");
+            glyphs.appendCells(snap.text, snap.cells.data(), snap.cells.size());
+            snap.tick = tickCount;
+            profiler.mark(PHASE_COMPOSE);
             
-            int currentSpeed = getAdjustedSpeed();
-            usleep(currentSpeed);
+            frames.publish();
+            wakeRenderer();
+            profiler.mark(PHASE_WRITE);
+            
+            int currentSpeed = game.getAdjustedSpeed();
+            bool waiting = idle() && keys.empty();
+            publishLive(snap.text.size());
+            lastTickAllocations = threadAllocations() - allocationsBefore;
+            tickAllocations += lastTickAllocations;
+            ++allocationTicks;
+            if (waiting) {
+                // The frame just drawn stays valid until a key arrives, so
+                // sleep on the input thread instead of redrawing every tick
+                waitForQueuedKey();
+                clock_gettime(CLOCK_MONOTONIC, &deadline);
+                profiler.skipPeriod();
+                ++tickCount;
+                continue;
+            }
+            noteOverrun(sleepUntilNextTick(deadline, currentSpeed));
+            profiler.mark(PHASE_SLEEP);
+            profiler.endTick(currentSpeed);
             ++tickCount;
         }
+        stopPipeline();
     }
 };
 
-int main() {
-    SnakeGame game;
+int main(int argc, char* argv[]) {
+    GameOptions options;
+    LevelMap level;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--hud") {
+            options.debugHud = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            options.traceFile = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            options.recordFile = argv[++i];
+        } else if (arg == "--replays" && i + 1 < argc) {
+            options.replayFile = argv[++i];
+        } else if (arg == "--server" && i + 1 < argc) {
+            options.serverAddress = argv[++i];
+        } else if (arg == "--connect" && i + 1 < argc) {
+            options.connectAddress = argv[++i];
+        } else if (arg == "--spectate" && i + 1 < argc) {
+            options.spectateAddress = argv[++i];
+        } else if (arg == "--watch" && i + 1 < argc) {
+            options.watchAddress = argv[++i];
+        } else if (arg == "--telnet" && i + 1 < argc) {
+            options.telnetAddress = argv[++i];
+        } else if (arg == "--max-sessions" && i + 1 < argc) {
+            options.maxSessions = atoi(argv[++i]);
+        } else if (arg == "--telnet-load" && i + 1 < argc) {
+            options.telnetLoadAddress = argv[++i];
+        } else if (arg == "--sessions" && i + 1 < argc) {
+            options.loadSessions = atoi(argv[++i]);
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            options.loadSeconds = atoi(argv[++i]);
+        } else if (arg == "--bot") {
+            options.botClient = true;
+        } else if (arg == "--ticks" && i + 1 < argc) {
+            options.maxTicks = atol(argv[++i]);
+        } else if (arg == "--tick-ms" && i + 1 < argc) {
+            options.tickMicros = atoi(argv[++i]) * 1000;
+        } else if (arg == "--foods" && i + 1 < argc) {
+            options.foods = atoi(argv[++i]);
+        } else if (arg == "--rewind" && i + 1 < argc) {
+            options.rewindSeconds = atoi(argv[++i]);
+        } else if (arg == "--ai" && i + 1 < argc &&
+                   (string(argv[i + 1]) == "mcts" || string(argv[i + 1]) == "hamilton")) {
+            options.ai = argv[++i];
+        } else if (arg == "--ai-threads" && i + 1 < argc) {
+            options.aiThreads = atoi(argv[++i]);
+        } else if (arg == "--arena" && i + 1 < argc) {
+            options.arenaSnakes = atoi(argv[++i]);
+        } else if (arg == "--endless") {
+            options.endless = true;
+        } else if (arg == "--no-live") {
+            options.live = false;
+        } else if (arg == "--color" && i + 1 < argc &&
+                   GlyphRenderer::parseColorMode(argv[i + 1], options.colorMode)) {
+            ++i;
+        } else if (arg == "--unicode") {
+            options.unicode = true;
+        } else if (arg == "--solve-bench" && i + 1 < argc) {
+            options.solveBenchGames = atoi(argv[++i]);
+        } else if (arg == "--size" && i + 1 < argc) {
+            int w = 0, h = 0;
+            string error = "board size must be WIDTHxHEIGHT";
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2 || !level.plain(w, h, error)) {
+                cerr << error << "\n";
+                return 1;
+            }
+            options.level = &level;
+            options.levelPath = string("size:") + argv[i];
+        } else if (arg == "--level" && i + 1 < argc) {
+            string error;
+            if (!level.load(argv[++i], error)) {
+                cerr << error << "\n";
+                return 1;
+            }
+            options.level = &level;
+            // Replays name the level; make that work from any directory
+            char resolved[PATH_MAX];
+            options.levelPath = realpath(argv[i], resolved) ? resolved : argv[i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--hud] [--trace file.json] [--spectate ADDR] [--foods N]\n"
+                 << "             [--level file.lvl] [--rewind SECONDS] [--record file.cast]\n"
+                 << "             [--size WxH] [--ai mcts|hamilton] [--ai-threads N] [--replays file.rpl]\n"
+                 << "             [--no-live] [--color 256|truecolor] [--unicode]\n"
+                 << "       " << argv[0] << " --solve-bench GAMES [--size WxH | --level file.lvl]\n"
+                 << "       " << argv[0] << " --server ADDR [--tick-ms N] [--ticks N]\n"
+                 << "       " << argv[0] << " --connect ADDR [--bot] [--ticks N]\n"
+                 << "       " << argv[0] << " --arena SNAKES [--tick-ms N] [--ai-threads N]\n"
+                 << "       " << argv[0] << " --endless [--tick-ms N]\n"
+                 << "       " << argv[0] << " --watch ADDR\n"
+                 << "       " << argv[0] << " --telnet ADDR [--max-sessions N]\n"
+                 << "       " << argv[0] << " --telnet-load ADDR [--sessions N] [--seconds N]\n"
+                 << "  ADDR is a TCP port on localhost or a Unix socket path\n";
+            return 1;
+        }
+    }
+    
+    if (!options.serverAddress.empty()) {
+        if (options.tickMicros <= 0) options.tickMicros = BASE_SPEED;
+        MultiplayerServer server(options.serverAddress, options.tickMicros, options.maxTicks);
+        return server.run();
+    }
+    if (!options.connectAddress.empty()) {
+        MultiplayerClient client(options.connectAddress, options.botClient, options.maxTicks);
+        return client.run();
+    }
+    if (!options.watchAddress.empty()) {
+        return watchSpectatorStream(options.watchAddress);
+    }
+    if (!options.telnetAddress.empty()) {
+        TelnetServer server(options.telnetAddress, options.maxSessions);
+        return server.run();
+    }
+    if (!options.telnetLoadAddress.empty()) {
+        return runTelnetLoad(options.telnetLoadAddress, options.loadSessions, options.loadSeconds);
+    }
+    if (options.arenaSnakes > 0) {
+        int threads = options.aiThreads > 0 ? options.aiThreads : static_cast<int>(std::thread::hardware_concurrency());
+        ArenaGame arena(options.arenaSnakes, options.tickMicros, threads);
+        return arena.run();
+    }
+    if (options.solveBenchGames > 0) {
+        const LevelMap& board = options.level ? *options.level : LevelMap::standard();
+        return runSolverBench(board, options.solveBenchGames,
+                              static_cast<uint64_t>(time(0)) ^ (static_cast<uint64_t>(getpid()) << 32));
+    }
+    if (options.endless) {
+        EndlessGame endless(static_cast<uint64_t>(time(0)) ^ (static_cast<uint64_t>(getpid()) << 32), options.tickMicros);
+        return endless.run();
+    }
+    
+    SnakeGame game(options);
     game.run();
     return 0;
 }
@@ -0,0 +1,42 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "live_metrics.h"
+
+using namespace std;
+
+// Lists the games running on this machine from their live counters in
+// shared memory (see live_metrics.h). Reading never blocks or slows a
+// game, so it can be left running next to them with --watch.
+//
+// Games that died without cleaning up are shown as "gone"; --clean
+// removes their objects.
+
+int main(int argc, char* argv[]) {
+    int watchSeconds = 0;
+    bool clean = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--watch") {
+            watchSeconds = 1;
+            if (i + 1 < argc && argv[i + 1][0] != '-') watchSeconds = atoi(argv[++i]);
+        } else if (arg == "--clean") {
+            clean = true;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--watch [SECONDS]] [--clean]\n"
+                 << "  Shows every running snake_game; --watch redraws until interrupted\n";
+            return 1;
+        }
+    }
+    if (watchSeconds <= 0) {
+        cout << formatLiveGames(listLiveGames(clean));
+        return 0;
+    }
+    while (true) {
+        string table = formatLiveGames(listLiveGames(clean));
+        cout << "\033[2J\033[H" << table << flush;
+        sleep(static_cast<unsigned>(watchSeconds));
+    }
+}
@@ -0,0 +1,246 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <poll.h>
+#include "glyph_renderer.h"
+#include "net_util.h"
+
+// Splits a screen of cells (lines separated by '\n') into its lines
+inline void splitScreenLines(const char* text, size_t len, std::vector<std::string>& lines) {
+    lines.clear();
+    size_t start = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (text[i] == '\n') {
+            lines.push_back(std::string(text + start, i - start));
+            start = i + 1;
+        }
+    }
+    if (start < len) lines.push_back(std::string(text + start, len - start));
+}
+
+// Turns successive screens of cells into terminal byte streams: a keyframe
+// repaints everything, a diff only rewrites the changed span of each line.
+// Lines are compared cell by cell, so a span's column is its cell offset;
+// each span is drawn through the renderer, opening with its own color and
+// resetting after it.
+class ScreenDiffEncoder {
+public:
+    explicit ScreenDiffEncoder(const GlyphRenderer& glyphs = GlyphRenderer()) : glyphs(glyphs) {}
+
+    void encodeKeyframe(const std::vector<std::string>& lines, std::string& out) const {
+        out = "\033[?25l\033[H\033[2J";
+        for (size_t i = 0; i < lines.size(); ++i) {
+            glyphs.appendCells(out, lines[i].data(), lines[i].size());
+            out += "\r\n";
+        }
+    }
+
+    void encodeDiff(const std::vector<std::string>& previous,
+                    const std::vector<std::string>& lines, std::string& out) const {
+        out.clear();
+        size_t rows = lines.size() > previous.size() ? lines.size() : previous.size();
+        for (size_t row = 0; row < rows; ++row) {
+            static const std::string none;
+            const std::string& oldLine = row < previous.size() ? previous[row] : none;
+            const std::string& newLine = row < lines.size() ? lines[row] : none;
+            if (oldLine == newLine) continue;
+            size_t first = 0;
+            while (first < oldLine.size() && first < newLine.size() && oldLine[first] == newLine[first]) {
+                ++first;
+            }
+            size_t oldEnd = oldLine.size();
+            size_t newEnd = newLine.size();
+            if (oldEnd == newEnd) {
+                while (newEnd > first && oldLine[newEnd - 1] == newLine[newEnd - 1]) --newEnd;
+            }
+            char pos[32];
+            snprintf(pos, sizeof(pos), "\033[%u;%uH", static_cast<unsigned>(row + 1),
+                     static_cast<unsigned>(first + 1));
+            out += pos;
+            glyphs.appendCells(out, newLine.data() + first, newEnd - first);
+            if (newLine.size() < oldLine.size()) out += "\033[K";
+        }
+    }
+
+private:
+    GlyphRenderer glyphs;
+};
+
+// Fans rendered frames out to any number of socket viewers. Every frame is
+// encoded once and the same immutable buffer is queued for all viewers. A
+// viewer whose queue grows past its budget loses its backlog and resumes at
+// the next keyframe, so nothing here ever blocks or buffers without bound.
+class SpectatorHub {
+public:
+    static const size_t MAX_PENDING_BYTES = 64 * 1024;
+    static const int KEYFRAME_INTERVAL = 200;
+
+    SpectatorHub(const std::string& address, const GlyphRenderer& glyphs)
+        : addr(address), listenFd(-1), encoder(glyphs), framesSinceKeyframe(0),
+          framesPublished(0), framesDropped(0) {}
+
+    ~SpectatorHub() {
+        for (size_t i = 0; i < viewers.size(); ++i) close(viewers[i].fd);
+        if (listenFd >= 0) {
+            close(listenFd);
+            if (isUnixAddress(addr)) unlink(addr.c_str());
+        }
+    }
+
+    bool start() {
+        listenFd = listenOn(addr);
+        return listenFd >= 0;
+    }
+
+    size_t viewerCount() const { return viewers.size(); }
+    unsigned long dropped() const { return framesDropped; }
+
+    // Takes the screen as cells (lines separated by '\n')
+    void publish(const char* text, size_t len) {
+        splitScreenLines(text, len, current);
+        ++framesPublished;
+        bool anyWaiting = false;
+        bool anyLive = false;
+        for (size_t i = 0; i < viewers.size(); ++i) {
+            if (viewers[i].needKeyframe) anyWaiting = true;
+            else anyLive = true;
+        }
+        bool periodic = ++framesSinceKeyframe >= KEYFRAME_INTERVAL;
+        FramePtr key;
+        if (anyWaiting || periodic) {
+            std::string* encoded = new std::string();
+            encoder.encodeKeyframe(current, *encoded);
+            key = FramePtr(encoded);
+            framesSinceKeyframe = 0;
+        }
+        FramePtr diff;
+        if (anyLive && !periodic) {
+            std::string* encoded = new std::string();
+            encoder.encodeDiff(previous, current, *encoded);
+            if (!encoded->empty()) diff = FramePtr(encoded);
+            else delete encoded;
+        }
+        for (size_t i = 0; i < viewers.size(); ++i) {
+            Viewer& v = viewers[i];
+            const FramePtr& frame = v.needKeyframe || periodic ? key : diff;
+            if (!frame) continue;
+            if (v.pendingBytes + frame->size() > MAX_PENDING_BYTES && !v.needKeyframe) {
+                dropBacklog(v);
+                continue;
+            }
+            v.queue.push_back(frame);
+            v.pendingBytes += frame->size();
+            v.needKeyframe = false;
+        }
+        previous.swap(current);
+    }
+
+    // Accepts new viewers and writes whatever each socket takes right now
+    void pump() {
+        if (listenFd < 0) return;
+        while (true) {
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd < 0) break;
+            setNonBlocking(fd);
+            setNoDelay(fd);
+            Viewer v;
+            v.fd = fd;
+            v.offset = 0;
+            v.pendingBytes = 0;
+            v.needKeyframe = true;
+            viewers.push_back(v);
+        }
+        for (size_t i = 0; i < viewers.size();) {
+            if (flush(viewers[i])) {
+                ++i;
+            } else {
+                close(viewers[i].fd);
+                viewers.erase(viewers.begin() + i);
+            }
+        }
+    }
+
+private:
+    typedef std::shared_ptr<const std::string> FramePtr;
+
+    struct Viewer {
+        int fd;
+        std::deque<FramePtr> queue;
+        size_t offset;
+        size_t pendingBytes;
+        bool needKeyframe;
+    };
+
+    std::string addr;
+    int listenFd;
+    ScreenDiffEncoder encoder;
+    std::vector<std::string> previous;
+    std::vector<std::string> current;
+    std::vector<Viewer> viewers;
+    int framesSinceKeyframe;
+    unsigned long framesPublished;
+    unsigned long framesDropped;
+
+    // Keeps a partially written frame so the viewer's terminal never sees a
+    // torn escape sequence, discards the rest and waits for a keyframe
+    void dropBacklog(Viewer& v) {
+        framesDropped += v.queue.size();
+        if (v.offset > 0 && !v.queue.empty()) {
+            FramePtr partial = v.queue.front();
+            v.queue.clear();
+            v.queue.push_back(partial);
+            v.pendingBytes = partial->size() - v.offset;
+            --framesDropped;
+        } else {
+            v.queue.clear();
+            v.pendingBytes = 0;
+        }
+        v.needKeyframe = true;
+    }
+
+    bool flush(Viewer& v) {
+        while (!v.queue.empty()) {
+            const std::string& frame = *v.queue.front();
+            ssize_t n = sendSome(v.fd, frame.data() + v.offset, frame.size() - v.offset);
+            if (n < 0) return false;
+            if (n == 0) return true;
+            v.offset += n;
+            v.pendingBytes -= n;
+            if (v.offset == frame.size()) {
+                v.queue.pop_front();
+                v.offset = 0;
+            }
+        }
+        // Nothing queued: notice viewers that hung up
+        char buf[64];
+        ssize_t n = recv(v.fd, buf, sizeof(buf), MSG_DONTWAIT);
+        return n != 0 && (n > 0 || errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+    }
+};
+
+// Minimal viewer so spectating does not require nc or socat
+inline int watchSpectatorStream(const std::string& address) {
+    int fd = connectTo(address);
+    if (fd < 0) {
+        std::cerr << "Cannot connect to " << address << "\n";
+        return 1;
+    }
+    char buf[16384];
+    while (true) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        std::cout.write(buf, n);
+        std::cout.flush();
+    }
+    close(fd);
+    std::cout << "\033[?25h\r\nStream ended.\r\n";
+    return 0;
+}
+
+#endif
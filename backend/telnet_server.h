@@ -0,0 +1,522 @@
+#ifndef TELNET_SERVER_H
+#define TELNET_SERVER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <stdint.h>
+#include "game_engine.h"
+#include "net_util.h"
+#include "timer_wheel.h"
+
+// One process, one epoll loop, many single-player games over a telnet
+// compatible text protocol. Each session is a GameEngine plus a few fields
+// of render state; its next tick sits in a timer wheel at the game's own
+// getAdjustedSpeed(), so idle sessions cost nothing between ticks.
+//
+// Players type w/a/s/d (or arrows), p, r, m (cycle mode) and q, with or
+// without Enter. The board is painted once and then updated cell by cell,
+// which is why the body is drawn with a single character here.
+
+const size_t TELNET_OUTPUT_LIMIT = 16 * 1024;
+const int TELNET_STATUS_ROW = BOARD_HEIGHT + 2;
+const int TELNET_MESSAGE_ROW = BOARD_HEIGHT + 3;
+
+inline uint64_t telnetNowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+struct TelnetSession {
+    GameEngine game;
+    std::string out;
+    size_t outPos;
+    int fd;
+    int best;
+    int lastScore;
+    int lastLevel;
+    uint16_t lastLength;
+    Position lastHead;
+    Position lastTail;
+    bool wasOver;
+    bool wasPaused;
+    bool needsRepaint;
+    bool wantsWrite;
+    uint8_t inputState;
+    uint8_t mode;
+
+    TelnetSession() : outPos(0), fd(-1), best(0), lastScore(-1), lastLevel(0), lastLength(0),
+                      wasOver(false), wasPaused(false),
+                      needsRepaint(true), wantsWrite(false), inputState(0), mode(0) {}
+};
+
+class TelnetServer {
+public:
+    TelnetServer(const std::string& address, size_t maxSessionCount)
+        : addr(address), maxSessions(maxSessionCount), listenFd(-1), epollFd(-1),
+          active(0), wheel(telnetNowMs()), ticks(0), bytesOut(0), lastReportMs(0) {}
+
+    ~TelnetServer() {
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            if (sessions[i].fd >= 0) close(sessions[i].fd);
+        }
+        if (epollFd >= 0) close(epollFd);
+        if (listenFd >= 0) {
+            close(listenFd);
+            if (isUnixAddress(addr)) unlink(addr.c_str());
+        }
+    }
+
+    int run() {
+        raiseFileLimit();
+        listenFd = listenOn(addr, 4096);
+        epollFd = epoll_create1(0);
+        if (listenFd < 0 || epollFd < 0) {
+            std::cerr << "Cannot listen on " << addr << "\n";
+            return 1;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = LISTEN_ID;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+        std::cout << "Telnet server on " << addr << " (up to " << maxSessions << " sessions)\n";
+
+        std::vector<struct epoll_event> events(1024);
+        lastReportMs = telnetNowMs();
+        getrusage(RUSAGE_SELF, &lastUsage);
+        TickFire fire(*this);
+        while (true) {
+            int timeout = wheel.msUntilNext(100);
+            int n = epoll_wait(epollFd, &events[0], static_cast<int>(events.size()), timeout);
+            for (int i = 0; i < n; ++i) {
+                uint32_t id = events[i].data.u32;
+                if (id == LISTEN_ID) {
+                    acceptSessions();
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) readInput(id);
+                if (id < sessions.size() && sessions[id].fd >= 0 && (events[i].events & EPOLLOUT)) {
+                    flush(id);
+                }
+            }
+            uint64_t now = telnetNowMs();
+            wheel.advance(now, fire);
+            if (now - lastReportMs >= 1000) report(now);
+        }
+        return 0;
+    }
+
+private:
+    static const uint32_t LISTEN_ID = 0xFFFFFFFFu;
+
+    struct TickFire {
+        TelnetServer& server;
+        explicit TickFire(TelnetServer& s) : server(s) {}
+        void operator()(uint32_t id) { server.tick(id); }
+    };
+
+    std::string addr;
+    size_t maxSessions;
+    int listenFd;
+    int epollFd;
+    size_t active;
+    std::vector<TelnetSession> sessions;
+    std::vector<uint32_t> freeIds;
+    TimerWheel wheel;
+    uint64_t ticks;
+    uint64_t bytesOut;
+    uint64_t lastReportMs;
+    struct rusage lastUsage;
+
+    static void raiseFileLimit() {
+        struct rlimit lim;
+        if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+            lim.rlim_cur = lim.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &lim);
+        }
+    }
+
+    void acceptSessions() {
+        while (true) {
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd < 0) return;
+            if (active >= maxSessions) {
+                const char msg[] = "Server full, try again later.\r\n";
+                sendSome(fd, msg, sizeof(msg) - 1);
+                close(fd);
+                continue;
+            }
+            setNonBlocking(fd);
+            setNoDelay(fd);
+            uint32_t id;
+            if (!freeIds.empty()) {
+                id = freeIds.back();
+                freeIds.pop_back();
+            } else {
+                id = static_cast<uint32_t>(sessions.size());
+                sessions.push_back(TelnetSession());
+            }
+            TelnetSession& s = sessions[id];
+            s = TelnetSession();
+            s.fd = fd;
+            s.game.seed(telnetNowMs() * 2654435761u + id);
+            s.game.reset();
+            ++active;
+
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u32 = id;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+            render(s);
+            flush(id);
+            if (sessions[id].fd >= 0) wheel.schedule(id, wheel.now() + s.game.getAdjustedSpeed() / 1000);
+        }
+    }
+
+    void closeSession(uint32_t id) {
+        TelnetSession& s = sessions[id];
+        if (s.fd < 0) return;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, s.fd, NULL);
+        close(s.fd);
+        s.fd = -1;
+        wheel.cancel(id);
+        std::string().swap(s.out);
+        s.game = GameEngine();
+        freeIds.push_back(id);
+        --active;
+    }
+
+    void tick(uint32_t id) {
+        TelnetSession& s = sessions[id];
+        if (s.fd < 0) return;
+        ++ticks;
+        s.game.update();
+        if (s.game.getScore() > s.best) s.best = s.game.getScore();
+        render(s);
+        flush(id);
+        if (s.fd >= 0) wheel.schedule(id, wheel.now() + s.game.getAdjustedSpeed() / 1000);
+    }
+
+    void readInput(uint32_t id) {
+        if (id >= sessions.size() || sessions[id].fd < 0) return;
+        TelnetSession& s = sessions[id];
+        unsigned char buf[256];
+        ssize_t n = recv(s.fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            closeSession(id);
+            return;
+        }
+        bool changed = false;
+        for (ssize_t i = 0; i < n && s.fd >= 0; ++i) {
+            if (handleByte(id, buf[i])) changed = true;
+        }
+        if (changed && s.fd >= 0) {
+            render(s);
+            flush(id);
+        }
+    }
+
+    // Input states: 0 text, 1 after ESC, 2 after ESC [, 3 after IAC,
+    // 4 IAC option byte, 5 inside IAC subnegotiation, 6 IAC inside it
+    bool handleByte(uint32_t id, unsigned char c) {
+        TelnetSession& s = sessions[id];
+        switch (s.inputState) {
+            case 1:
+                s.inputState = (c == '[' || c == 'O') ? 2 : 0;
+                return false;
+            case 2:
+                s.inputState = 0;
+                if (c == 'A') return command(id, 'w');
+                if (c == 'B') return command(id, 's');
+                if (c == 'C') return command(id, 'd');
+                if (c == 'D') return command(id, 'a');
+                return false;
+            case 3:
+                if (c >= 251 && c <= 254) s.inputState = 4;
+                else if (c == 250) s.inputState = 5;
+                else s.inputState = 0;
+                return false;
+            case 4:
+                s.inputState = 0;
+                return false;
+            case 5:
+                if (c == 255) s.inputState = 6;
+                return false;
+            case 6:
+                s.inputState = (c == 240) ? 0 : 5;
+                return false;
+        }
+        if (c == 27) {
+            s.inputState = 1;
+            return false;
+        }
+        if (c == 255) {
+            s.inputState = 3;
+            return false;
+        }
+        if (c >= 'A' && c <= 'Z') c = c + 32;
+        return command(id, static_cast<char>(c));
+    }
+
+    bool command(uint32_t id, char c) {
+        TelnetSession& s = sessions[id];
+        GameEngine& g = s.game;
+        switch (c) {
+            case 'w': g.setDirection(Position(0, -1)); return false;
+            case 's': g.setDirection(Position(0, 1)); return false;
+            case 'a': g.setDirection(Position(-1, 0)); return false;
+            case 'd': g.setDirection(Position(1, 0)); return false;
+            case 'p':
+                if (!g.isGameOver()) g.setPaused(!g.isPaused());
+                return true;
+            case 'r':
+                if (!g.isGameOver()) return false;
+                g.reset();
+                s.needsRepaint = true;
+                return true;
+            case 'm':
+                s.mode = (s.mode + 1) % 4;
+                g.setModes(s.mode == 1 || s.mode == 3, s.mode >= 2, 2);
+                g.reset();
+                s.needsRepaint = true;
+                return true;
+            case 'q':
+                closeSession(id);
+                return false;
+        }
+        return false;
+    }
+
+    static void moveTo(std::string& out, int x, int y) {
+        char buf[24];
+        int n = snprintf(buf, sizeof(buf), "\033[%d;%dH", y + 1, x + 1);
+        out.append(buf, n);
+    }
+
+    static void putCell(std::string& out, const Position& p, char c) {
+        moveTo(out, p.x, p.y);
+        out += c;
+    }
+
+    // Appends either a full repaint or the cells that changed since the
+    // last call. Frames are skipped while the client is too far behind.
+    void render(TelnetSession& s) {
+        if (s.out.size() - s.outPos > TELNET_OUTPUT_LIMIT) {
+            s.needsRepaint = true;
+            return;
+        }
+        if (s.needsRepaint && s.outPos < s.out.size()) return;
+        const GameEngine& g = s.game;
+        const vector<Position>& body = g.getSnake().getBody();
+        uint16_t length = static_cast<uint16_t>(body.size());
+        bool moved = !s.needsRepaint && length >= 1 &&
+                     ((length == s.lastLength && (length == 1 || body[1] == s.lastHead)) ||
+                      (length == s.lastLength + 1 && body[1] == s.lastHead));
+        bool still = !s.needsRepaint && length == s.lastLength && body[0] == s.lastHead &&
+                     body.back() == s.lastTail;
+
+        if (!moved && !still) {
+            repaint(s);
+        } else if (moved && !still) {
+            if (length == s.lastLength) putCell(s.out, s.lastTail, EMPTY);
+            drawItems(s);
+            if (length > 1) putCell(s.out, s.lastHead, SNAKE_BODY);
+            putCell(s.out, body[0], SNAKE_HEAD);
+        }
+        drawStatus(s, !moved && !still);
+        remember(s);
+    }
+
+    void repaint(TelnetSession& s) {
+        const GameEngine& g = s.game;
+        std::vector<char> cells(BOARD_WIDTH * BOARD_HEIGHT, EMPTY);
+        for (int y = 0; y < BOARD_HEIGHT; ++y) {
+            for (int x = 0; x < BOARD_WIDTH; ++x) {
+                if (x == 0 || y == 0 || x == BOARD_WIDTH - 1 || y == BOARD_HEIGHT - 1) {
+                    cells[y * BOARD_WIDTH + x] = WALL;
+                }
+            }
+        }
+        const vector<Position>& body = g.getSnake().getBody();
+        for (size_t i = 1; i < body.size(); ++i) cells[body[i].y * BOARD_WIDTH + body[i].x] = SNAKE_BODY;
+        const ItemLayer& items = g.getItems();
+        for (size_t i = 0; i < items.size(); ++i) {
+            cells[items[i].pos.y * BOARD_WIDTH + items[i].pos.x] = itemGlyph(items[i].type);
+        }
+        cells[body[0].y * BOARD_WIDTH + body[0].x] = SNAKE_HEAD;
+        s.out += "\033[?25l\033[H\033[2J";
+        for (int y = 0; y < BOARD_HEIGHT; ++y) {
+            s.out.append(&cells[y * BOARD_WIDTH], BOARD_WIDTH);
+            s.out += "\r\n";
+        }
+        s.needsRepaint = false;
+    }
+
+    // Redraws only the cells whose item changed during the last tick; the
+    // snake is drawn afterwards so an item eaten under the head stays hidden
+    void drawItems(TelnetSession& s) {
+        const ItemLayer& items = s.game.getItems();
+        const std::vector<Position>& changed = items.changes();
+        for (size_t i = 0; i < changed.size(); ++i) {
+            putCell(s.out, changed[i], items.glyphAt(changed[i].x, changed[i].y));
+        }
+    }
+
+    void drawStatus(TelnetSession& s, bool force) {
+        const GameEngine& g = s.game;
+        char buf[160];
+        if (force || g.getScore() != s.lastScore || g.getLevel() != s.lastLevel ||
+            g.getSnake().getBody().size() != s.lastLength) {
+            moveTo(s.out, 0, TELNET_STATUS_ROW);
+            int n = snprintf(buf, sizeof(buf), "  Score: %6d  |  Best: %6d  |  Level: %3d  |  Length: %3u\033[K",
+                             g.getScore(), s.best, g.getLevel(),
+                             static_cast<unsigned>(g.getSnake().getBody().size()));
+            s.out.append(buf, n);
+        }
+        if (force || g.isGameOver() != s.wasOver || g.isPaused() != s.wasPaused) {
+            static const char* modes[4] = {"Normal", "Easy", "Wrap", "Easy+Wrap"};
+            moveTo(s.out, 0, TELNET_MESSAGE_ROW);
+            const char* text;
+            if (g.isGameOver()) text = "  GAME OVER! R=Restart  M=Mode  Q=Quit";
+            else if (g.isPaused()) text = "  [PAUSED] P=Resume  Q=Quit";
+            else text = "  WASD/arrows (+Enter) to steer  P=Pause  M=Mode  Q=Quit";
+            int n = snprintf(buf, sizeof(buf), "%s  [%s]\033[K", text, modes[s.mode]);
+            s.out.append(buf, n);
+        }
+    }
+
+    void remember(TelnetSession& s) {
+        const GameEngine& g = s.game;
+        const vector<Position>& body = g.getSnake().getBody();
+        s.lastLength = static_cast<uint16_t>(body.size());
+        s.lastHead = body[0];
+        s.lastTail = body.back();
+        s.lastScore = g.getScore();
+        s.lastLevel = g.getLevel();
+        s.wasOver = g.isGameOver();
+        s.wasPaused = g.isPaused();
+    }
+
+    void flush(uint32_t id) {
+        TelnetSession& s = sessions[id];
+        while (s.outPos < s.out.size()) {
+            ssize_t n = sendSome(s.fd, s.out.data() + s.outPos, s.out.size() - s.outPos);
+            if (n < 0) {
+                closeSession(id);
+                return;
+            }
+            if (n == 0) break;
+            s.outPos += n;
+            bytesOut += n;
+        }
+        bool pending = s.outPos < s.out.size();
+        if (!pending) {
+            s.out.clear();
+            s.outPos = 0;
+            if (s.needsRepaint) {
+                render(s);
+                if (!s.out.empty()) {
+                    flush(id);
+                    return;
+                }
+            }
+        }
+        if (pending != s.wantsWrite) {
+            struct epoll_event ev;
+            ev.events = EPOLLIN | (pending ? EPOLLOUT : 0);
+            ev.data.u32 = id;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, s.fd, &ev);
+            s.wantsWrite = pending;
+        }
+    }
+
+    void report(uint64_t now) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        double elapsed = (now - lastReportMs) / 1000.0;
+        double used = (usage.ru_utime.tv_sec - lastUsage.ru_utime.tv_sec) +
+                      (usage.ru_stime.tv_sec - lastUsage.ru_stime.tv_sec) +
+                      (usage.ru_utime.tv_usec - lastUsage.ru_utime.tv_usec) / 1e6 +
+                      (usage.ru_stime.tv_usec - lastUsage.ru_stime.tv_usec) / 1e6;
+        double cpu = 100.0 * used / elapsed;
+        std::printf("\r  sessions %zu  ticks/s %.0f  KB/s out %.0f  cpu %.0f%%  maxrss %ld MB      ",
+                    active, ticks / elapsed, bytesOut / 1024.0 / elapsed, cpu, usage.ru_maxrss / 1024);
+        std::fflush(stdout);
+        lastUsage = usage;
+        ticks = 0;
+        bytesOut = 0;
+        lastReportMs = now;
+    }
+};
+
+// Opens many sessions against a telnet server and plays them randomly,
+// for checking how many games one server process can carry
+inline int runTelnetLoad(const std::string& address, int sessionCount, int seconds) {
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+    int ep = epoll_create1(0);
+    std::vector<int> fds;
+    for (int i = 0; i < sessionCount; ++i) {
+        int fd = connectTo(address);
+        if (fd < 0) {
+            std::cerr << "Connected " << i << " sessions before failing\n";
+            break;
+        }
+        setNonBlocking(fd);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = static_cast<uint32_t>(fds.size());
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+        fds.push_back(fd);
+    }
+    std::cout << "Opened " << fds.size() << " sessions\n";
+    GameRng rng(telnetNowMs());
+    std::vector<struct epoll_event> events(1024);
+    uint64_t start = telnetNowMs();
+    uint64_t lastSteer = start;
+    uint64_t received = 0;
+    size_t open = fds.size();
+    char buf[65536];
+    while (telnetNowMs() - start < static_cast<uint64_t>(seconds) * 1000 && open > 0) {
+        int n = epoll_wait(ep, &events[0], static_cast<int>(events.size()), 20);
+        for (int i = 0; i < n; ++i) {
+            int& fd = fds[events[i].data.u32];
+            ssize_t got = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (got > 0) {
+                received += got;
+            } else if (got == 0) {
+                close(fd);
+                fd = -1;
+                --open;
+            }
+        }
+        uint64_t now = telnetNowMs();
+        if (now - lastSteer >= 100) {
+            static const char* keys[6] = {"w\r\n", "a\r\n", "s\r\n", "d\r\n", "r\r\n", "d\r\n"};
+            for (size_t i = 0; i < fds.size(); ++i) {
+                if (fds[i] < 0 || rng.below(5) != 0) continue;
+                const char* k = keys[rng.below(6)];
+                sendSome(fds[i], k, 3);
+            }
+            lastSteer = now;
+        }
+    }
+    double elapsed = (telnetNowMs() - start) / 1000.0;
+    std::printf("%zu sessions still open, %.1f KB/s received (%.0f bytes/s per session)\n",
+                open, received / 1024.0 / elapsed, fds.empty() ? 0.0 : received / elapsed / fds.size());
+    for (size_t i = 0; i < fds.size(); ++i) {
+        if (fds[i] >= 0) close(fds[i]);
+    }
+    close(ep);
+    return 0;
+}
+
+#endif
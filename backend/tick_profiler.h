@@ -0,0 +1,250 @@
+#ifndef TICK_PROFILER_H
+#define TICK_PROFILER_H
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Phases of one run() iteration, in the order they happen
+enum TickPhase {
+    PHASE_INPUT,
+    PHASE_UPDATE,
+    PHASE_COMPOSE,
+    PHASE_WRITE,
+    PHASE_SLEEP,
+    PHASE_COUNT
+};
+
+inline const char* tickPhaseName(int phase) {
+    static const char* names[PHASE_COUNT] = {"input", "update", "compose", "write", "sleep"};
+    return names[phase];
+}
+
+inline uint64_t monotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// Log-linear (HDR style) histogram of nanosecond durations.
+// Values are bucketed with 4 significant bits (~6% error) up to ~36 minutes.
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 5;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int HALF_COUNT = SUB_COUNT / 2;
+    static const int MAX_SHIFT = 36;
+    static const int BUCKETS = (MAX_SHIFT + 2) * HALF_COUNT;
+
+    LatencyHistogram() { clear(); }
+
+    void clear() {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        maxValue = 0;
+    }
+
+    void record(uint64_t ns) {
+        ++counts[bucketFor(ns)];
+        ++total;
+        if (ns > maxValue) maxValue = ns;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < BUCKETS; ++i) counts[i] += other.counts[i];
+        total += other.total;
+        if (other.maxValue > maxValue) maxValue = other.maxValue;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxValue; }
+
+    // p in [0, 1]; returns the upper bound of the bucket holding that rank
+    uint64_t percentile(double p) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(p * total + 0.5);
+        if (rank < 1) rank = 1;
+        if (rank > total) rank = total;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                uint64_t upper = bucketUpper(i);
+                return upper < maxValue ? upper : maxValue;
+            }
+        }
+        return maxValue;
+    }
+
+private:
+    uint32_t counts[BUCKETS];
+    uint64_t total;
+    uint64_t maxValue;
+
+    static int bucketFor(uint64_t v) {
+        if (v < static_cast<uint64_t>(SUB_COUNT)) return static_cast<int>(v);
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BITS + 1;
+        if (shift > MAX_SHIFT) return BUCKETS - 1;
+        return shift * HALF_COUNT + static_cast<int>(v >> shift);
+    }
+
+    static uint64_t bucketUpper(int index) {
+        if (index < SUB_COUNT) return static_cast<uint64_t>(index);
+        int shift = index / HALF_COUNT - 1;
+        uint64_t sub = index % HALF_COUNT + HALF_COUNT;
+        return ((sub + 1) << shift) - 1;
+    }
+};
+
+// Fixed-size ring of completed phase spans, dumped as Chrome trace-event JSON
+class TraceRing {
+public:
+    struct Event {
+        uint64_t start;
+        uint32_t duration;
+        uint32_t tick;
+        uint8_t phase;
+    };
+
+    explicit TraceRing(size_t capacity = 1 << 16) : events(capacity), next(0), wrapped(false) {}
+
+    void push(int phase, uint64_t start, uint64_t end, uint32_t tick) {
+        Event& e = events[next];
+        e.start = start;
+        e.duration = static_cast<uint32_t>(end - start);
+        e.tick = tick;
+        e.phase = static_cast<uint8_t>(phase);
+        if (++next == events.size()) {
+            next = 0;
+            wrapped = true;
+        }
+    }
+
+    bool writeJson(const std::string& path, uint64_t origin) const {
+        FILE* out = fopen(path.c_str(), "w");
+        if (!out) return false;
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+        fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+              "\"args\":{\"name\":\"snake_game\"}}", out);
+        size_t count = wrapped ? events.size() : next;
+        size_t first = wrapped ? next : 0;
+        for (size_t i = 0; i < count; ++i) {
+            const Event& e = events[(first + i) % events.size()];
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                         "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"tick\":%u}}",
+                    tickPhaseName(e.phase), (e.start - origin) / 1000.0,
+                    e.duration / 1000.0, e.tick);
+        }
+        fputs("\n]}\n", out);
+        return fclose(out) == 0;
+    }
+
+private:
+    std::vector<Event> events;
+    size_t next;
+    bool wrapped;
+};
+
+// Per-phase tick timing. When neither the HUD nor tracing is enabled every
+// call is a single predictable branch, so the game loop pays nothing.
+class TickProfiler {
+public:
+    TickProfiler() : enabled(false), hudVisible(false), tracing(false),
+                     trace(0), phaseStart(0), origin(0), lastTickStart(0),
+                     tick(0), targetPeriod(0) {}
+
+    ~TickProfiler() {
+        if (tracing) {
+            trace->writeJson(tracePath, origin);
+        }
+        delete trace;
+    }
+
+    void enableHud() {
+        hudVisible = true;
+        enabled = true;
+    }
+
+    void enableTrace(const std::string& path) {
+        tracePath = path;
+        if (!trace) trace = new TraceRing();
+        tracing = true;
+        enabled = true;
+    }
+
+    bool showHud() const { return hudVisible; }
+
+    void beginTick() {
+        if (!enabled) return;
+        uint64_t now = monotonicNanos();
+        if (origin == 0) origin = now;
+        if (lastTickStart != 0) periodHist.record(now - lastTickStart);
+        lastTickStart = now;
+        phaseStart = now;
+    }
+
+    // Closes the phase that started at the previous mark (or beginTick)
+    void mark(TickPhase phase) {
+        if (!enabled) return;
+        uint64_t now = monotonicNanos();
+        phases[phase].record(now - phaseStart);
+        if (tracing) trace->push(phase, phaseStart, now, tick);
+        phaseStart = now;
+    }
+
+    void endTick(int targetMicros) {
+        if (!enabled) return;
+        targetPeriod = targetMicros;
+        ++tick;
+    }
+
+    // The next tick follows an idle wait, so its period is not a sample
+    void skipPeriod() { lastTickStart = 0; }
+
+    // Appends the HUD line to out; no temporaries, so a frame string with
+    // room to spare is not reallocated
+    void appendHudLine(std::string& out) const {
+        out += "  [perf]";
+        char buf[64];
+        char p50[24];
+        char p99[24];
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            formatMicros(phases[p].percentile(0.5), p50, sizeof(p50));
+            formatMicros(phases[p].percentile(0.99), p99, sizeof(p99));
+            snprintf(buf, sizeof(buf), " %s %s/%s", tickPhaseName(p), p50, p99);
+            out += buf;
+        }
+        snprintf(buf, sizeof(buf), " | tick %.1f/%.1fms p99 %.1fms",
+                 periodHist.percentile(0.5) / 1e6, targetPeriod / 1e3,
+                 periodHist.percentile(0.99) / 1e6);
+        out += buf;
+    }
+
+private:
+    bool enabled;
+    bool hudVisible;
+    bool tracing;
+    TraceRing* trace;
+    std::string tracePath;
+    LatencyHistogram phases[PHASE_COUNT];
+    LatencyHistogram periodHist;
+    uint64_t phaseStart;
+    uint64_t origin;
+    uint64_t lastTickStart;
+    uint32_t tick;
+    int targetPeriod;
+
+    TickProfiler(const TickProfiler&);
+    TickProfiler& operator=(const TickProfiler&);
+
+    static void formatMicros(uint64_t ns, char* buf, size_t size) {
+        if (ns >= 10000000ULL) snprintf(buf, size, "%llums", (unsigned long long)(ns / 1000000));
+        else snprintf(buf, size, "%lluus", (unsigned long long)(ns / 1000));
+    }
+};
+
+#endif
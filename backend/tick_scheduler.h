@@ -0,0 +1,75 @@
+#ifndef TICK_SCHEDULER_H
+#define TICK_SCHEDULER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+struct ScheduledEvent {
+    uint64_t due;
+    uint32_t seq;
+    uint16_t kind;
+    uint32_t target;
+};
+
+// Per-game min-heap of events keyed on engine tick. Timed mechanics enqueue
+// their next transition once instead of polling a countdown every tick, so
+// a tick costs O(events due) however many timed items are live.
+//
+// Cancellation is lazy: schedule() returns a sequence number, the owner
+// remembers the one it still wants and ignores any other that pops.
+class TickScheduler {
+public:
+    static const uint32_t NONE = 0;
+
+    TickScheduler() : nextSeq(1) {}
+
+    uint32_t schedule(uint64_t due, int kind, uint32_t target = 0) {
+        ScheduledEvent ev;
+        ev.due = due;
+        ev.seq = nextSeq++;
+        if (nextSeq == NONE) nextSeq = 1;
+        ev.kind = static_cast<uint16_t>(kind);
+        ev.target = target;
+        heap.push_back(ev);
+        std::push_heap(heap.begin(), heap.end(), Later());
+        return ev.seq;
+    }
+
+    // Removes and returns the earliest event due at or before tick
+    bool popDue(uint64_t tick, ScheduledEvent& ev) {
+        if (heap.empty() || heap.front().due > tick) return false;
+        std::pop_heap(heap.begin(), heap.end(), Later());
+        ev = heap.back();
+        heap.pop_back();
+        return true;
+    }
+
+    void clear() { heap.clear(); }
+    void reserve(size_t count) { heap.reserve(count); }
+    size_t size() const { return heap.size(); }
+
+    // Raw heap order and sequence counter, so a snapshot restores exactly
+    const std::vector<ScheduledEvent>& pending() const { return heap; }
+    uint32_t sequence() const { return nextSeq; }
+
+    void restore(const std::vector<ScheduledEvent>& events, uint32_t seq) {
+        heap.assign(events.begin(), events.end());
+        nextSeq = seq == NONE ? 1 : seq;
+    }
+
+private:
+    // Earliest due first; equal ticks fire in scheduling order
+    struct Later {
+        bool operator()(const ScheduledEvent& a, const ScheduledEvent& b) const {
+            if (a.due != b.due) return a.due > b.due;
+            return static_cast<int32_t>(a.seq - b.seq) > 0;
+        }
+    };
+
+    std::vector<ScheduledEvent> heap;
+    uint32_t nextSeq;
+};
+
+#endif
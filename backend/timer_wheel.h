@@ -0,0 +1,143 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+// Hierarchical timing wheel over small integer ids (session slots).
+// Three levels of 256 slots at 1 ms resolution cover ~4.6 hours; schedule
+// and cancel are O(1) and advancing costs O(timers due + cascades).
+// Each timer costs 24 bytes of bookkeeping.
+class TimerWheel {
+public:
+    static const uint32_t NIL = 0xFFFFFFFFu;
+    static const int LEVELS = 3;
+    static const int SLOT_BITS = 8;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const uint32_t SLOT_MASK = SLOTS - 1;
+
+    explicit TimerWheel(uint64_t startMs = 0) : current(startMs), count(0), firing(NIL) {
+        for (int l = 0; l < LEVELS; ++l) {
+            for (int s = 0; s < SLOTS; ++s) heads[l][s] = NIL;
+        }
+    }
+
+    uint64_t now() const { return current; }
+    size_t size() const { return count; }
+
+    bool isScheduled(uint32_t id) const {
+        return id < nodes.size() && nodes[id].where != NIL;
+    }
+
+    // Due times at or before the current tick fire on the next advance
+    void schedule(uint32_t id, uint64_t dueMs) {
+        if (id >= nodes.size()) nodes.resize(id + 1);
+        if (nodes[id].where != NIL) {
+            unlink(id);
+            --count;
+        }
+        if (dueMs <= current) dueMs = current + 1;
+        nodes[id].due = dueMs;
+        place(id);
+        ++count;
+    }
+
+    void cancel(uint32_t id) {
+        if (!isScheduled(id)) return;
+        unlink(id);
+        --count;
+    }
+
+    // Milliseconds until the next level-0 slot with timers, capped at limit
+    int msUntilNext(int limit) const {
+        for (int d = 1; d <= limit && d < SLOTS; ++d) {
+            if (heads[0][(current + d) & SLOT_MASK] != NIL) return d;
+        }
+        return limit;
+    }
+
+    // Moves time forward to nowMs, calling fire(id) for every timer due.
+    // fire may schedule or cancel any timer, including the one firing.
+    template <typename Fire>
+    void advance(uint64_t nowMs, Fire& fire) {
+        while (current < nowMs) {
+            ++current;
+            uint32_t slot = current & SLOT_MASK;
+            if (slot == 0) cascade(1);
+            // Park the due list where cancel() can still find its members
+            firing = heads[0][slot];
+            heads[0][slot] = NIL;
+            for (uint32_t id = firing; id != NIL; id = nodes[id].next) nodes[id].where = FIRING;
+            while (firing != NIL) {
+                uint32_t id = firing;
+                unlink(id);
+                --count;
+                fire(id);
+            }
+        }
+    }
+
+private:
+    struct Node {
+        uint64_t due;
+        uint32_t next;
+        uint32_t prev;
+        uint32_t where;
+
+        Node() : due(0), next(NIL), prev(NIL), where(NIL) {}
+    };
+
+    static const uint32_t FIRING = LEVELS * SLOTS;
+
+    uint64_t current;
+    size_t count;
+    uint32_t firing;
+    uint32_t heads[LEVELS][SLOTS];
+    std::vector<Node> nodes;
+
+    void place(uint32_t id) {
+        uint64_t delta = nodes[id].due - current;
+        int level = 0;
+        uint64_t span = SLOTS;
+        while (level < LEVELS - 1 && delta >= span) {
+            ++level;
+            span <<= SLOT_BITS;
+        }
+        uint64_t due = nodes[id].due;
+        if (level == LEVELS - 1 && delta >= span) due = current + span - 1;
+        uint32_t slot = static_cast<uint32_t>(due >> (level * SLOT_BITS)) & SLOT_MASK;
+        uint32_t where = static_cast<uint32_t>(level * SLOTS + slot);
+        Node& n = nodes[id];
+        n.where = where;
+        n.prev = NIL;
+        n.next = heads[level][slot];
+        if (n.next != NIL) nodes[n.next].prev = id;
+        heads[level][slot] = id;
+    }
+
+    void unlink(uint32_t id) {
+        Node& n = nodes[id];
+        if (n.prev != NIL) nodes[n.prev].next = n.next;
+        else if (n.where == FIRING) firing = n.next;
+        else heads[n.where / SLOTS][n.where % SLOTS] = n.next;
+        if (n.next != NIL) nodes[n.next].prev = n.prev;
+        n.where = n.next = n.prev = NIL;
+    }
+
+    // Called when the level below wraps: redistributes one slot downward
+    void cascade(int level) {
+        if (level >= LEVELS) return;
+        uint32_t slot = static_cast<uint32_t>(current >> (level * SLOT_BITS)) & SLOT_MASK;
+        if (slot == 0) cascade(level + 1);
+        uint32_t id = heads[level][slot];
+        heads[level][slot] = NIL;
+        while (id != NIL) {
+            uint32_t next = nodes[id].next;
+            place(id);
+            id = next;
+        }
+    }
+};
+
+#endif
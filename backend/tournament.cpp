@@ -0,0 +1,457 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dlfcn.h>
+#include "bot_api.h"
+#include "multiplayer.h"
+#include "tick_profiler.h"
+
+using namespace std;
+
+// Plays controller plugins (see bot_api.h) against each other, one on one,
+// on the multiplayer rules. Every pairing plays each seed of a fixed set
+// twice with the sides swapped, so neither bot gets the better start.
+// Matches run on every core; each worker thread has its own world and its
+// own bot instances. Ratings are fitted to the whole result table at the
+// end, so they do not depend on the order matches finished in.
+
+static const int DEFAULT_MAX_TICKS = 2000;
+// Moves over the budget that forfeit a match
+static const int MAX_STRIKES = 3;
+
+struct BotPlugin {
+    string path;
+    string name;
+    SnakeBotMoveFn move;
+    SnakeBotCreateFn create;
+    SnakeBotDestroyFn destroy;
+};
+
+struct Settings {
+    int width;
+    int height;
+    int maxTicks;
+    uint64_t budgetNanos;
+};
+
+// bots[0] plays snake 0
+struct Match {
+    int bots[2];
+    uint64_t seed;
+};
+
+struct MatchResult {
+    double score;  // for bots[0]: 1 win, 0.5 draw, 0 loss
+    int ticks;
+    bool forfeit;
+};
+
+struct BotStats {
+    LatencyHistogram latency;
+    unsigned long timeouts;
+    BotStats() : timeouts(0) {}
+};
+
+static bool loadPlugin(const string& path, BotPlugin& bot, string& error) {
+    // Without a slash dlopen() would search the library path instead
+    string file = path.find('/') == string::npos ? "./" + path : path;
+    void* handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        error = dlerror();
+        return false;
+    }
+    SnakeBotVersionFn version = reinterpret_cast<SnakeBotVersionFn>(dlsym(handle, "snake_bot_api_version"));
+    bot.move = reinterpret_cast<SnakeBotMoveFn>(dlsym(handle, "snake_bot_move"));
+    if (!version || !bot.move) {
+        error = path + ": missing snake_bot_api_version or snake_bot_move";
+        return false;
+    }
+    if (version() != SNAKE_BOT_API_VERSION) {
+        error = path + ": built for another bot API version";
+        return false;
+    }
+    bot.create = reinterpret_cast<SnakeBotCreateFn>(dlsym(handle, "snake_bot_create"));
+    bot.destroy = reinterpret_cast<SnakeBotDestroyFn>(dlsym(handle, "snake_bot_destroy"));
+    SnakeBotNameFn name = reinterpret_cast<SnakeBotNameFn>(dlsym(handle, "snake_bot_name"));
+    bot.path = path;
+    if (name && name()) {
+        bot.name = name();
+    } else {
+        size_t slash = path.find_last_of('/');
+        bot.name = path.substr(slash == string::npos ? 0 : slash + 1);
+    }
+    return true;
+}
+
+// One per worker thread
+class MatchRunner {
+public:
+    MatchRunner(const Settings& s, const vector<BotPlugin>& plugins) : settings(s), bots(plugins) {}
+
+    MatchResult play(const Match& m, vector<BotStats>& stats) {
+        GameRng rng(m.seed);
+        world.resize(settings.width, settings.height);
+        // Mirrored starts: the board is the same from either side
+        int x = 2 + rng.below(max(1, settings.width / 2 - 4));
+        int y = 2 + rng.below(max(1, settings.height - 4));
+        join(0, world.cellAt(x, y), 1);
+        join(1, world.cellAt(settings.width - 1 - x, settings.height - 1 - y), 3);
+        refillFood(rng);
+
+        void* instance[2];
+        for (int side = 0; side < 2; ++side) {
+            const BotPlugin& bot = bots[m.bots[side]];
+            instance[side] = bot.create ? bot.create(m.seed ^ (0x9E3779B97F4A7C15ULL * (side + 1))) : NULL;
+        }
+
+        MatchResult result;
+        result.forfeit = false;
+        result.score = 0.5;
+        int strikes[2] = {0, 0};
+        size_t lengths[2] = {0, 0};
+        while (static_cast<int>(world.tick) < settings.maxTicks) {
+            if (!world.snakes[0].alive || !world.snakes[1].alive) break;
+            buildView();
+            int wish[MP_MAX_PLAYERS];
+            for (int id = 0; id < MP_MAX_PLAYERS; ++id) wish[id] = -1;
+            for (int side = 0; side < 2; ++side) {
+                const BotPlugin& bot = bots[m.bots[side]];
+                BotStats& st = stats[m.bots[side]];
+                view.self = side;
+                uint64_t start = monotonicNanos();
+                int d = bot.move(instance[side], &view);
+                uint64_t spent = monotonicNanos() - start;
+                st.latency.record(spent);
+                if (spent > settings.budgetNanos) {
+                    ++st.timeouts;
+                    ++strikes[side];
+                } else if (d >= 0 && d < 4) {
+                    wish[side] = d;
+                }
+                lengths[side] = world.snakes[side].body.size();
+            }
+            if (strikes[0] >= MAX_STRIKES || strikes[1] >= MAX_STRIKES) {
+                result.forfeit = true;
+                result.score = strikes[0] >= MAX_STRIKES ? (strikes[1] >= MAX_STRIKES ? 0.5 : 0.0) : 1.0;
+                break;
+            }
+            moves.clear();
+            WireWriter w(moves);
+            stepper.resolve(world, wish, w);
+            WireReader r(&moves[0], moves.size());
+            world.applyMoves(r);
+            refillFood(rng);
+        }
+        if (!result.forfeit) {
+            bool alive0 = world.snakes[0].alive;
+            bool alive1 = world.snakes[1].alive;
+            if (alive0 != alive1) {
+                result.score = alive0 ? 1.0 : 0.0;
+            } else {
+                // Both died on the same tick, or time ran out: longer wins
+                if (alive0) {
+                    lengths[0] = world.snakes[0].body.size();
+                    lengths[1] = world.snakes[1].body.size();
+                }
+                result.score = lengths[0] == lengths[1] ? 0.5 : (lengths[0] > lengths[1] ? 1.0 : 0.0);
+            }
+        }
+        result.ticks = static_cast<int>(world.tick);
+        for (int side = 0; side < 2; ++side) {
+            const BotPlugin& bot = bots[m.bots[side]];
+            if (bot.destroy) bot.destroy(instance[side]);
+        }
+        return result;
+    }
+
+private:
+    const Settings& settings;
+    const vector<BotPlugin>& bots;
+    MultiWorld world;
+    MpStepper stepper;
+    vector<uint8_t> moves;
+    vector<uint16_t> bodies[2];
+    SnakeBotSnake snakes[2];
+    SnakeBotView view;
+
+    void join(int id, int cell, int dir) {
+        vector<uint8_t> ev;
+        WireWriter e(ev);
+        e.u8(MP_EV_JOIN);
+        e.u8(static_cast<uint8_t>(id));
+        e.u16(static_cast<uint16_t>(cell));
+        e.u8(static_cast<uint8_t>(dir));
+        WireReader r(&ev[0], ev.size());
+        bool ok = true;
+        world.applyEvent(r, ok);
+    }
+
+    void refillFood(GameRng& rng) {
+        int want = world.aliveCount() > 1 ? world.aliveCount() : 1;
+        int area = world.width * world.height;
+        for (int n = world.foodCount(); n < want; ++n) {
+            for (int tries = 0; tries < area * 4; ++tries) {
+                int cell = rng.below(area);
+                if (world.isFree(cell)) {
+                    world.addFood(cell);
+                    break;
+                }
+            }
+        }
+    }
+
+    void buildView() {
+        for (int id = 0; id < 2; ++id) {
+            const MpSnake& s = world.snakes[id];
+            bodies[id].assign(s.body.begin(), s.body.end());
+            snakes[id].alive = s.alive;
+            snakes[id].dir = s.dir;
+            snakes[id].score = s.score;
+            snakes[id].length = static_cast<int32_t>(bodies[id].size());
+            snakes[id].body = bodies[id].empty() ? NULL : &bodies[id][0];
+        }
+        view.api_version = SNAKE_BOT_API_VERSION;
+        view.width = world.width;
+        view.height = world.height;
+        view.tick = world.tick;
+        view.snake_count = 2;
+        view.snakes = snakes;
+        view.food_count = world.foodCount();
+        view.food = world.foodCells.empty() ? NULL : &world.foodCells[0];
+        view.occupied = &world.occupied[0];
+    }
+};
+
+// Runs every match on `threads` workers; results land at the match's index
+static void playAll(const vector<Match>& matches, const vector<BotPlugin>& bots, const Settings& settings,
+                    int threads, vector<MatchResult>& results, vector<BotStats>& stats) {
+    results.resize(matches.size());
+    atomic<size_t> next(0);
+    vector<vector<BotStats> > perThread(threads, vector<BotStats>(bots.size()));
+    vector<thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.push_back(thread([&, t] {
+            MatchRunner runner(settings, bots);
+            size_t i;
+            while ((i = next.fetch_add(1)) < matches.size()) results[i] = runner.play(matches[i], perThread[t]);
+        }));
+    }
+    for (size_t t = 0; t < pool.size(); ++t) pool[t].join();
+    for (int t = 0; t < threads; ++t) {
+        for (size_t b = 0; b < bots.size(); ++b) {
+            stats[b].latency.merge(perThread[t][b].latency);
+            stats[b].timeouts += perThread[t][b].timeouts;
+        }
+    }
+}
+
+// Both sides of every seed for one pairing
+static void addPairing(int a, int b, const vector<uint64_t>& seeds, vector<Match>& matches) {
+    for (size_t k = 0; k < seeds.size(); ++k) {
+        Match m;
+        m.seed = seeds[k];
+        m.bots[0] = a;
+        m.bots[1] = b;
+        matches.push_back(m);
+        swap(m.bots[0], m.bots[1]);
+        matches.push_back(m);
+    }
+}
+
+// Bradley-Terry strengths by minorization-maximization, on the Elo scale.
+// Every bot also gets one virtual draw against a 1500 player, which keeps
+// the ratings finite for a bot that never wins or never loses.
+static vector<double> fitElo(int bots, const vector<Match>& matches, const vector<MatchResult>& results) {
+    vector<double> wins(bots, 0.5);
+    vector<vector<double> > games(bots, vector<double>(bots, 0));
+    for (size_t i = 0; i < matches.size(); ++i) {
+        int a = matches[i].bots[0];
+        int b = matches[i].bots[1];
+        wins[a] += results[i].score;
+        wins[b] += 1.0 - results[i].score;
+        games[a][b] += 1;
+        games[b][a] += 1;
+    }
+    vector<double> strength(bots, 1.0);
+    vector<double> updated(bots);
+    for (int iter = 0; iter < 10000; ++iter) {
+        double change = 0;
+        for (int i = 0; i < bots; ++i) {
+            double denominator = 1.0 / (strength[i] + 1.0);
+            for (int j = 0; j < bots; ++j) {
+                if (games[i][j] > 0) denominator += games[i][j] / (strength[i] + strength[j]);
+            }
+            updated[i] = wins[i] / denominator;
+            change = max(change, fabs(log(updated[i] / strength[i])));
+        }
+        strength.swap(updated);
+        if (change < 1e-9) break;
+    }
+    vector<double> elo(bots);
+    for (int i = 0; i < bots; ++i) elo[i] = 1500 + 400 * log10(strength[i]);
+    return elo;
+}
+
+// Pairs bots with equal or close points that have not met yet; with an odd
+// count the lowest unpaired bot sits the round out
+static vector<pair<int, int> > swissPairs(const vector<double>& points, vector<vector<bool> >& met) {
+    int n = static_cast<int>(points.size());
+    vector<int> order(n);
+    for (int i = 0; i < n; ++i) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](int a, int b) { return points[a] > points[b]; });
+    vector<bool> paired(n, false);
+    vector<pair<int, int> > pairs;
+    for (int i = 0; i < n; ++i) {
+        int a = order[i];
+        if (paired[a]) continue;
+        int partner = -1;
+        for (int j = i + 1; j < n && partner < 0; ++j) {
+            if (!paired[order[j]] && !met[a][order[j]]) partner = order[j];
+        }
+        for (int j = i + 1; j < n && partner < 0; ++j) {
+            if (!paired[order[j]]) partner = order[j];
+        }
+        if (partner < 0) break;
+        paired[a] = paired[partner] = true;
+        met[a][partner] = met[partner][a] = true;
+        pairs.push_back(make_pair(a, partner));
+    }
+    return pairs;
+}
+
+static string formatMicros(uint64_t ns) {
+    char buf[32];
+    if (ns < 10000) snprintf(buf, sizeof(buf), "%.1fus", ns / 1e3);
+    else if (ns < 10000000) snprintf(buf, sizeof(buf), "%.0fus", ns / 1e3);
+    else snprintf(buf, sizeof(buf), "%.0fms", ns / 1e6);
+    return buf;
+}
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    settings.width = BOARD_WIDTH;
+    settings.height = BOARD_HEIGHT;
+    settings.maxTicks = DEFAULT_MAX_TICKS;
+    settings.budgetNanos = 5000000;
+    int seedCount = 16;
+    uint64_t baseSeed = 1;
+    int swissRounds = 0;
+    int threads = static_cast<int>(thread::hardware_concurrency());
+    vector<string> paths;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--swiss" && i + 1 < argc) swissRounds = atoi(argv[++i]);
+        else if (arg == "--seeds" && i + 1 < argc) seedCount = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) baseSeed = strtoull(argv[++i], NULL, 10);
+        else if (arg == "--move-ms" && i + 1 < argc) settings.budgetNanos = static_cast<uint64_t>(atof(argv[++i]) * 1e6);
+        else if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (arg == "--max-ticks" && i + 1 < argc) settings.maxTicks = atoi(argv[++i]);
+        else if (arg == "--board" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &settings.width, &settings.height) != 2 || settings.width < 8 ||
+                settings.height < 8 || settings.width > 255 || settings.height > 255) {
+                cerr << "--board takes WxH, 8 to 255 each\n";
+                return 1;
+            }
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") != 0) {
+            paths.push_back(arg);
+        } else {
+            paths.clear();
+            break;
+        }
+    }
+    if (paths.size() < 2 || seedCount < 1) {
+        cerr << "Usage: " << argv[0] << " [--swiss ROUNDS] [--seeds N] [--seed N] [--move-ms N] [--threads N]\n"
+             << "             [--max-ticks N] [--board WxH] bot.so bot.so...\n"
+             << "  Round-robin unless --swiss is given; every pairing plays each seed from both sides\n";
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+
+    vector<BotPlugin> bots(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        string error;
+        if (!loadPlugin(paths[i], bots[i], error)) {
+            cerr << error << "\n";
+            return 1;
+        }
+    }
+    int n = static_cast<int>(bots.size());
+    vector<uint64_t> seeds(seedCount);
+    GameRng seedRng(baseSeed);
+    for (int k = 0; k < seedCount; ++k) seeds[k] = (static_cast<uint64_t>(seedRng.next()) << 32) | seedRng.next();
+
+    vector<Match> matches;
+    vector<MatchResult> results;
+    vector<BotStats> stats(n);
+    uint64_t start = monotonicNanos();
+    if (swissRounds <= 0) {
+        for (int a = 0; a < n; ++a) {
+            for (int b = a + 1; b < n; ++b) addPairing(a, b, seeds, matches);
+        }
+        playAll(matches, bots, settings, threads, results, stats);
+    } else {
+        vector<double> points(n, 0);
+        vector<vector<bool> > met(n, vector<bool>(n, false));
+        for (int round = 0; round < swissRounds; ++round) {
+            vector<pair<int, int> > pairs = swissPairs(points, met);
+            vector<Match> roundMatches;
+            for (size_t p = 0; p < pairs.size(); ++p) addPairing(pairs[p].first, pairs[p].second, seeds, roundMatches);
+            vector<MatchResult> roundResults;
+            playAll(roundMatches, bots, settings, threads, roundResults, stats);
+            for (size_t i = 0; i < roundMatches.size(); ++i) {
+                points[roundMatches[i].bots[0]] += roundResults[i].score;
+                points[roundMatches[i].bots[1]] += 1.0 - roundResults[i].score;
+            }
+            matches.insert(matches.end(), roundMatches.begin(), roundMatches.end());
+            results.insert(results.end(), roundResults.begin(), roundResults.end());
+        }
+    }
+    double seconds = (monotonicNanos() - start) / 1e9;
+
+    vector<double> elo = fitElo(n, matches, results);
+    vector<int> wins(n, 0), draws(n, 0), losses(n, 0), forfeits(n, 0);
+    uint64_t ticks = 0;
+    for (size_t i = 0; i < matches.size(); ++i) {
+        int a = matches[i].bots[0];
+        int b = matches[i].bots[1];
+        const MatchResult& r = results[i];
+        ticks += r.ticks;
+        if (r.score > 0.75) {
+            ++wins[a];
+            ++losses[b];
+            if (r.forfeit) ++forfeits[b];
+        } else if (r.score < 0.25) {
+            ++losses[a];
+            ++wins[b];
+            if (r.forfeit) ++forfeits[a];
+        } else {
+            ++draws[a];
+            ++draws[b];
+        }
+    }
+    vector<int> order(n);
+    for (int i = 0; i < n; ++i) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](int a, int b) { return elo[a] > elo[b]; });
+
+    printf("%s, %d bots, %d seeds x 2 sides, %zu matches (%llu ticks) in %.1fs on %d threads\n",
+           swissRounds > 0 ? "Swiss" : "Round-robin", n, seedCount, matches.size(),
+           static_cast<unsigned long long>(ticks), seconds, threads);
+    printf("%3s  %-16s %6s %6s %6s %6s %8s %9s %9s %9s %9s\n", "#", "bot", "elo", "won", "drawn", "lost",
+           "timeouts", "p50", "p90", "p99", "max");
+    for (int rank = 0; rank < n; ++rank) {
+        int b = order[rank];
+        const LatencyHistogram& h = stats[b].latency;
+        printf("%3d  %-16s %6.0f %6d %6d %6d %8lu %9s %9s %9s %9s\n", rank + 1, bots[b].name.c_str(), elo[b],
+               wins[b], draws[b], losses[b], stats[b].timeouts, formatMicros(h.percentile(0.5)).c_str(),
+               formatMicros(h.percentile(0.9)).c_str(), formatMicros(h.percentile(0.99)).c_str(),
+               formatMicros(h.max()).c_str());
+        if (forfeits[b]) printf("     %-16s forfeited %d matches on time\n", "", forfeits[b]);
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+// Little-endian byte encoding shared by the network protocol and the
+// in-memory state snapshots. Varints use 7 bits per byte, low bits first.
+class WireWriter {
+public:
+    explicit WireWriter(std::vector<uint8_t>& out) : buf(out) {}
+    void u8(uint8_t v) { buf.push_back(v); }
+    void u16(uint16_t v) { buf.push_back(v & 0xFF); buf.push_back(v >> 8); }
+    void u32(uint32_t v) { u16(v & 0xFFFF); u16(v >> 16); }
+    void u64(uint64_t v) { u32(static_cast<uint32_t>(v)); u32(static_cast<uint32_t>(v >> 32)); }
+    void varint(uint64_t v) {
+        while (v >= 0x80) {
+            buf.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        buf.push_back(static_cast<uint8_t>(v));
+    }
+
+private:
+    std::vector<uint8_t>& buf;
+};
+
+class WireReader {
+public:
+    WireReader(const uint8_t* data, size_t len) : p(data), end(data + len), good(true) {}
+    bool ok() const { return good; }
+    bool atEnd() const { return p >= end; }
+    size_t remaining() const { return end - p; }
+    uint8_t u8() {
+        if (p >= end) { good = false; return 0; }
+        return *p++;
+    }
+    uint16_t u16() { uint16_t lo = u8(); return lo | (static_cast<uint16_t>(u8()) << 8); }
+    uint32_t u32() { uint32_t lo = u16(); return lo | (static_cast<uint32_t>(u16()) << 16); }
+    uint64_t u64() { uint64_t lo = u32(); return lo | (static_cast<uint64_t>(u32()) << 32); }
+    uint32_t varint() {
+        uint64_t v = varint64();
+        if (v > 0xFFFFFFFFu) good = false;
+        return static_cast<uint32_t>(v);
+    }
+    uint64_t varint64() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 70; shift += 7) {
+            uint8_t b = u8();
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        good = false;
+        return 0;
+    }
+
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+    bool good;
+};
+
+#endif